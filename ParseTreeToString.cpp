@@ -256,6 +256,10 @@ string ParseTreeToString::show(const ShowStatement *stmt) {
     return ret;
 }
 
+string ParseTreeToString::import(const ImportStatement *stmt) {
+    return string("COPY ") + stmt->tableName + " FROM '" + stmt->filePath + "'";
+}
+
 string ParseTreeToString::statement(const SQLStatement *stmt) {
     switch (stmt->type()) {
         case kStmtSelect:
@@ -268,9 +272,10 @@ string ParseTreeToString::statement(const SQLStatement *stmt) {
             return drop((const DropStatement *) stmt);
         case kStmtShow:
             return show((const ShowStatement *) stmt);
+        case kStmtImport:
+            return import((const ImportStatement *) stmt);
 
         case kStmtError:
-        case kStmtImport:
         case kStmtUpdate:
         case kStmtDelete:
         case kStmtPrepare:
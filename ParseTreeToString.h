@@ -38,6 +38,7 @@ private:
     static std::string insert(const hsql::InsertStatement *stmt);
     static std::string create(const hsql::CreateStatement *stmt);
     static std::string drop(const hsql::DropStatement *stmt);
+    static std::string import(const hsql::ImportStatement *stmt);
     static std::string show(const hsql::ShowStatement *stmt);
 };
 
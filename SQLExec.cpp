@@ -4,7 +4,14 @@
  * @see "Seattle University, CPSC5300, Summer 2018"
  */
 
+#include <algorithm>
+#include <cctype>
+#include <set>
+#include <sstream>
+#include <thread>
 #include "SQLExec.h"
+#include "bulk_loader.h"
+#include "bitmap_index.h"
 using namespace std;
 using namespace hsql;
 
@@ -22,8 +29,7 @@ ostream &operator<<(ostream &out, const QueryResult &qres) {
             out << "----------+";
         out << endl;
         for (auto const &row: *qres.rows) {
-            for (auto const &column_name: *qres.column_names) {
-                Value value = row->at(column_name);
+            for (auto const &value: *row) {
                 switch (value.data_type) {
                     case ColumnAttribute::INT:
                         out << value.n;
@@ -56,38 +62,429 @@ QueryResult::~QueryResult() {
     if (column_attributes != NULL)
         delete column_attributes;
     if (rows != NULL)
-        for(ValueDict *row: *rows)
+        for(Row *row: *rows)
             delete row;
     delete rows;
 }
 
+/*
+ * Position of a column within the rows of a query result.
+ */
+uint SQLExec::result_column(const ColumnNames *column_names, const Identifier &column_name) {
+    for (uint i = 0; i < column_names->size(); i++)
+        if ((*column_names)[i] == column_name)
+            return i;
+    throw SQLExecError("no column " + column_name + " in result");
+}
+
 /*
  * This method exceute all the query of the basis of statement type.
- * Currently Support : Create, Drop, Show (Table)
+ * Currently Support : Create, Drop, Show (Table), Select, Import
  */
-QueryResult *SQLExec::execute(const SQLStatement *statement) throw(SQLExecError) {
-    // Initialize static system table object (singleton) to be used through out the execution of query.
-    if (tables == NULL) 
-        SQLExec::tables = new Tables();
-    if(indices == NULL)
-        SQLExec::indices = new Indices(); // Where are these freed - memory leak potential?
+QueryResult *SQLExec::execute(const SQLStatement *statement, const ColumnNames *included_columns) throw(SQLExecError) {
+    open_schema_tables();
 
     // Determine which type of SQL statement it is
     try {
         switch (statement->type()) {
             case kStmtCreate:
-                return create((const CreateStatement *) statement);
+                return create((const CreateStatement *) statement, included_columns);
             case kStmtDrop:
                 return drop((const DropStatement *) statement);
             case kStmtShow:
                 return show((const ShowStatement *) statement);
+            case kStmtImport:
+                return import((const ImportStatement *) statement);
+            case kStmtSelect:
+                return select((const SelectStatement *) statement);
             default:
                 return new QueryResult("not implemented");
-                // Here would be INSERT, SELECT, &c
+                // Here would be INSERT, &c
+        }
+    } catch (DbRelationError& e) {
+        throw SQLExecError(string("DbRelationError: ") + e.what());
+    } catch (DbException& e) {
+        throw SQLExecError(string("DbException: ") + e.what());
+    }
+}
+
+/*
+ * Initialize static system table object (singleton) to be used through out the execution of query.
+ */
+void SQLExec::open_schema_tables() {
+    if (tables == NULL) 
+        SQLExec::tables = new Tables();
+    if(indices == NULL)  // the one Tables keeps, so its key index and filter see every change the catalog reads
+        SQLExec::indices = &dynamic_cast<Indices&>(Tables::get_table(Indices::TABLE_NAME));
+}
+
+// INT values are 32 bits; a count too big for one shows as the biggest there is
+static Value count_value(uint64_t count) {
+    return Value((int32_t) min<uint64_t>(count, INT32_MAX));
+}
+
+/*
+ * The SHOW TABLE STATUS row for a table (nullptr if it isn't a HeapTable): through its cached
+ * HeapTable if it has one, otherwise through a HeapTable of its own that has no indices attached.
+ */
+static Row *table_status(const Identifier &table_name) {
+    if (Tables::is_cached(table_name)) {
+        HeapTable *heap = dynamic_cast<HeapTable *>(&Tables::get_table(table_name));
+        if (heap == nullptr)
+            return nullptr;
+        return new Row({Value(table_name), count_value(heap->get_n_rows()), count_value(heap->get_n_bytes()),
+                        count_value(heap->get_n_blocks())});
+    }
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    Tables::get_columns(table_name, column_names, column_attributes);
+    HeapTable heap(table_name, column_names, column_attributes);
+    Row *row = new Row({Value(table_name), count_value(heap.get_n_rows()), count_value(heap.get_n_bytes()),
+                        count_value(heap.get_n_blocks())});
+    heap.close();
+    return row;
+}
+
+/*
+ * SHOW TABLE STATUS: a row for each table (except the schema tables) with its counts.
+ * The counts are kept up to date by the table as rows are inserted and deleted, and saved in its
+ * file. A table nobody has used yet is opened without its indices just long enough to read them,
+ * so this doesn't build any in-memory index.
+ */
+QueryResult *SQLExec::show_table_status(const string &query) throw(SQLExecError) {
+    string upper = query;
+    transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+    replace(upper.begin(), upper.end(), ';', ' ');
+    istringstream words(upper);
+    string show, table, status, more;
+    if (!(words >> show >> table >> status) || show != "SHOW" || table != "TABLE" || status != "STATUS"
+            || words >> more)
+        return nullptr;
+
+    open_schema_tables();
+    Rows *rows = new Rows();
+    HandleCursor *cursor = nullptr;
+    try {
+        cursor = tables->cursor();
+        for (Handle handle: *cursor) {
+            ValueDict *row = tables->project(handle);
+            Identifier table_name = row->at("table_name").s;
+            delete row;
+            if (table_name == Tables::TABLE_NAME || table_name == Columns::TABLE_NAME
+                    || table_name == Indices::TABLE_NAME)
+                continue;
+            Row *status = table_status(table_name);
+            if (status != nullptr)
+                rows->push_back(status);
         }
+        delete cursor;
     } catch (DbRelationError& e) {
+        delete cursor;  // or its block of _tables stays pinned
+        for (auto const &row: *rows)
+            delete row;
+        delete rows;
         throw SQLExecError(string("DbRelationError: ") + e.what());
+    } catch (DbException& e) {
+        delete cursor;
+        for (auto const &row: *rows)
+            delete row;
+        delete rows;
+        throw SQLExecError(string("DbException: ") + e.what());
     }
+    ColumnAttribute text(ColumnAttribute::TEXT), number(ColumnAttribute::INT);
+    return new QueryResult(new ColumnNames({"table_name", "rows", "bytes", "blocks"}),
+                           new ColumnAttributes({text, number, number, number}), rows,
+                           "successfully returned " + to_string(rows->size()) + " rows");
+}
+
+// Skip blanks, then take the given keyword (in any case) if it is the next word.
+static bool take_word(const string &text, size_t &position, const string &word) {
+    position = text.find_first_not_of(" \t\r\n", position);
+    if (position == string::npos || text.size() - position < word.size())
+        return false;
+    for (uint i = 0; i < word.size(); i++)
+        if (toupper((unsigned char) text[position + i]) != word[i])
+            return false;
+    size_t end = position + word.size();
+    if (end < text.size() && (isalnum((unsigned char) text[end]) || text[end] == '_'))
+        return false;
+    position = end;
+    return true;
+}
+
+// Skip blanks, then take a name.
+static bool take_name(const string &text, size_t &position, string &name) {
+    position = text.find_first_not_of(" \t\r\n", position);
+    if (position == string::npos || !(isalpha((unsigned char) text[position]) || text[position] == '_'))
+        return false;
+    size_t end = position;
+    while (end < text.size() && (isalnum((unsigned char) text[end]) || text[end] == '_'))
+        end++;
+    name = text.substr(position, end - position);
+    position = end;
+    return true;
+}
+
+// Skip blanks, then take a parenthesized list of names separated by commas.
+static bool take_names(const string &text, size_t &position, ColumnNames &names) {
+    position = text.find_first_not_of(" \t\r\n", position);
+    if (position == string::npos || text[position] != '(')
+        return false;
+    position++;
+    do {
+        string name;
+        if (!take_name(text, position, name))
+            return false;
+        names.push_back(name);
+        position = text.find_first_not_of(" \t\r\n", position);
+        if (position == string::npos)
+            return false;
+    } while (text[position++] == ',');
+    return text[position - 1] == ')';
+}
+
+/*
+ * CREATE INDEX <name> ON <table> [USING <type>] ( <columns> ) INCLUDE ( <columns> ) [;]
+ * Cut the INCLUDE clause out of the text and return its columns separately, so the rest can go
+ * through the parser. Only a line holding just that one statement is taken apart; anything else
+ * is left as it is (so an INCLUDE anywhere else is an error from the parser).
+ */
+string SQLExec::take_include(const string &query, ColumnNames &included_columns) {
+    included_columns.clear();
+    string name;
+    ColumnNames key_columns, columns;
+    size_t position = 0;
+    if (!take_word(query, position, "CREATE") || !take_word(query, position, "INDEX")
+            || !take_name(query, position, name) || !take_word(query, position, "ON")
+            || !take_name(query, position, name))
+        return query;
+    size_t after_table = position;
+    if (!take_word(query, position, "USING"))
+        position = after_table;
+    else if (!take_name(query, position, name))
+        return query;
+    if (!take_names(query, position, key_columns))
+        return query;
+    size_t include = position;
+    if (!take_word(query, position, "INCLUDE") || !take_names(query, position, columns))
+        return query;
+    size_t end = query.find_first_not_of(" \t\r\n", position);
+    if (end != string::npos && (query[end] != ';' || query.find_first_not_of(" \t\r\n", end + 1) != string::npos))
+        return query;
+    included_columns = columns;
+    return query.substr(0, include) + query.substr(position);
+}
+
+/*
+ * Select:
+ * 1. work out the columns the query touches: the ones selected and the ones in the where clause.
+ * 2. if an index covers all of them, read the rows from its entries alone, preferring the index
+ *    with the most leading key columns in the where clause.
+ * 3. otherwise scan the table for the qualifying rows and project each one.
+ */
+QueryResult *SQLExec::select(const SelectStatement *statement) {
+    if (statement->fromTable == nullptr || statement->fromTable->type != kTableName)
+        throw SQLExecError("only SELECT from a single table is implemented");
+    Identifier table_name = statement->fromTable->name;
+    if (!table_exists(table_name))
+        throw SQLExecError("no table " + table_name);
+    DbRelation &table = tables->get_table(table_name);
+    ValueDict where;
+    if (statement->whereClause != nullptr)
+        where_conditions(statement->whereClause, where);
+    const Expr *first = statement->selectList->at(0);
+    if (statement->selectList->size() == 1 && first->type == kExprFunctionRef && first->expr != nullptr
+            && first->expr->type == kExprStar) {
+        string function = first->name;
+        transform(function.begin(), function.end(), function.begin(), ::toupper);
+        if (function == "COUNT")
+            return select_count(table, where);
+    }
+
+    ColumnNames column_names;
+    for (auto const &expr: *statement->selectList) {
+        if (expr->type == kExprStar)
+            column_names.insert(column_names.end(), table.get_column_names().begin(), table.get_column_names().end());
+        else if (expr->type == kExprColumnRef)
+            column_names.push_back(expr->name);
+        else
+            throw SQLExecError("only columns can be selected");
+    }
+    ColumnOrdinals ordinals = table.get_column_ordinals(&column_names);
+    ColumnNames touched = column_names;
+    for (auto const &condition: where)
+        touched.push_back(condition.first);
+    table.get_column_ordinals(&touched);
+
+    DbIndex *covering = nullptr;
+    uint best = 0;
+    for (auto const &index_name: indices->get_index_names(table_name)) {
+        DbIndex &index = indices->get_index(table_name, index_name);
+        if (!index.covers(&touched))
+            continue;
+        uint leading = 0;
+        for (auto const &key_column: index.get_key_columns()) {
+            if (where.find(key_column) == where.end())
+                break;
+            leading++;
+        }
+        if (covering == nullptr || leading > best) {
+            covering = &index;
+            best = leading;
+        }
+    }
+
+    Rows *rows;
+    string how;
+    Bitmap *matches = nullptr;
+    if (covering != nullptr) {
+        rows = covering->lookup_rows(where.empty() ? nullptr : &where, &column_names);
+        how = " (index-only scan)";
+    } else if ((matches = where_bitmap(table_name, where)) != nullptr) {
+        // every condition has a bitmap: read just the rows in their AND
+        Handles *handles = BitmapIndex::handles(*matches);
+        delete matches;
+        rows = new Rows();
+        for (auto const &handle: *handles)
+            rows->push_back(table.project(handle, &ordinals));
+        delete handles;
+        how = " (bitmap index)";
+    } else {
+        rows = new Rows();
+        HeapTable *heap = dynamic_cast<HeapTable *>(&table);
+        unsigned long skipped = heap == nullptr ? 0 : heap->get_blocks_skipped();
+        unsigned long scanned = heap == nullptr ? 0 : heap->get_blocks_scanned();
+        HandleCursor *cursor = table.cursor(where.empty() ? nullptr : &where);
+        try {
+            for (auto const &handle: *cursor)
+                rows->push_back(table.project(handle, &ordinals));
+        } catch (DbRelationError &e) {
+            for (auto const &row: *rows)
+                delete row;
+            delete rows;
+            delete cursor;
+            throw;
+        }
+        delete cursor;
+        if (heap != nullptr && heap->get_blocks_skipped() > skipped) {
+            skipped = heap->get_blocks_skipped() - skipped;
+            scanned = heap->get_blocks_scanned() - scanned;
+            how = " (skipped " + to_string(skipped) + " of " + to_string(skipped + scanned) + " blocks)";
+        }
+    }
+
+    ColumnAttributes *column_attributes = new ColumnAttributes();
+    for (auto const &ordinal: ordinals)
+        column_attributes->push_back(table.get_column_attributes()[ordinal]);
+    return new QueryResult(new ColumnNames(column_names), column_attributes, rows,
+                           "successfully returned " + to_string(rows->size()) + " rows" + how);
+}
+
+/*
+ * SELECT COUNT(*) FROM <table> [WHERE ...]
+ * With no WHERE clause, the count the table keeps of its rows. If every condition has a bitmap
+ * index, the bits of their AND. Otherwise the rows that qualify are found (without projecting
+ * them) and counted.
+ */
+QueryResult *SQLExec::select_count(DbRelation &table, const ValueDict &where) {
+    HeapTable *heap = dynamic_cast<HeapTable *>(&table);
+    uint64_t count;
+    string how;
+    Bitmap *matches = nullptr;
+    if (where.empty() && heap != nullptr) {
+        count = heap->get_n_rows();
+        how = " (from the table's row count)";
+    } else if ((matches = where_bitmap(table.get_table_name(), where)) != nullptr) {
+        count = matches->count();
+        delete matches;
+        how = " (bitmap index)";
+    } else {
+        Handles *handles = where.empty() ? table.select() : table.select(&where);
+        count = handles->size();
+        delete handles;
+    }
+    Rows *rows = new Rows();
+    rows->push_back(new Row({count_value(count)}));
+    return new QueryResult(new ColumnNames({"COUNT(*)"}), new ColumnAttributes({ColumnAttribute(ColumnAttribute::INT)}),
+                           rows, "successfully returned 1 rows" + how);
+}
+
+/*
+ * AND the bitmaps of the table's BITMAP indices whose key columns are all in the where clause,
+ * if between them they have every column of it.
+ */
+Bitmap *SQLExec::where_bitmap(const Identifier &table_name, const ValueDict &where) {
+    if (where.empty())
+        return nullptr;
+    vector<BitmapIndex *> bitmaps;
+    set<Identifier> bitmapped;
+    for (auto const &index_name: indices->get_index_names(table_name)) {
+        BitmapIndex *bitmap = dynamic_cast<BitmapIndex *>(&indices->get_index(table_name, index_name));
+        if (bitmap == nullptr)
+            continue;
+        bool on_where = true;
+        for (auto const &key_column: bitmap->get_key_columns())
+            on_where = on_where && where.find(key_column) != where.end();
+        if (on_where) {
+            bitmaps.push_back(bitmap);
+            bitmapped.insert(bitmap->get_key_columns().begin(), bitmap->get_key_columns().end());
+        }
+    }
+    if (bitmapped.size() != where.size())
+        return nullptr;
+    Bitmap *matches = bitmaps[0]->lookup_bitmap(&where);
+    for (uint i = 1; i < bitmaps.size(); i++) {
+        Bitmap *more = bitmaps[i]->lookup_bitmap(&where);
+        matches->and_with(*more);
+        delete more;
+    }
+    return matches;
+}
+
+/*
+ * Collect <column> = <literal> conditions, going down through the ANDs.
+ */
+void SQLExec::where_conditions(const Expr *expr, ValueDict &where) {
+    if (expr->type == kExprOperator && expr->opType == Expr::AND) {
+        where_conditions(expr->expr, where);
+        where_conditions(expr->expr2, where);
+        return;
+    }
+    if (expr->type != kExprOperator || expr->opType != Expr::SIMPLE_OP || expr->opChar != '='
+            || expr->expr->type != kExprColumnRef)
+        throw SQLExecError("only <column> = <literal> conditions joined by AND are implemented");
+    Identifier column_name = expr->expr->name;
+    switch (expr->expr2->type) {
+        case kExprLiteralInt:
+            where[column_name] = Value((int32_t) expr->expr2->ival);
+            break;
+        case kExprLiteralString:
+            where[column_name] = Value(string(expr->expr2->name));
+            break;
+        default:
+            throw SQLExecError("only INT and TEXT literals are implemented");
+    }
+}
+
+/*
+ * COPY <table> FROM '<file>' (or IMPORT FROM CSV FILE '<file>' INTO <table>):
+ * bulk load the rows of a CSV file, parsing with one thread per core.
+ * Not into the schema tables: their rows have to go through their own insert() checks.
+ */
+QueryResult *SQLExec::import(const ImportStatement *statement) {
+    Identifier table_name = statement->tableName;
+    if (table_name == Tables::TABLE_NAME || table_name == Columns::TABLE_NAME || table_name == Indices::TABLE_NAME)
+        throw DbRelationError("can't load into schema table " + table_name);
+    if (!table_exists(table_name))
+        throw SQLExecError("no table " + table_name + " to load into");
+    DbRelation &table = tables->get_table(table_name);
+    BulkLoader loader(table, thread::hardware_concurrency());
+    try {
+        loader.load(statement->filePath);
+    } catch (BulkLoadError &e) {
+        throw SQLExecError(string(e.what()) + " (" + to_string(loader.get_rows()) + " rows loaded)");
+    }
+    return new QueryResult(loader.report());
 }
 
 /* 
@@ -111,12 +508,12 @@ void SQLExec::column_definition(const ColumnDefinition *col, Identifier& column_
 /*
  * Create Statement to Create SQL Objects Table.
  */
-QueryResult *SQLExec::create(const CreateStatement *statement) {
+QueryResult *SQLExec::create(const CreateStatement *statement, const ColumnNames *included_columns) {
     switch(statement->type) {
         case CreateStatement::kTable:
             return create_table(statement);
         case CreateStatement::kIndex:
-            return create_index(statement);
+            return create_index(statement, included_columns);
         default:
             throw SQLExecError(" Only CREATE TABLE and CREATE INDEX are implemented");
     }
@@ -189,9 +586,10 @@ QueryResult *SQLExec::create_table(const CreateStatement *statement) {
  * Create index for tables:
  * 1. retrievs column name for the table mentioned in statement. 
  * 2. create row for _indices table and validate if index column exist in the table..
- * 3. call DBIndex create method (not use for right).
+ *    (and one for each included column, after the key columns)
+ * 3. call DBIndex create method to build it (undoing step 2 if that fails).
  */
-QueryResult *SQLExec::create_index(const CreateStatement *statement) {
+QueryResult *SQLExec::create_index(const CreateStatement *statement, const ColumnNames *included_columns) {
     Identifier index_name = statement->indexName;
     Identifier table_name = statement->tableName;
     DbRelation& table = SQLExec::tables->get_table(statement->tableName);
@@ -202,21 +600,49 @@ QueryResult *SQLExec::create_index(const CreateStatement *statement) {
     row["index_name"] = Value(statement->indexName);
     row["index_type"] = Value(statement->indexType);
     // Note that the ValueDict stores boolean values internally as 1 or 0 ints
-    // Also note that compare returns 0 for no diffs
-    row["is_unique"] = Value(string(statement->indexType).compare(string("BTREE")) == 0? 1 : 0);
-    uint i = 1;
-    for(auto const& col : *statement->indexColumns){
-        // Comapre if the rows exist in table on which we are creating index.
+    // The parser has no CREATE UNIQUE INDEX, so an index made here is never unique, whatever its type
+    row["is_unique"] = Value(0);
+    row["is_included"] = Value(0);
+    row["is_included"].data_type = ColumnAttribute::BOOLEAN;
+    ColumnNames index_columns(statement->indexColumns->begin(), statement->indexColumns->end());
+    uint n_key_columns = (uint) index_columns.size();
+    if (included_columns != nullptr && !included_columns->empty()) {
+        if (string(statement->indexType) != "BTREE")
+            throw SQLExecError(" Only BTREE indices can include columns");
+        for (auto const& col : *included_columns)
+            if (find(index_columns.begin(), index_columns.end(), col) != index_columns.end())
+                throw SQLExecError(" Cannot include column " + col + " which is already in the index key");
+        index_columns.insert(index_columns.end(), included_columns->begin(), included_columns->end());
+    }
+    // Comapre if the rows exist in table on which we are creating index.
+    for(auto const& col : index_columns)
         if (find(columnNames.begin(), columnNames.end(), col) == columnNames.end())
             throw SQLExecError(" Cannot create index on non existing column in table");
-        row["seq_in_index"] = Value(i++);
+    uint i = 1;
+    for(auto const& col : index_columns){
+        row["seq_in_index"] = Value(i);
         row["column_name"] = Value(col);
+        row["is_included"].n = i > n_key_columns ? 1 : 0;
         indices->insert(&row);
+        i++;
     }
 
     DbIndex &index = indices->get_index(table_name, index_name); 
-    index.create();
-    return new QueryResult("created index "+ index_name); 
+    try {
+        index.create();
+    } catch (...) {
+        // e.g., duplicate keys for a unique index, a file left behind under its name, or an I/O error
+        // -- leave no trace of it
+        try {
+            index.drop();
+        } catch (...) {
+            // nothing (more) of it on disk
+        }
+        delete_index_rows(table_name, index_name);
+        throw;
+    }
+    string report = index.report();
+    return new QueryResult("created index " + index_name + (report.empty() ? "" : " (" + report + ")"));
 }
 
 /*
@@ -267,7 +693,7 @@ QueryResult *SQLExec::drop_table(const DropStatement *statement) {
     // get _column table object.
     DbRelation& _column = tables->get_table(Columns::TABLE_NAME);
 
-    Handles* handles = _column.select(&where);
+    Handles* handles = _column.select(&where);  // found through the _columns key index
     for(Handle handle : *handles){
         _column.del(handle);
     }
@@ -311,12 +737,17 @@ void SQLExec::delete_index_table_row(Identifier table_name, Identifier index_nam
     // Dropping the index 
     DbIndex &dbIndex = indices->get_index(table_name, index_name);
     dbIndex.drop();
+    delete_index_rows(table_name, index_name);
+}
 
-    // deleting row from indices table
+/*
+ * Delete an index's rows from _indices, which also detaches it from its table.
+ */
+void SQLExec::delete_index_rows(Identifier table_name, Identifier index_name) {
     ValueDict where;
     where["table_name"] = Value(table_name);
     where["index_name"] = Value(index_name);
-    Handles* handles = indices->select(&where);    
+    Handles* handles = indices->select(&where);
     for (auto const& handle: *handles) 
         indices->del(handle);
 
@@ -370,15 +801,16 @@ QueryResult* SQLExec::show_index(const Identifier table_name) {
     ValueDict where;
     where["table_name"] = Value(table_name);
 
-    Handles *handles = indices->select(&where);
+    HandleCursor *cursor = indices->cursor(&where);
+    ColumnOrdinals ordinals = indices->get_column_ordinals(resultsColNames);
 
-    ValueDicts *rows = new ValueDicts;
-    for(auto const& handle : *handles) {
-        ValueDict *row = indices->project(handle, resultsColNames);
+    Rows *rows = new Rows;
+    for(auto const& handle : *cursor) {
+        Row *row = indices->project(handle, &ordinals);
         rows->push_back(row);
     }
 
-    delete handles;
+    delete cursor;
     return new QueryResult(resultsColNames, resultsColAttribs, rows,"successfully returned " + to_string(rows->size()) + " rows");
 }
 
@@ -395,16 +827,20 @@ QueryResult *SQLExec::show_tables() {
     // get column names and column attributes of _tables
     tables->get_columns(Tables::TABLE_NAME, *resultsColNames, *resultsColAttribs);
 
-    Handles *handles = tables->select();  // get handles of all the tables entries from tables.
-    ValueDicts *rows = new ValueDicts();
+    HandleCursor *cursor = tables->cursor();  // stream handles of all the tables entries from tables.
+    ColumnOrdinals ordinals = tables->get_column_ordinals(resultsColNames);
+    uint table_name = result_column(resultsColNames, "table_name");
+    Rows *rows = new Rows();
 
-    // Iterate over the handles to get all the rows, add each to the rows ValueDicts vecotr
-    for(Handle handle : *handles) {
-        ValueDict *row = tables->project(handle, resultsColNames);
-        if(row->at("table_name") != Value("_tables") && row->at("table_name") != Value("_columns") && row->at("table_name") != Value("_indices")) 
+    // Iterate over the handles to get all the rows, add each to the rows vector
+    for(Handle handle : *cursor) {
+        Row *row = tables->project(handle, &ordinals);
+        if(row->at(table_name) != Value("_tables") && row->at(table_name) != Value("_columns") && row->at(table_name) != Value("_indices")) 
             rows->push_back(row);
+        else
+            delete row;
     }
-    delete handles;
+    delete cursor;
 
     // Pass the names, attributes, rows, and a message to the query result constructor
     // Query result has an ostream operator for producing text output
@@ -413,57 +849,27 @@ QueryResult *SQLExec::show_tables() {
 
 /*
  * table_exists: check the existance of a table
- * looks for its presence in the _tables table by calling
- * show_tables() and inspecting the results
- * (Room for improvment here!)
+ * looks for it in the catalog, skipping the schema tables
+ * just as show_tables() does
  * used for prettier error handling when the user does something wrong,
  * e.g. tries to drop a table that dosn't exist
  */
 bool SQLExec::table_exists(Identifier table_name_to_check) {
-
-    QueryResult* tables_result = show_tables();
-    //ValueDicts* rows = tables_result->get_rows();
-    bool toReturn = false;
-
-    // Iterate through the rows and check for match
-    for(auto const& r : *(tables_result->get_rows())) {
-        if(r->at("table_name") == table_name_to_check) {
-            toReturn = true;
-            break;
-        }
-    }
-    delete tables_result;
-    return toReturn;
+    if(table_name_to_check == Tables::TABLE_NAME || table_name_to_check == Columns::TABLE_NAME
+            || table_name_to_check == Indices::TABLE_NAME)
+        return false;
+    return Catalog::find_table(table_name_to_check) != nullptr;
 }
 
 /*
  * index_exists: check the existance of an index
  * first calls table_exists to check for a valid table
- * then looks for the existance of the index by calling
- * show_index and looks for the cor
+ * then looks for the index in the catalog
  * used for prettier error handling when the user tries
  * to drop an index that dosn't exist
  */
 bool SQLExec::index_exists(Identifier table_name, Identifier index_name) {
-
-    bool toReturn = false;
-
-    // Check that table exists
-    if(table_exists(table_name)) {
-        // Check if the index eixst by calling show_index on that table
-        QueryResult* indices_result = show_index(table_name);
-        // check if the index name exists
-        for(auto const& r : *(indices_result)->get_rows()) {
-            if(r->at("index_name") == index_name) {
-                toReturn = true;
-                break;
-            }
-        }
-        delete indices_result;
-        return toReturn;
-    }
-    else
-        return false;
+    return table_exists(table_name) && Catalog::find_index(table_name, index_name) != nullptr;
 }
 
 /*
@@ -491,16 +897,81 @@ QueryResult *SQLExec::show_columns(const ShowStatement *statement) {
     where["table_name"] = Value(table_name);
 
     DbRelation &column_table = tables->get_table(Columns::TABLE_NAME);
-    Handles *handles = column_table.select(&where); // get all the handles supporting where clause.
+    HandleCursor *cursor = column_table.cursor(&where); // stream the handles supporting where clause.
 
     // Iterate through the handles to get rows using the project function from MS2
-    // and add rows to the ValueDicts vecotr
-    ValueDicts *rows = new ValueDicts;
-    for(Handle handle : *handles) {
-        ValueDict *row = column_table.project(handle, resultsColNames);
+    // and add rows to the rows vector
+    ColumnOrdinals ordinals = column_table.get_column_ordinals(resultsColNames);
+    Rows *rows = new Rows;
+    for(Handle handle : *cursor) {
+        Row *row = column_table.project(handle, &ordinals);
         rows->push_back(row);
     }
-    delete handles;
+    delete cursor;
 
     return new QueryResult(resultsColNames, resultsColAttribs, rows,"successfully returned " + to_string(rows->size()) + " rows");
 }
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Parse and execute one statement, as sql5300 does, saying what went wrong if it fails.
+static bool test_execute(const string &query) {
+    SQLParserResult* parse = SQLParser::parseSQLString(query);
+    bool ok = parse->isValid() && parse->size() == 1;
+    if (!ok)
+        cout << "invalid SQL: " << query << endl;
+    try {
+        if (ok)
+            delete SQLExec::execute(parse->getStatement(0));
+    } catch (SQLExecError& e) {
+        cout << query << ": " << e.what() << endl;
+        ok = false;
+    }
+    delete parse;
+    return ok;
+}
+
+bool test_sql_exec() {
+    cout << "test_sql_exec: " << endl;
+    if (!test_execute("CREATE TABLE _test_sql_exec (a INT, b TEXT)"))
+        return false;
+    DbRelation& table = Tables::get_table("_test_sql_exec");
+    for (int a = 0; a < 1000; a++) {
+        Row row = {Value(a), Value("b" + to_string(a % 10))};
+        table.insert(&row);
+    }
+
+    // b has 100 rows for each value, which a BTREE index made through SQL has to take
+    bool created = test_execute("CREATE INDEX _test_sql_exec_b ON _test_sql_exec USING BTREE (b)");
+    if (created) {
+        Indices& indices = dynamic_cast<Indices&>(Tables::get_table(Indices::TABLE_NAME));
+        DbIndex& index = indices.get_index("_test_sql_exec", "_test_sql_exec_b");
+        ValueDict key;
+        key["b"] = Value(string("b3"));
+        Handles* handles = index.lookup(&key);
+        created = handles->size() == 100;
+        delete handles;
+    }
+    bool dropped = test_execute("DROP TABLE _test_sql_exec");
+    if (!created || !dropped)
+        return false;
+    cout << "create index over duplicates ok" << endl;
+
+    // a schema table looked up through its key index still rejects columns it doesn't have
+    ValueDict where;
+    where["table_name"] = Value("_test_sql_exec");
+    where["no_such_column"] = Value(1);
+    try {
+        delete Tables::get_table(Tables::TABLE_NAME).select(&where);
+        return false;
+    } catch (DbRelationError& e) {
+        // expected
+    }
+    cout << "unknown column ok" << endl;
+    return true;
+}
@@ -10,6 +10,8 @@
 #include "SQLParser.h"
 #include "schema_tables.h"
 
+class Bitmap;  // in bitmap_index.h
+
 /**
  * @class SQLExecError - exception for SQLExec methods
  */
@@ -29,21 +31,21 @@ public:
     QueryResult(std::string message) : column_names(nullptr), column_attributes(nullptr), rows(nullptr),
                                        message(message) {}
 
-    QueryResult(ColumnNames *column_names, ColumnAttributes *column_attributes, ValueDicts *rows, std::string message)
+    QueryResult(ColumnNames *column_names, ColumnAttributes *column_attributes, Rows *rows, std::string message)
             : column_names(column_names), column_attributes(column_attributes), rows(rows), message(message) {}
 
     virtual ~QueryResult();
 
     ColumnNames *get_column_names() const { return column_names; }
     ColumnAttributes *get_column_attributes() const { return column_attributes; }
-    ValueDicts *get_rows() const { return rows; }
+    Rows *get_rows() const { return rows; }  // each row is positional, matching column_names
     const std::string &get_message() const { return message; }
     friend std::ostream &operator<<(std::ostream &stream, const QueryResult &qres);
 
 protected:
     ColumnNames *column_names;
     ColumnAttributes *column_attributes;
-    ValueDicts *rows;
+    Rows *rows;
     std::string message;
 };
 
@@ -55,30 +57,53 @@ class SQLExec {
 public:
 	/**
 	 * Execute the given SQL statement.  Uses one of the protected functions below
-	 * @param statement   the Hyrise AST of the SQL statement to execute
-	 * @returns           the query result (freed by caller)
+	 * @param statement         the Hyrise AST of the SQL statement to execute
+	 * @param included_columns  for CREATE INDEX, the columns of its INCLUDE clause (see take_include)
+	 * @returns                 the query result (freed by caller)
+	 */
+    static QueryResult *execute(const hsql::SQLStatement *statement,
+                                const ColumnNames *included_columns = nullptr) throw(SQLExecError);
+
+	/**
+	 * Take the INCLUDE ( <columns> ) clause off a CREATE INDEX statement, since the parser
+	 * doesn't know it. Pass the columns on to execute() along with the parsed statement.
+	 * @param query             SQL text of a statement
+	 * @param included_columns  returned by reference: the columns of the clause (empty if it wasn't taken off)
+	 * @returns                 the query without the clause (unchanged if there isn't one)
 	 */
-    static QueryResult *execute(const hsql::SQLStatement *statement) throw(SQLExecError);
+    static std::string take_include(const std::string &query, ColumnNames &included_columns);
+
+	/**
+	 * Execute SHOW TABLE STATUS, which the parser doesn't know either: each table's number of rows,
+	 * bytes of row data and blocks, from the counts kept in its file (so no table is scanned).
+	 * @param query  SQL text of a statement
+	 * @returns      the query result (freed by caller), or nullptr if the query is something else
+	 */
+    static QueryResult *show_table_status(const std::string &query) throw(SQLExecError);
 
 protected:
 	// the one place in the system that holds the _tables table and _indices table
     static Tables *tables;
 	static Indices *indices;
 
-	// recursive decent into the AST: starts with create(...), drop(...) or show(...)
+    // Make the singletons above, the first time through
+    static void open_schema_tables();
+
+	// recursive decent into the AST: starts with create(...), drop(...), show(...) or import(...)
     // FIXME in the future will also need support for select(...), insert(...) &c...
 
     // Create a new Table or Index - determines which type of CreateStatement is passed
     // and calls the correct create_ function
-    static QueryResult *create(const hsql::CreateStatement *statement);
+    static QueryResult *create(const hsql::CreateStatement *statement, const ColumnNames *included_columns);
 
     // Create a new table: adds table name to _tables, and adds columns (names + datatypes)
     // to the _columns table
     static QueryResult *create_table(const hsql::CreateStatement *statement);
 
     // Create a new index: adds a new row containg the index information to the _indices
-    // table.  For now (FIXME) assumes a BTREE type with is_unique = true
-   static QueryResult *create_index(const hsql::CreateStatement *statement);
+    // table, then builds it. The index is never unique (the parser has no CREATE UNIQUE INDEX)
+    // Included columns get rows too, numbered after the key columns and marked is_included
+   static QueryResult *create_index(const hsql::CreateStatement *statement, const ColumnNames *included_columns);
 
     // Drop a table or an index: check which type of DropStatement is passed
     // and calls the correct drop_ function
@@ -89,9 +114,27 @@ protected:
     static QueryResult *drop_table(const hsql::DropStatement *statement);
 
     // Drop an index.  The corresponding row is removed from the _indices file
-    // FIXME will need to actualy delete the index storage file once that is implemented
+    // and the index storage file is deleted
     static QueryResult *drop_index(const hsql::DropStatement *statement);
 
+    // Select rows from one table, with an optional WHERE of column = literal conditions joined
+    // by AND. Answered from a covering index alone when there is one (an index-only scan)
+    static QueryResult *select(const hsql::SelectStatement *statement);
+
+    // SELECT COUNT(*): the table's row count when there is no WHERE clause (no rows are read),
+    // otherwise the number of rows that qualify (counted from the bitmaps when where_bitmap() can)
+    static QueryResult *select_count(DbRelation &table, const ValueDict &where);
+
+    // The rows meeting every condition of a WHERE clause, ANDed from the table's BITMAP indices,
+    // or nullptr if some condition has none (freed by caller)
+    static Bitmap *where_bitmap(const Identifier &table_name, const ValueDict &where);
+
+    // Pull the column = literal conditions out of a WHERE clause into where
+    static void where_conditions(const hsql::Expr *expr, ValueDict &where);
+
+    // Bulk load a CSV file into a table (COPY ... FROM). Reports rows/s and MB/s
+    static QueryResult *import(const hsql::ImportStatement *statement);
+
     // Show tables, columns, or an index.  Calls the appropriate show_ function
     static QueryResult *show(const hsql::ShowStatement *statement);
 
@@ -116,12 +159,18 @@ protected:
     // specifc index name
     static void delete_index_table_row(Identifier table_name, Identifier index_name);
 
+    // Deletes the rows of an index from _indices (which detaches it from its table), leaving its file
+    static void delete_index_rows(Identifier table_name, Identifier index_name);
+
     // Shows the indices associated with a given table
     // the rows of the _indices table where the table name is a match
     // overloaded to take statment or directly take Identifier as table name
     static QueryResult *show_index(const hsql::ShowStatement *statement);
     static QueryResult *show_index(const Identifier table_name);
 
+    // Position of the named column within the (positional) rows of a QueryResult
+    static uint result_column(const ColumnNames *column_names, const Identifier &column_name);
+
 	/**
 	 * Pull out column name and attributes from AST's column definition clause
 	 * @param col                AST column definition
@@ -131,3 +180,4 @@ protected:
     static void column_definition(const hsql::ColumnDefinition *col, Identifier &column_name, ColumnAttribute &column_attribute);
 };
 
+bool test_sql_exec();
@@ -0,0 +1,687 @@
+/**
+ * @file art_index.cpp - implementation of:
+ * ARTIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <algorithm>
+#include <random>
+#include "art_index.h"
+using namespace std;
+
+// a node shrinks to the next size down once it has this few children
+static const uint NODE16_MIN = 3;
+static const uint NODE48_MIN = 12;
+static const uint NODE256_MIN = 37;
+
+// Heap bytes of a string beyond its own object (short strings fit inside it in libstdc++).
+static uint64_t string_bytes(const string &s) {
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+// Every key in a subtree starts with path: all of them are before min if path is before min's first
+// bytes, and all after max if it is after max's.
+static bool outside(const string &path, const KeyBytes *min, const KeyBytes *max) {
+    return (min != nullptr && path.compare(0, path.size(), *min, 0, path.size()) < 0)
+           || (max != nullptr && path.compare(0, path.size(), *max, 0, path.size()) > 0);
+}
+
+ARTIndex::ARTIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), closed(true), root(nullptr), n_keys(0),
+          key_profile(::key_profile(relation, key_columns)), key_ordinals(relation.get_column_ordinals(&key_columns)) {
+    if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+}
+
+ARTIndex::~ARTIndex() {
+    close();
+}
+
+// Nothing is kept on disk, so creating is just building the tree.
+void ARTIndex::create() {
+    open();
+}
+
+void ARTIndex::drop() {
+    close();
+}
+
+// Build the tree from the relation.
+void ARTIndex::open() {
+    if (!this->closed)
+        return;
+    this->closed = false;
+    try {
+        build();
+    } catch (DbRelationError &e) {
+        close();
+        throw;
+    }
+}
+
+void ARTIndex::close() {
+    if (this->closed)
+        return;
+    free_nodes(this->root);
+    this->root = nullptr;
+    this->n_keys = 0;
+    this->closed = true;
+}
+
+// All the rows with exactly the given key.
+Handles* ARTIndex::lookup(ValueDict* key_values) const {
+    const_cast<ARTIndex*>(this)->open();
+    const Leaf *leaf = find(encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values)));
+    return leaf == nullptr ? new Handles() : new Handles(leaf->handles);
+}
+
+// All the rows with keys from min_key to max_key (either can be nullptr for no limit), in key order.
+Handles* ARTIndex::range(ValueDict* min_key, ValueDict* max_key) const {
+    const_cast<ARTIndex*>(this)->open();
+    KeyBytes min_value, max_value;
+    if (min_key != nullptr)
+        min_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, min_key));
+    if (max_key != nullptr)
+        max_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, max_key));
+    Handles *handles = new Handles();
+    string path;
+    collect(this->root, path, min_key == nullptr ? nullptr : &min_value, max_key == nullptr ? nullptr : &max_value,
+            handles);
+    return handles;
+}
+
+void ARTIndex::insert(Handle record) {
+    open();
+    if (!add(this->root, row_key(this->relation, this->key_profile, this->key_ordinals, record), 0, record))
+        throw DbRelationError("duplicate key for unique index " + this->name);
+}
+
+// Called while the row is still there, so its key can be read.
+void ARTIndex::del(Handle record) {
+    open();
+    remove(this->root, row_key(this->relation, this->key_profile, this->key_ordinals, record), 0, record);
+}
+
+std::string ARTIndex::report() const {
+    return to_string(this->n_keys) + " keys in " + to_string(get_size() / 1024) + "KB (in memory)";
+}
+
+uint64_t ARTIndex::get_size() const {
+    return this->root == nullptr ? 0 : size(this->root);
+}
+
+void ARTIndex::build() {
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor)
+            if (!add(this->root, row_key(this->relation, this->key_profile, this->key_ordinals, handle), 0, handle))
+                throw DbRelationError("duplicate key for unique index " + this->name);
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+}
+
+// Follow the key's bytes down, matching each node's prefix on the way, to the leaf at the end.
+const ARTIndex::Leaf* ARTIndex::find(const KeyBytes &key) const {
+    const Node *node = this->root;
+    uint depth = 0;
+    while (node != nullptr) {
+        if (node->kind == LEAF) {
+            const Leaf *leaf = (const Leaf *) node;
+            return leaf->key == key ? leaf : nullptr;
+        }
+        Inner *inner = (Inner *) node;
+        if (key.compare(depth, inner->prefix.size(), inner->prefix) != 0)
+            return nullptr;
+        depth += (uint) inner->prefix.size();
+        if (depth >= key.size())
+            return nullptr;
+        Node **child = find_child(inner, (uint8_t) key[depth++]);
+        node = child == nullptr ? nullptr : *child;
+    }
+    return nullptr;
+}
+
+// Add the handle under the key in the subtree at node, whose path so far matches depth bytes of the
+// key. Where the key parts from an existing path (a leaf's key or a node's prefix), a Node4 is put in
+// with the two as its children. Returns false if the index is unique and already has the key.
+bool ARTIndex::add(Node *&node, const KeyBytes &key, uint depth, Handle handle) {
+    if (node == nullptr) {
+        Leaf *leaf = new Leaf(key);
+        leaf->handles.push_back(handle);
+        node = leaf;
+        this->n_keys++;
+        return true;
+    }
+
+    if (node->kind == LEAF) {
+        Leaf *leaf = (Leaf *) node;
+        if (leaf->key == key) {
+            if (this->unique && !leaf->handles.empty())
+                return false;
+            leaf->handles.push_back(handle);
+            return true;
+        }
+        uint common = depth;
+        while (common < key.size() && common < leaf->key.size() && key[common] == leaf->key[common])
+            common++;
+        if (common == key.size() || common == leaf->key.size())
+            throw DbRelationError("key is a prefix of another in index " + this->name);
+        Inner *branch = new Node4();
+        branch->prefix = key.substr(depth, common - depth);
+        add_child(branch, (uint8_t) leaf->key[common], leaf);
+        Leaf *fresh = new Leaf(key);
+        fresh->handles.push_back(handle);
+        add_child(branch, (uint8_t) key[common], fresh);
+        node = branch;
+        this->n_keys++;
+        return true;
+    }
+
+    Inner *inner = (Inner *) node;
+    uint matched = 0;
+    while (matched < inner->prefix.size() && depth + matched < key.size()
+           && inner->prefix[matched] == key[depth + matched])
+        matched++;
+    if (depth + matched >= key.size())
+        throw DbRelationError("key is a prefix of another in index " + this->name);
+    if (matched < inner->prefix.size()) {
+        Inner *branch = new Node4();
+        branch->prefix = inner->prefix.substr(0, matched);
+        uint8_t byte = (uint8_t) inner->prefix[matched];
+        inner->prefix.erase(0, matched + 1);
+        add_child(branch, byte, inner);
+        Leaf *fresh = new Leaf(key);
+        fresh->handles.push_back(handle);
+        add_child(branch, (uint8_t) key[depth + matched], fresh);
+        node = branch;
+        this->n_keys++;
+        return true;
+    }
+
+    depth += (uint) inner->prefix.size();
+    Node **child = find_child(inner, (uint8_t) key[depth]);
+    if (child != nullptr)
+        return add(*child, key, depth + 1, handle);
+    Leaf *fresh = new Leaf(key);
+    fresh->handles.push_back(handle);
+    add_child(inner, (uint8_t) key[depth], fresh);
+    node = inner;
+    this->n_keys++;
+    return true;
+}
+
+// Take the handle off the key's leaf, and the leaf out of the tree once it has no handles left,
+// shrinking or collapsing the nodes above it as they empty. Returns false if there was no such entry.
+bool ARTIndex::remove(Node *&node, const KeyBytes &key, uint depth, Handle handle) {
+    if (node == nullptr)
+        return false;
+    if (node->kind == LEAF) {
+        Leaf *leaf = (Leaf *) node;
+        if (leaf->key != key)
+            return false;
+        auto found = std::find(leaf->handles.begin(), leaf->handles.end(), handle);
+        if (found == leaf->handles.end())
+            return false;
+        leaf->handles.erase(found);
+        if (leaf->handles.empty()) {
+            delete leaf;
+            node = nullptr;
+            this->n_keys--;
+        }
+        return true;
+    }
+
+    Inner *inner = (Inner *) node;
+    if (key.compare(depth, inner->prefix.size(), inner->prefix) != 0)
+        return false;
+    depth += (uint) inner->prefix.size();
+    if (depth >= key.size())
+        return false;
+    uint8_t byte = (uint8_t) key[depth];
+    Node **child = find_child(inner, byte);
+    if (child == nullptr || !remove(*child, key, depth + 1, handle))
+        return false;
+    if (*child == nullptr) {
+        remove_child(inner, byte);
+        node = inner;
+        collapse(node);
+    }
+    return true;
+}
+
+// Append the handles of the keys from min to max under node, in key order. path holds the bytes of
+// every key under node that come before its prefix.
+void ARTIndex::collect(const Node *node, string &path, const KeyBytes *min, const KeyBytes *max,
+                       Handles *handles) const {
+    if (node == nullptr)
+        return;
+    if (node->kind == LEAF) {
+        const Leaf *leaf = (const Leaf *) node;
+        if ((min == nullptr || leaf->key >= *min) && (max == nullptr || leaf->key <= *max))
+            handles->insert(handles->end(), leaf->handles.begin(), leaf->handles.end());
+        return;
+    }
+    const Inner *inner = (const Inner *) node;
+    size_t mark = path.size();
+    path += inner->prefix;
+    if (!outside(path, min, max)) {
+        for (uint b = 0; b < 256; b++) {
+            Node **child = find_child(const_cast<Inner *>(inner), (uint8_t) b);
+            if (child == nullptr)
+                continue;
+            path.push_back((char) b);
+            if (!outside(path, min, max))
+                collect(*child, path, min, max, handles);
+            path.pop_back();
+        }
+    }
+    path.resize(mark);
+}
+
+// Slot of the child for the byte, or nullptr if there is none.
+ARTIndex::Node** ARTIndex::find_child(Inner *node, uint8_t byte) {
+    switch (node->kind) {
+        case NODE4: {
+            Node4 *n = (Node4 *) node;
+            for (uint i = 0; i < n->n_children; i++)
+                if (n->keys[i] == byte)
+                    return &n->children[i];
+            return nullptr;
+        }
+        case NODE16: {
+            Node16 *n = (Node16 *) node;
+            uint8_t *at = std::lower_bound(n->keys, n->keys + n->n_children, byte);
+            if (at == n->keys + n->n_children || *at != byte)
+                return nullptr;
+            return &n->children[at - n->keys];
+        }
+        case NODE48: {
+            Node48 *n = (Node48 *) node;
+            return n->slots[byte] == 0 ? nullptr : &n->children[n->slots[byte] - 1];
+        }
+        case NODE256: {
+            Node256 *n = (Node256 *) node;
+            return n->children[byte] == nullptr ? nullptr : &n->children[byte];
+        }
+        default:
+            return nullptr;
+    }
+}
+
+// Add a child for a byte not yet in the node, first growing the node into the next size if it is
+// full (node is then the new one).
+void ARTIndex::add_child(Inner *&node, uint8_t byte, Node *child) {
+    switch (node->kind) {
+        case NODE4: {
+            Node4 *n = (Node4 *) node;
+            if (n->n_children == 4) {
+                Node16 *grown = new Node16();
+                copy(n->keys, n->keys + 4, grown->keys);
+                copy(n->children, n->children + 4, grown->children);
+                grown->n_children = 4;
+                grown->prefix.swap(n->prefix);
+                delete n;
+                node = grown;
+                add_child(node, byte, child);
+                return;
+            }
+            uint i = (uint) (std::lower_bound(n->keys, n->keys + n->n_children, byte) - n->keys);
+            copy_backward(n->keys + i, n->keys + n->n_children, n->keys + n->n_children + 1);
+            copy_backward(n->children + i, n->children + n->n_children, n->children + n->n_children + 1);
+            n->keys[i] = byte;
+            n->children[i] = child;
+            n->n_children++;
+            return;
+        }
+        case NODE16: {
+            Node16 *n = (Node16 *) node;
+            if (n->n_children == 16) {
+                Node48 *grown = new Node48();
+                for (uint i = 0; i < 16; i++) {
+                    grown->slots[n->keys[i]] = (uint8_t) (i + 1);
+                    grown->children[i] = n->children[i];
+                }
+                grown->n_children = 16;
+                grown->prefix.swap(n->prefix);
+                delete n;
+                node = grown;
+                add_child(node, byte, child);
+                return;
+            }
+            uint i = (uint) (std::lower_bound(n->keys, n->keys + n->n_children, byte) - n->keys);
+            copy_backward(n->keys + i, n->keys + n->n_children, n->keys + n->n_children + 1);
+            copy_backward(n->children + i, n->children + n->n_children, n->children + n->n_children + 1);
+            n->keys[i] = byte;
+            n->children[i] = child;
+            n->n_children++;
+            return;
+        }
+        case NODE48: {
+            Node48 *n = (Node48 *) node;
+            if (n->n_children == 48) {
+                Node256 *grown = new Node256();
+                for (uint b = 0; b < 256; b++)
+                    if (n->slots[b] != 0)
+                        grown->children[b] = n->children[n->slots[b] - 1];
+                grown->n_children = 48;
+                grown->prefix.swap(n->prefix);
+                delete n;
+                node = grown;
+                add_child(node, byte, child);
+                return;
+            }
+            uint i = 0;
+            while (n->children[i] != nullptr)  // a free slot (removals leave holes)
+                i++;
+            n->children[i] = child;
+            n->slots[byte] = (uint8_t) (i + 1);
+            n->n_children++;
+            return;
+        }
+        case NODE256: {
+            Node256 *n = (Node256 *) node;
+            n->children[byte] = child;
+            n->n_children++;
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+// Drop the byte's child slot (the child itself is already gone), shrinking the node into the next
+// size down once it has few enough children (node is then the new one).
+void ARTIndex::remove_child(Inner *&node, uint8_t byte) {
+    switch (node->kind) {
+        case NODE4:
+        case NODE16: {
+            uint8_t *keys = node->kind == NODE4 ? ((Node4 *) node)->keys : ((Node16 *) node)->keys;
+            Node **children = node->kind == NODE4 ? ((Node4 *) node)->children : ((Node16 *) node)->children;
+            uint i = (uint) (std::find(keys, keys + node->n_children, byte) - keys);
+            copy(keys + i + 1, keys + node->n_children, keys + i);
+            copy(children + i + 1, children + node->n_children, children + i);
+            node->n_children--;
+            if (node->kind == NODE16 && node->n_children <= NODE16_MIN) {
+                Node4 *shrunk = new Node4();
+                copy(keys, keys + node->n_children, shrunk->keys);
+                copy(children, children + node->n_children, shrunk->children);
+                shrunk->n_children = node->n_children;
+                shrunk->prefix.swap(node->prefix);
+                delete (Node16 *) node;
+                node = shrunk;
+            }
+            return;
+        }
+        case NODE48: {
+            Node48 *n = (Node48 *) node;
+            n->children[n->slots[byte] - 1] = nullptr;
+            n->slots[byte] = 0;
+            n->n_children--;
+            if (n->n_children <= NODE48_MIN) {
+                Node16 *shrunk = new Node16();
+                for (uint b = 0; b < 256; b++)
+                    if (n->slots[b] != 0) {
+                        shrunk->keys[shrunk->n_children] = (uint8_t) b;
+                        shrunk->children[shrunk->n_children++] = n->children[n->slots[b] - 1];
+                    }
+                shrunk->prefix.swap(n->prefix);
+                delete n;
+                node = shrunk;
+            }
+            return;
+        }
+        case NODE256: {
+            Node256 *n = (Node256 *) node;
+            n->children[byte] = nullptr;
+            n->n_children--;
+            if (n->n_children <= NODE256_MIN) {
+                Node48 *shrunk = new Node48();
+                for (uint b = 0; b < 256; b++)
+                    if (n->children[b] != nullptr) {
+                        shrunk->children[shrunk->n_children] = n->children[b];
+                        shrunk->slots[b] = (uint8_t) ++shrunk->n_children;
+                    }
+                shrunk->prefix.swap(n->prefix);
+                delete n;
+                node = shrunk;
+            }
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+// A Node4 left with one child gives way to it: a leaf moves up as it is, and an interior child
+// takes on the node's prefix and the byte that led to it in front of its own prefix.
+void ARTIndex::collapse(Node *&node) {
+    if (node->kind != NODE4 || ((Node4 *) node)->n_children != 1)
+        return;
+    Node4 *n = (Node4 *) node;
+    Node *child = n->children[0];
+    if (child->kind != LEAF) {
+        Inner *inner = (Inner *) child;
+        inner->prefix = n->prefix + (char) n->keys[0] + inner->prefix;
+    }
+    delete n;
+    node = child;
+}
+
+// Bytes of memory under a node.
+uint64_t ARTIndex::size(const Node *node) {
+    switch (node->kind) {
+        case LEAF: {
+            const Leaf *leaf = (const Leaf *) node;
+            return sizeof(Leaf) + string_bytes(leaf->key) + leaf->handles.capacity() * sizeof(Handle);
+        }
+        case NODE4: {
+            const Node4 *n = (const Node4 *) node;
+            uint64_t bytes = sizeof(Node4) + string_bytes(n->prefix);
+            for (uint i = 0; i < n->n_children; i++)
+                bytes += size(n->children[i]);
+            return bytes;
+        }
+        case NODE16: {
+            const Node16 *n = (const Node16 *) node;
+            uint64_t bytes = sizeof(Node16) + string_bytes(n->prefix);
+            for (uint i = 0; i < n->n_children; i++)
+                bytes += size(n->children[i]);
+            return bytes;
+        }
+        case NODE48: {
+            const Node48 *n = (const Node48 *) node;
+            uint64_t bytes = sizeof(Node48) + string_bytes(n->prefix);
+            for (auto const &child: n->children)
+                if (child != nullptr)
+                    bytes += size(child);
+            return bytes;
+        }
+        default: {
+            const Node256 *n = (const Node256 *) node;
+            uint64_t bytes = sizeof(Node256) + string_bytes(n->prefix);
+            for (auto const &child: n->children)
+                if (child != nullptr)
+                    bytes += size(child);
+            return bytes;
+        }
+    }
+}
+
+void ARTIndex::free_nodes(Node *node) {
+    if (node == nullptr)
+        return;
+    switch (node->kind) {
+        case LEAF:
+            delete (Leaf *) node;
+            return;
+        case NODE4: {
+            Node4 *n = (Node4 *) node;
+            for (uint i = 0; i < n->n_children; i++)
+                free_nodes(n->children[i]);
+            delete n;
+            return;
+        }
+        case NODE16: {
+            Node16 *n = (Node16 *) node;
+            for (uint i = 0; i < n->n_children; i++)
+                free_nodes(n->children[i]);
+            delete n;
+            return;
+        }
+        case NODE48: {
+            Node48 *n = (Node48 *) node;
+            for (auto const &child: n->children)
+                free_nodes(child);
+            delete n;
+            return;
+        }
+        default: {
+            Node256 *n = (Node256 *) node;
+            for (auto const &child: n->children)
+                free_nodes(child);
+            delete n;
+            return;
+        }
+    }
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Check that the unique index finds exactly the row for each a in the list.
+bool test_art_lookups(DbRelation &table, DbIndex &index, const vector<int> &keys) {
+    ColumnNames column_a = {"a"};
+    ValueDict key;
+    for (auto const &a: keys) {
+        key["a"] = Value(a);
+        Handles* handles = index.lookup(&key);
+        bool found = handles->size() == 1;
+        if (found) {
+            ValueDict* values = table.project(handles->at(0), &column_a);
+            found = (*values)["a"] == Value(a);
+            delete values;
+        }
+        delete handles;
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+bool test_art_index() {
+    cout << "test_art_index: " << endl;
+    ColumnNames column_names = {"a", "b"};
+    const int n = 3000;
+    HeapTable table("_test_art_cpp", column_names,
+                    {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)});
+    test_fill_table(table, -n / 2, n / 2);  // negative and positive: both halves of the first byte
+    vector<int> keys;
+    for (int a = -n / 2; a < n / 2; a++)
+        keys.push_back(a);
+
+    ARTIndex index_a(table, "art_a", {"a"}, true);
+    ARTIndex index_b(table, "art_b", {"b"}, false);
+    index_a.create();
+    index_b.create();
+    table.attach_index(&index_a);
+    table.attach_index(&index_b);
+    if (index_a.get_n_keys() != n || index_b.get_n_keys() != 100 || !test_art_lookups(table, index_a, keys))
+        return false;
+    ValueDict key;
+    key["b"] = Value("b17");
+    Handles* handles = index_b.lookup(&key);
+    bool found = handles->size() == n / 100;
+    delete handles;
+    key["b"] = Value("b1");
+    handles = index_b.lookup(&key);
+    found = found && handles->size() == n / 100;  // a prefix of "b17" as text, but not encoded
+    delete handles;
+    key.clear();
+    key["a"] = Value(n);
+    handles = index_a.lookup(&key);
+    found = found && handles->empty();
+    delete handles;
+    if (!found)
+        return false;
+    cout << "lookup ok" << endl;
+
+    ValueDict min_key, max_key;
+    min_key["a"] = Value(-50);
+    max_key["a"] = Value(49);
+    handles = index_a.range(&min_key, &max_key);
+    bool range_ok = handles->size() == 100;
+    for (uint i = 0; range_ok && i < handles->size(); i++) {
+        ValueDict* values = table.project(handles->at(i), &column_names);
+        range_ok = (*values)["a"] == Value(-50 + (int) i);
+        delete values;
+    }
+    delete handles;
+    handles = index_a.range(nullptr, &min_key);
+    range_ok = range_ok && handles->size() == n / 2 - 50 + 1;
+    delete handles;
+    handles = index_a.range(&max_key, nullptr);
+    range_ok = range_ok && handles->size() == n / 2 - 49;
+    delete handles;
+    if (!range_ok)
+        return false;
+    cout << "range ok" << endl;
+
+    Row row = {Value(17), Value(string("dup"))};
+    bool duplicate = false;
+    try {
+        table.insert(&row);
+    } catch (DbRelationError &e) {
+        duplicate = true;
+    }
+    if (!duplicate || index_b.get_n_keys() != 100)
+        return false;
+
+    // delete all but a few rows in random order, so that nodes shrink and collapse as they empty
+    mt19937 random(5300);
+    shuffle(keys.begin(), keys.end(), random);
+    vector<int> kept(keys.begin(), keys.begin() + 5);
+    for (auto a = keys.begin() + 5; a != keys.end(); a++) {
+        key["a"] = Value(*a);
+        handles = index_a.lookup(&key);
+        for (auto const& handle: *handles)
+            table.del(handle);
+        delete handles;
+    }
+    if (index_a.get_n_keys() != kept.size() || !test_art_lookups(table, index_a, kept))
+        return false;
+    key["a"] = Value(keys[5]);
+    handles = index_a.lookup(&key);
+    bool deleted = handles->empty();
+    delete handles;
+    if (!deleted)
+        return false;
+    for (int a = n; a < 2 * n; a++) {
+        Row more = {Value(a), Value(string("more"))};
+        table.insert(&more);
+        kept.push_back(a);
+    }
+    if (index_a.get_n_keys() != kept.size() || !test_art_lookups(table, index_a, kept))
+        return false;
+    cout << "insert/delete ok" << endl;
+
+    table.detach_index(&index_a);
+    table.detach_index(&index_b);
+    index_a.close();
+    index_a.open();
+    if (index_a.get_n_keys() != kept.size() || !test_art_lookups(table, index_a, kept))
+        return false;
+    cout << "close/open ok" << endl;
+
+    index_a.drop();
+    index_b.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file art_index.h - in-memory adaptive radix tree implementation of DbIndex.
+ * ARTIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <cstdint>
+#include "heap_storage.h"
+#include "index_key.h"
+
+/**
+ * @class ARTIndex - adaptive radix tree over the encoded keys (see encode_key()), held in memory
+ * (index type ART), for tables small enough, or hot enough, that their index lookups shouldn't go
+ * through the buffer pool.
+ *
+ * Each interior node branches on one byte of the key and comes in four sizes, grown and shrunk as
+ * children come and go:
+ *      Node4, Node16: up to 4 or 16 key bytes, sorted, with a child for each
+ *      Node48:        a 256-entry byte-to-slot table and up to 48 children
+ *      Node256:       a child for every byte value
+ * A node also keeps the bytes that all keys below it share (path compression), so a chain of
+ * one-child nodes is never built. Leaves hold the whole key and the handles of its rows. Encoded
+ * keys of an index never are a prefix of one another, which is what lets a leaf end any path.
+ *
+ * Nothing is written to disk: the tree is built from the relation by create() and open(), and
+ * kept in step by insert() and del().
+ */
+class ARTIndex : public DbIndex {
+public:
+	ARTIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique);
+	virtual ~ARTIndex();
+	ARTIndex(const ARTIndex& other) = delete;
+	ARTIndex(ARTIndex&& temp) = delete;
+	ARTIndex& operator=(const ARTIndex& other) = delete;
+	ARTIndex& operator=(ARTIndex&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual Handles* range(ValueDict* min_key, ValueDict* max_key) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+	virtual std::string report() const;
+
+	/**
+	 * Number of distinct keys.
+	 * @returns  number of leaves
+	 */
+	virtual uint64_t get_n_keys() const { return n_keys; }
+
+	/**
+	 * Bytes of memory used by the nodes, leaves and their keys and handles.
+	 * @returns  footprint in bytes
+	 */
+	virtual uint64_t get_size() const;
+
+protected:
+	enum Kind : uint8_t { LEAF, NODE4, NODE16, NODE48, NODE256 };
+
+	struct Node {
+		Kind kind;
+		Node(Kind kind) : kind(kind) {}
+	};
+
+	struct Leaf : Node {
+		KeyBytes key;
+		Handles handles;
+
+		Leaf(const KeyBytes &key) : Node(LEAF), key(key), handles() {}
+	};
+
+	struct Inner : Node {
+		uint16_t n_children;
+		std::string prefix;  // bytes shared by every key below, after the byte leading here
+
+		Inner(Kind kind) : Node(kind), n_children(0), prefix() {}
+	};
+
+	struct Node4 : Inner {
+		uint8_t keys[4];
+		Node *children[4];
+
+		Node4() : Inner(NODE4), keys(), children() {}
+	};
+
+	struct Node16 : Inner {
+		uint8_t keys[16];
+		Node *children[16];
+
+		Node16() : Inner(NODE16), keys(), children() {}
+	};
+
+	struct Node48 : Inner {
+		uint8_t slots[256];  // 0 for no child, otherwise 1 + index in children
+		Node *children[48];
+
+		Node48() : Inner(NODE48), slots(), children() {}
+	};
+
+	struct Node256 : Inner {
+		Node *children[256];
+
+		Node256() : Inner(NODE256), children() {}
+	};
+
+	bool closed;
+	Node *root;
+	uint64_t n_keys;
+	KeyProfile key_profile;
+	ColumnOrdinals key_ordinals;
+
+	virtual void build();
+	virtual const Leaf* find(const KeyBytes &key) const;
+	virtual bool add(Node *&node, const KeyBytes &key, uint depth, Handle handle);
+	virtual bool remove(Node *&node, const KeyBytes &key, uint depth, Handle handle);
+	virtual void collect(const Node *node, std::string &path, const KeyBytes *min, const KeyBytes *max,
+	                     Handles *handles) const;
+
+	static Node** find_child(Inner *node, uint8_t byte);
+	static void add_child(Inner *&node, uint8_t byte, Node *child);
+	static void remove_child(Inner *&node, uint8_t byte);
+	static void collapse(Node *&node);
+	static uint64_t size(const Node *node);
+	static void free_nodes(Node *node);
+};
+
+bool test_art_index();
@@ -0,0 +1,1144 @@
+/**
+ * @file benchmark.cpp - storage engine benchmarks
+ * Run as: benchmark dbenvpath [benchmark_name ...]
+ * With no names, all the benchmarks are run. Each one works on its own scratch tables and drops them.
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include "db_cxx.h"
+#include "heap_storage.h"
+#include "schema_tables.h"
+#include "btree.h"
+#include "hash_index.h"
+#include "bloom_filter.h"
+#include "bitmap_index.h"
+#include "olc_btree.h"
+#include "art_index.h"
+#include "index_key.h"
+using namespace std;
+
+DbEnv *_DB_ENV;
+BufferPool *_BUFFER_POOL;
+FilePool *_FILE_POOL;
+static string env_home;
+
+// seconds since start
+static double elapsed(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// size on disk of the Berkeley DB file for a table
+static long file_size(string table_name) {
+    struct stat st;
+    if (stat((env_home + "/" + table_name + ".db").c_str(), &st) != 0)
+        return -1;
+    return (long) st.st_size;
+}
+
+// (a INT, b TEXT, c BOOLEAN) -- same shape as test_heap_storage
+static void bench_columns(ColumnNames &column_names, ColumnAttributes &column_attributes) {
+    column_names = {"a", "b", "c"};
+    column_attributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT),
+                         ColumnAttribute(ColumnAttribute::BOOLEAN)};
+}
+
+static void bench_row(ValueDict &row, int a, uint text_len) {
+    row["a"] = Value(a);
+    row["b"] = Value(string(text_len, (char) ('a' + a % 26)));
+    row["c"] = Value(a % 2 == 0);
+}
+
+// time a full select() plus project() of every row
+static double scan_time(DbRelation &table, size_t &rows) {
+    auto start = chrono::steady_clock::now();
+    Handles *handles = table.select();
+    for (auto const &handle: *handles)
+        delete table.project(handle);
+    rows = handles->size();
+    delete handles;
+    return elapsed(start);
+}
+
+/*
+ * churn: insert a table, then repeatedly delete a random half of it and insert as many
+ * rows again. Without space reuse the file grows every round; with it, it should level off.
+ */
+static void bench_churn() {
+    const int N = 20000, ROUNDS = 5;
+    const uint TEXT_LEN = 80;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_churn", column_names, column_attributes);
+    table.create();
+
+    ValueDict row;
+    Handles live;
+    int next = 0;
+    for (int i = 0; i < N; i++) {
+        bench_row(row, next++, TEXT_LEN);
+        live.push_back(table.insert(&row));
+    }
+    table.close();
+    table.open();
+    size_t rows;
+    double secs = scan_time(table, rows);
+    cout << "churn: round 0: " << rows << " rows, file " << file_size("_bench_churn") / 1024 << "kB, scan "
+         << secs * 1000 << "ms" << endl;
+
+    mt19937 rng(5300);
+    for (int round = 1; round <= ROUNDS; round++) {
+        shuffle(live.begin(), live.end(), rng);
+        for (int i = 0; i < N / 2; i++)
+            table.del(live[i]);
+        live.erase(live.begin(), live.begin() + N / 2);
+        for (int i = 0; i < N / 2; i++) {
+            bench_row(row, next++, TEXT_LEN);
+            live.push_back(table.insert(&row));
+        }
+        table.close();  // write everything back so the file size is current
+        table.open();
+        secs = scan_time(table, rows);
+        cout << "churn: round " << round << ": " << rows << " rows, file " << file_size("_bench_churn") / 1024
+             << "kB, scan " << secs * 1000 << "ms" << endl;
+    }
+    table.drop();
+}
+
+// fill an empty page with records of the given size
+static RecordIDs fill_page(SlottedPage &page, uint size) {
+    char bytes[DbBlock::BLOCK_SZ];
+    memset(bytes, 'x', size);
+    Dbt data(bytes, size);
+    RecordIDs ids;
+    try {
+        while (true)
+            ids.push_back(page.add(&data));
+    } catch (DbBlockNoRoomError &e) {
+        // full
+    }
+    return ids;
+}
+
+/*
+ * page: SlottedPage del() and put() throughput on full pages of small records.
+ * Deletes hit every record of the page in random order. Puts alternately shrink and
+ * regrow every record.
+ */
+static void bench_page() {
+    const int PAGES = 2000;
+    const uint SIZE = 32;
+    char buffer[DbBlock::BLOCK_SZ];
+    mt19937 rng(5300);
+
+    long ops = 0;
+    double secs = 0;
+    for (int i = 0; i < PAGES; i++) {
+        Dbt block(buffer, sizeof(buffer));
+        SlottedPage page(block, 1, true);
+        RecordIDs ids = fill_page(page, SIZE);
+        shuffle(ids.begin(), ids.end(), rng);
+        auto start = chrono::steady_clock::now();
+        for (auto const &id: ids)
+            page.del(id);
+        secs += elapsed(start);
+        ops += ids.size();
+    }
+    cout << "page: del " << ops / secs << " ops/s" << endl;
+
+    char bytes[DbBlock::BLOCK_SZ];
+    memset(bytes, 'y', sizeof(bytes));
+    Dbt small(bytes, SIZE - 8), large(bytes, SIZE);
+    ops = 0;
+    secs = 0;
+    for (int i = 0; i < PAGES; i++) {
+        Dbt block(buffer, sizeof(buffer));
+        SlottedPage page(block, 1, true);
+        RecordIDs ids = fill_page(page, SIZE);
+        shuffle(ids.begin(), ids.end(), rng);
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < 4; round++) {
+            for (auto const &id: ids)
+                page.put(id, round % 2 == 0 ? small : large);
+            ops += ids.size();
+        }
+        secs += elapsed(start);
+    }
+    cout << "page: put " << ops / secs << " ops/s" << endl;
+}
+
+// gives the benchmarks access to the HeapFile under a HeapTable
+class BenchTable : public HeapTable {
+public:
+    BenchTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes)
+            : HeapTable(table_name, column_names, column_attributes) {}
+    HeapFile &get_file() { return file; }
+};
+
+/*
+ * bulkscan: full scan of every block of a large table (BENCHMARK_SCAN_MB, default 1024MB),
+ * first one keyed Berkeley DB get per block through the buffer pool, then with HeapFileScan's
+ * bulk cursor retrieval. Counts the records in each block without unmarshaling them.
+ */
+static void bench_bulkscan() {
+    const char *mb_env = getenv("BENCHMARK_SCAN_MB");
+    const long MB = mb_env != nullptr ? atol(mb_env) : 1024;
+    const uint TEXT_LEN = 100;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    BenchTable table("_bench_bulkscan", column_names, column_attributes);
+    table.create();
+    HeapFile &file = table.get_file();
+
+    ValueDict row;
+    auto start = chrono::steady_clock::now();
+    for (int a = 0; (long) file.get_last_block_id() * DbBlock::BLOCK_SZ < MB * 1024 * 1024; a++) {
+        bench_row(row, a, TEXT_LEN);
+        table.insert(&row);
+    }
+    table.close();
+    double mb = (double) file.get_last_block_id() * DbBlock::BLOCK_SZ / (1024 * 1024);
+    cout << "bulkscan: loaded " << mb << "MB in " << elapsed(start) << "s" << endl;
+
+    table.open();
+    long rows = 0;
+    start = chrono::steady_clock::now();
+    BlockCursor *blocks = file.cursor();
+    for (auto const &block_id: *blocks) {
+        SlottedPage *block = file.get(block_id);
+        for (RecordID record_id = block->next_id(); record_id != 0; record_id = block->next_id(record_id))
+            rows++;
+        delete block;
+    }
+    delete blocks;
+    double secs = elapsed(start);
+    cout << "bulkscan: keyed: " << mb / secs << " MB/s, " << rows / secs << " rows/s" << endl;
+    table.close();
+
+    table.open();
+    rows = 0;
+    start = chrono::steady_clock::now();
+    HeapFileScan scan(file);
+    for (auto const &block: scan)
+        for (RecordID record_id = block->next_id(); record_id != 0; record_id = block->next_id(record_id))
+            rows++;
+    secs = elapsed(start);
+    cout << "bulkscan: bulk:  " << mb / secs << " MB/s, " << rows / secs << " rows/s" << endl;
+    table.drop();
+}
+
+/*
+ * rows: insert and project throughput, first with rows keyed by column name (ValueDict),
+ * then positionally (Row) with the column ordinals resolved once up front.
+ */
+static void bench_rows() {
+    const int N = 200000;
+    const uint TEXT_LEN = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    ColumnOrdinals all;
+    for (uint i = 0; i < column_names.size(); i++)
+        all.push_back(i);
+
+    HeapTable dict_table("_bench_rows_dict", column_names, column_attributes);
+    dict_table.create();
+    ValueDict dict;
+    Handles handles;
+    auto start = chrono::steady_clock::now();
+    for (int a = 0; a < N; a++) {
+        bench_row(dict, a, TEXT_LEN);
+        handles.push_back(dict_table.insert(&dict));
+    }
+    double secs = elapsed(start);
+    cout << "rows: insert ValueDict:   " << N / secs << " rows/s" << endl;
+    start = chrono::steady_clock::now();
+    for (auto const &handle: handles)
+        delete dict_table.project(handle, &column_names);
+    secs = elapsed(start);
+    cout << "rows: project ValueDict:  " << N / secs << " rows/s" << endl;
+    dict_table.drop();
+
+    HeapTable row_table("_bench_rows_row", column_names, column_attributes);
+    row_table.create();
+    Row row(column_names.size());
+    handles.clear();
+    start = chrono::steady_clock::now();
+    for (int a = 0; a < N; a++) {
+        row[0] = Value(a);
+        row[1] = Value(string(TEXT_LEN, (char) ('a' + a % 26)));
+        row[2] = Value(a % 2 == 0);
+        handles.push_back(row_table.insert(&row));
+    }
+    secs = elapsed(start);
+    cout << "rows: insert Row:        " << N / secs << " rows/s" << endl;
+    start = chrono::steady_clock::now();
+    for (auto const &handle: handles)
+        delete row_table.project(handle, &all);
+    secs = elapsed(start);
+    cout << "rows: project Row:       " << N / secs << " rows/s" << endl;
+    row_table.drop();
+}
+
+/*
+ * ingest: load the same rows one insert() at a time and then with insert_many() in batches,
+ * counting the blocks fetched from the buffer pool along the way.
+ */
+static void bench_ingest() {
+    const int N = 500000, BATCH = 1000;
+    const uint TEXT_LEN = 40;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    Rows rows;
+    for (int a = 0; a < N; a++)
+        rows.push_back(new Row({Value(a), Value(string(TEXT_LEN, (char) ('a' + a % 26))), Value(a % 2 == 0)}));
+
+    HeapTable single("_bench_ingest_single", column_names, column_attributes);
+    single.create();
+    _BUFFER_POOL->reset_stats();
+    auto start = chrono::steady_clock::now();
+    for (auto const &row: rows)
+        single.insert(row);
+    single.close();
+    double secs = elapsed(start);
+    cout << "ingest: insert:      " << N / secs << " rows/s, " << _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()
+         << " block fetches, " << _BUFFER_POOL->get_writes() << " block writes" << endl;
+    single.drop();
+
+    HeapTable batched("_bench_ingest_batched", column_names, column_attributes);
+    batched.create();
+    _BUFFER_POOL->reset_stats();
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < N; i += BATCH) {
+        Rows batch(rows.begin() + i, rows.begin() + min(i + BATCH, N));
+        delete batched.insert_many(&batch);
+    }
+    batched.close();
+    secs = elapsed(start);
+    cout << "ingest: insert_many: " << N / secs << " rows/s, " << _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()
+         << " block fetches, " << _BUFFER_POOL->get_writes() << " block writes" << endl;
+    batched.drop();
+
+    for (auto const &row: rows)
+        delete row;
+}
+
+/*
+ * btree: point lookups and range scans through a BTreeIndex, against the same queries done
+ * with a where-clause scan of the table.
+ */
+static void bench_btree() {
+    const int N = 200000, LOOKUPS = 200, RANGE = 1000, RANGES = 20;
+    const uint TEXT_LEN = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    Rows rows;
+    for (int a = 0; a < N; a++)
+        rows.push_back(new Row({Value(a), Value(string(TEXT_LEN, (char) ('a' + a % 26))), Value(a % 2 == 0)}));
+
+    // index first, then load the rows (one index insert each) vs load first, then build the index bottom-up
+    HeapTable indexed("_bench_btree_indexed", column_names, column_attributes);
+    indexed.create();
+    BTreeIndex inserted(indexed, "_bench_btree_i", {"a"}, true);
+    inserted.create();
+    indexed.attach_index(&inserted);
+    auto start = chrono::steady_clock::now();
+    delete indexed.insert_many(&rows);
+    double secs = elapsed(start);
+    cout << "btree: load, indexed as it goes: " << N / secs << " rows/s, " << inserted.report() << endl;
+    indexed.detach_index(&inserted);
+    inserted.drop();
+    indexed.drop();
+
+    HeapTable table("_bench_btree", column_names, column_attributes);
+    table.create();
+    BTreeIndex index(table, "_bench_btree_a", {"a"}, true);
+    start = chrono::steady_clock::now();
+    delete table.insert_many(&rows);
+    index.create();
+    secs = elapsed(start);
+    cout << "btree: load, then create index:  " << N / secs << " rows/s, " << index.report() << endl;
+    for (auto const &row: rows)
+        delete row;
+
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, N - 1);
+    vector<int> keys;
+    for (int i = 0; i < LOOKUPS; i++)
+        keys.push_back(pick(random));
+    ValueDict key;
+    size_t found = 0;
+    start = chrono::steady_clock::now();
+    for (auto const &a: keys) {
+        key["a"] = Value(a);
+        Handles *handles = index.lookup(&key);
+        found += handles->size();
+        delete handles;
+    }
+    double index_secs = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (auto const &a: keys) {
+        key["a"] = Value(a);
+        Handles *handles = table.select(&key);
+        found += handles->size();
+        delete handles;
+    }
+    secs = elapsed(start);
+    cout << "btree: lookup: " << index_secs / LOOKUPS * 1e6 << " us with index, " << secs / LOOKUPS * 1e6
+         << " us with scan (" << found << " found)" << endl;
+
+    ValueDict min_key, max_key;
+    found = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < RANGES; i++) {
+        min_key["a"] = Value(keys[i] / 2);
+        max_key["a"] = Value(keys[i] / 2 + RANGE - 1);
+        Handles *handles = index.range(&min_key, &max_key);
+        found += handles->size();
+        delete handles;
+    }
+    index_secs = elapsed(start);
+    ColumnOrdinals column_a = {0};
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < RANGES; i++) {
+        int low = keys[i] / 2, high = keys[i] / 2 + RANGE - 1;
+        Handles *handles = table.select();
+        for (auto const &handle: *handles) {
+            Row *row = table.project(handle, &column_a);
+            if ((*row)[0].n >= low && (*row)[0].n <= high)
+                found++;
+            delete row;
+        }
+        delete handles;
+    }
+    secs = elapsed(start);
+    cout << "btree: range of " << RANGE << ": " << index_secs / RANGES * 1e6 << " us with index, "
+         << secs / RANGES * 1e6 << " us with scan (" << found << " found)" << endl;
+
+    index.drop();
+    table.drop();
+}
+
+/*
+ * hash: point lookups through a HashIndex and a BTreeIndex on the same column, with the
+ * blocks fetched from the buffer pool per lookup.
+ */
+static void bench_hash() {
+    const int N = 200000, LOOKUPS = 100000;
+    const uint TEXT_LEN = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_hash", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    for (int a = 0; a < N; a++)
+        rows.push_back(new Row({Value(a), Value(string(TEXT_LEN, (char) ('a' + a % 26))), Value(a % 2 == 0)}));
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    HashIndex hash_index(table, "_bench_hash_h", {"a"}, true);
+    BTreeIndex btree_index(table, "_bench_hash_b", {"a"}, true);
+    auto start = chrono::steady_clock::now();
+    hash_index.create();
+    double secs = elapsed(start);
+    cout << "hash: create: " << N / secs << " rows/s, " << hash_index.get_n_buckets() << " buckets" << endl;
+    btree_index.create();
+
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, N - 1);
+    vector<int> keys;
+    for (int i = 0; i < LOOKUPS; i++)
+        keys.push_back(pick(random));
+    DbIndex *indices[] = {&hash_index, &btree_index};
+    const char *names[] = {"hash: ", "btree:"};
+    for (int i = 0; i < 2; i++) {
+        ValueDict key;
+        size_t found = 0;
+        _BUFFER_POOL->reset_stats();
+        start = chrono::steady_clock::now();
+        for (auto const &a: keys) {
+            key["a"] = Value(a);
+            Handles *handles = indices[i]->lookup(&key);
+            found += handles->size();
+            delete handles;
+        }
+        secs = elapsed(start);
+        cout << "hash: lookup with " << names[i] << " " << secs / LOOKUPS * 1e6 << " us, "
+             << (double) (_BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()) / LOOKUPS << " blocks ("
+             << found << " found)" << endl;
+    }
+
+    hash_index.drop();
+    btree_index.drop();
+    table.drop();
+}
+
+// column by column through the dictionaries, dispatching on each value's type
+static bool dict_less(const ValueDict &a, const ValueDict &b, const ColumnNames &columns) {
+    for (auto const &column: columns) {
+        const Value &x = a.at(column), &y = b.at(column);
+        int c = x.data_type == ColumnAttribute::TEXT ? x.s.compare(y.s) : (x.n < y.n ? -1 : (x.n > y.n ? 1 : 0));
+        if (c != 0)
+            return c < 0;
+    }
+    return false;
+}
+
+// column by column through the values, dispatching on each value's type
+static bool value_less(const KeyValue &a, const KeyValue &b) {
+    for (uint i = 0; i < a.size(); i++) {
+        int c = a[i].data_type == ColumnAttribute::TEXT ? a[i].s.compare(b[i].s)
+                                                        : (a[i].n < b[i].n ? -1 : (a[i].n > b[i].n ? 1 : 0));
+        if (c != 0)
+            return c < 0;
+    }
+    return false;
+}
+
+/*
+ * keys: sort the same composite (TEXT, INT, BOOLEAN) keys held as ValueDicts, as vectors of Values,
+ * and encoded with encode_key() so that each comparison is one memcmp.
+ */
+static void bench_keys() {
+    const int N = 200000;
+    ColumnNames columns = {"b", "a", "c"};
+    KeyProfile profile = {ColumnAttribute::TEXT, ColumnAttribute::INT, ColumnAttribute::BOOLEAN};
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(-1000000, 1000000);
+    vector<ValueDict> dicts(N);
+    vector<KeyValue> values(N);
+    vector<KeyBytes> encoded(N);
+    for (int i = 0; i < N; i++) {
+        int a = pick(random);
+        Value c(a % 2 == 0);
+        c.data_type = ColumnAttribute::BOOLEAN;
+        values[i] = {Value("prefix" + to_string(abs(a) % 100)), Value(a), c};  // common prefixes, then the INT decides
+        for (uint j = 0; j < columns.size(); j++)
+            dicts[i][columns[j]] = values[i][j];
+    }
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < N; i++)
+        encoded[i] = encode_key(profile, values[i]);
+    double encode_secs = elapsed(start);
+
+    start = chrono::steady_clock::now();
+    sort(dicts.begin(), dicts.end(), [&columns](const ValueDict &x, const ValueDict &y) { return dict_less(x, y, columns); });
+    double secs = elapsed(start);
+    cout << "keys: sort ValueDict: " << secs * 1000 << " ms" << endl;
+    start = chrono::steady_clock::now();
+    sort(values.begin(), values.end(), value_less);
+    secs = elapsed(start);
+    cout << "keys: sort KeyValue:  " << secs * 1000 << " ms" << endl;
+    start = chrono::steady_clock::now();
+    sort(encoded.begin(), encoded.end());
+    secs = elapsed(start);
+    cout << "keys: sort KeyBytes:  " << secs * 1000 << " ms (+ " << encode_secs * 1000 << " ms to encode)" << endl;
+
+    bool same = true;
+    for (int i = 0; same && i < N; i++)
+        same = encode_key(profile, values[i]) == encoded[i];
+    cout << "keys: orders " << (same ? "agree" : "DISAGREE") << endl;
+}
+
+/*
+ * covering: SELECT a, c WHERE b = <value> through an index on b, projecting each row from the table,
+ * vs through an index on b that includes a and c, which never reads the table. The rows are loaded
+ * in random order, so the ones with the same b are spread over the table.
+ */
+static void bench_covering() {
+    const int N = 200000, DISTINCT = 1000, LOOKUPS = 200;
+    const uint TEXT_LEN = 100;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_covering", column_names, column_attributes);
+    table.create();
+    vector<int> order(N);
+    for (int a = 0; a < N; a++)
+        order[a] = a;
+    mt19937 random(5300);
+    shuffle(order.begin(), order.end(), random);
+    Rows rows;
+    for (auto const &a: order) {
+        string b = to_string(a % DISTINCT);
+        rows.push_back(new Row({Value(a), Value(b + string(TEXT_LEN - b.size(), '.')), Value(a % 2 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    BTreeIndex plain(table, "_bench_covering_p", {"b"}, false);
+    BTreeIndex covering(table, "_bench_covering_c", {"b"}, false, {"a", "c"});
+    plain.create();
+    covering.create();
+    cout << "covering: plain index " << plain.report() << endl;
+    cout << "covering: covering index " << covering.report() << endl;
+
+    uniform_int_distribution<int> pick(0, DISTINCT - 1);
+    vector<Value> keys;
+    for (int i = 0; i < LOOKUPS; i++) {
+        string b = to_string(pick(random));
+        keys.push_back(Value(b + string(TEXT_LEN - b.size(), '.')));
+    }
+    ColumnNames column_ac = {"a", "c"};
+    ColumnOrdinals ordinals = table.get_column_ordinals(&column_ac);
+    ValueDict where;
+    size_t found = 0;
+    _BUFFER_POOL->reset_stats();
+    auto start = chrono::steady_clock::now();
+    for (auto const &b: keys) {
+        where["b"] = b;
+        Handles *handles = plain.lookup(&where);
+        for (auto const &handle: *handles) {
+            delete table.project(handle, &ordinals);
+            found++;
+        }
+        delete handles;
+    }
+    double secs = elapsed(start);
+    cout << "covering: index + project: " << secs / LOOKUPS * 1e6 << " us, "
+         << (double) (_BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()) / LOOKUPS << " blocks per query ("
+         << found << " rows)" << endl;
+
+    found = 0;
+    _BUFFER_POOL->reset_stats();
+    start = chrono::steady_clock::now();
+    for (auto const &b: keys) {
+        where["b"] = b;
+        Rows *result = covering.lookup_rows(&where, &column_ac);
+        found += result->size();
+        for (auto const &row: *result)
+            delete row;
+        delete result;
+    }
+    secs = elapsed(start);
+    cout << "covering: index-only scan: " << secs / LOOKUPS * 1e6 << " us, "
+         << (double) (_BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()) / LOOKUPS << " blocks per query ("
+         << found << " rows)" << endl;
+
+    plain.drop();
+    covering.drop();
+    table.drop();
+}
+
+// equality scans on a column loaded in order (narrow zones) and on one loaded at random (wide zones)
+static void bench_zones() {
+    const int N = 200000, LOOKUPS = 50;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_zones", column_names, column_attributes);
+    table.create();
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, N - 1);
+    Rows rows;
+    for (int a = 0; a < N; a++) {
+        rows.push_back(new Row({Value(a), Value(to_string(pick(random))), Value(a % 2 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    for (auto const &column: {"a", "b"}) {
+        ValueDict where;
+        size_t found = 0;
+        table.reset_scan_stats();
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < LOOKUPS; i++) {
+            int n = pick(random);
+            where[column] = column == string("a") ? Value(n) : Value(to_string(n));
+            Handles *handles = table.select(&where);
+            found += handles->size();
+            delete handles;
+        }
+        double secs = elapsed(start);
+        unsigned long skipped = table.get_blocks_skipped(), scanned = table.get_blocks_scanned();
+        cout << "zones: " << column << " = ?: " << secs / LOOKUPS * 1e3 << " ms, skipped "
+             << (double) skipped / LOOKUPS << " of " << (double) (skipped + scanned) / LOOKUPS
+             << " blocks per query (" << found << " rows)" << endl;
+    }
+    table.drop();
+}
+
+// false positive rate and probe time of a Bloom filter on an unindexed column, and what it saves
+// a select for a value that isn't there
+static void bench_bloom() {
+    const int N = 200000, PROBES = 200000, SELECTS = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_bloom", column_names, column_attributes);
+    table.create();
+    vector<int> order(N);
+    for (int a = 0; a < N; a++)
+        order[a] = a;
+    mt19937 random(5300);
+    shuffle(order.begin(), order.end(), random);  // so the zone map can't rule out blocks
+    Rows rows;
+    for (auto const &a: order) {
+        rows.push_back(new Row({Value(a), Value("key" + to_string(a)), Value(a % 2 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    ValueDict where;
+    where["b"] = Value(string("key100x"));
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < SELECTS; i++)
+        delete table.select(&where);
+    double scan_secs = elapsed(start) / SELECTS;
+
+    BloomFilter filter(table, "_bench_bloom_b", {"b"});
+    start = chrono::steady_clock::now();
+    filter.create();
+    cout << "bloom: built " << filter.report() << " in " << elapsed(start) << " s" << endl;
+    table.attach_index(&filter);
+
+    KeyValue key(1);
+    size_t hits = 0;
+    start = chrono::steady_clock::now();
+    for (int a = 0; a < PROBES; a++) {
+        key[0] = Value("key" + to_string(a % N));
+        hits += filter.may_contain(key);
+    }
+    double present_secs = elapsed(start);
+    size_t false_positives = 0;
+    start = chrono::steady_clock::now();
+    for (int a = 0; a < PROBES; a++) {
+        key[0] = Value("key" + to_string(a) + "x");
+        false_positives += filter.may_contain(key);
+    }
+    double absent_secs = elapsed(start);
+    cout << "bloom: " << hits << " of " << PROBES << " present keys found, "
+         << false_positives * 100.0 / PROBES << "% false positives" << endl;
+    cout << "bloom: probe " << present_secs / PROBES * 1e9 << " ns (present), "
+         << absent_secs / PROBES * 1e9 << " ns (absent)" << endl;
+
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < SELECTS; i++)
+        delete table.select(&where);
+    cout << "bloom: select of an absent value: " << scan_secs * 1e3 << " ms scanning, "
+         << elapsed(start) / SELECTS * 1e3 << " ms with the filter" << endl;
+
+    table.detach_index(&filter);
+    filter.drop();
+    table.drop();
+}
+
+// count of rows matching b = ? AND c from bitmaps, against a scan with the same where clause
+static void bench_bitmap() {
+    const int N = 200000, DISTINCT = 10, QUERIES = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_bitmap", column_names, column_attributes);
+    table.create();
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, DISTINCT - 1);
+    Rows rows;
+    for (int a = 0; a < N; a++) {
+        rows.push_back(new Row({Value(a), Value("category " + to_string(pick(random))), Value(random() % 4 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    BitmapIndex index_b(table, "_bench_bitmap_b", {"b"});
+    BitmapIndex index_c(table, "_bench_bitmap_c", {"c"});
+    auto start = chrono::steady_clock::now();
+    index_b.create();
+    index_c.create();
+    cout << "bitmap: built b (" << index_b.report() << ") and c (" << index_c.report() << ") in "
+         << elapsed(start) << " s" << endl;
+
+    ValueDict where;
+    where["c"] = Value(1);
+    where["c"].data_type = ColumnAttribute::BOOLEAN;
+    size_t scanned = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < QUERIES; i++) {
+        where["b"] = Value("category " + to_string(i % DISTINCT));
+        Handles *handles = table.select(&where);
+        scanned += handles->size();
+        delete handles;
+    }
+    double scan_secs = elapsed(start) / QUERIES;
+
+    size_t counted = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < QUERIES; i++) {
+        where["b"] = Value("category " + to_string(i % DISTINCT));
+        Bitmap *matches = index_b.lookup_bitmap(&where);
+        Bitmap *trues = index_c.lookup_bitmap(&where);
+        matches->and_with(*trues);
+        counted += matches->count();
+        delete matches;
+        delete trues;
+    }
+    double bitmap_secs = elapsed(start) / QUERIES;
+    cout << "bitmap: count(b = ? AND c): " << scan_secs * 1e3 << " ms scanning (" << scanned << " rows), "
+         << bitmap_secs * 1e3 << " ms from bitmaps (" << counted << " rows)" << endl;
+
+    index_b.drop();
+    index_c.drop();
+    table.drop();
+}
+
+// Millions of operations a second with a number of threads each doing ops, one at a time under
+// guard if it is not null.
+static double bench_olc_run(uint n_threads, int ops, mutex *guard, const function<void(uint, int)> &op) {
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (uint t = 0; t < n_threads; t++)
+        threads.push_back(thread([&, t]() {
+            for (int i = 0; i < ops; i++) {
+                if (guard == nullptr) {
+                    op(t, i);
+                } else {
+                    lock_guard<mutex> locked(*guard);
+                    op(t, i);
+                }
+            }
+        }));
+    for (auto &worker: threads)
+        worker.join();
+    return (double) n_threads * ops / elapsed(start) / 1e6;
+}
+
+// lookups and inserts from 1 up to all the cores' threads, latch-free against one mutex for the tree
+static void bench_olc() {
+    const int N = 200000, OPS = 200000;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_olc", column_names, column_attributes);
+    table.create();
+    OLCBTreeIndex index(table, "_bench_olc_a", {"a"}, true);
+    index.create();
+    KeyProfile profile = {ColumnAttribute::INT};
+    for (int a = 0; a < N; a++)
+        index.insert_key(encode_key(profile, {Value(a)}), Handle(a / 100 + 1, a % 100));
+    cout << "olc: " << index.report() << endl;
+
+    uint cores = max(thread::hardware_concurrency(), 1U);
+    atomic<int> next(N);
+    auto lookup = [&](uint t, int i) {
+        Handles *handles = index.lookup_key(encode_key(profile, {Value((int) ((t * 7919U + i * 104729U) % N))}));
+        delete handles;
+    };
+    auto insert = [&](uint, int) {
+        int a = next++;
+        index.insert_key(encode_key(profile, {Value(a)}), Handle(a / 100 + 1, a % 100));
+    };
+    for (uint n_threads = 1; ; n_threads = min(2 * n_threads, cores)) {
+        mutex guard;
+        double reads = bench_olc_run(n_threads, OPS, nullptr, lookup);
+        double locked_reads = bench_olc_run(n_threads, OPS, &guard, lookup);
+        double writes = bench_olc_run(n_threads, OPS, nullptr, insert);
+        double locked_writes = bench_olc_run(n_threads, OPS, &guard, insert);
+        cout << "olc: " << n_threads << " threads: lookups " << reads << " M/s (" << locked_reads
+             << " M/s with one mutex), inserts " << writes << " M/s (" << locked_writes << " M/s with one mutex)"
+             << endl;
+        if (n_threads == cores)
+            break;
+    }
+    cout << "olc: " << index.report() << endl;
+
+    index.drop();
+    table.drop();
+}
+
+// point lookups through the in-memory ART against the disk-based BTREE and HASH indices on the same
+// column, with the memory each one takes
+static void bench_art() {
+    const int N = 200000, LOOKUPS = 100000;
+    const uint TEXT_LEN = 20;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_art", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    for (int a = 0; a < N; a++)
+        rows.push_back(new Row({Value(a), Value(string(TEXT_LEN, (char) ('a' + a % 26))), Value(a % 2 == 0)}));
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    ARTIndex art_index(table, "_bench_art_r", {"a"}, true);
+    BTreeIndex btree_index(table, "_bench_art_b", {"a"}, true);
+    HashIndex hash_index(table, "_bench_art_h", {"a"}, true);
+    auto start = chrono::steady_clock::now();
+    art_index.create();
+    double secs = elapsed(start);
+    cout << "art: create: " << N / secs << " rows/s, " << art_index.report() << ", "
+         << (double) art_index.get_size() / N << " bytes/key" << endl;
+    btree_index.create();
+    hash_index.create();
+    cout << "art: btree: " << btree_index.report() << "; hash: " << hash_index.get_n_buckets() << " buckets" << endl;
+
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, N - 1);
+    vector<int> keys;
+    for (int i = 0; i < LOOKUPS; i++)
+        keys.push_back(pick(random));
+    DbIndex *indices[] = {&art_index, &btree_index, &hash_index};
+    const char *names[] = {"art:  ", "btree:", "hash: "};
+    for (int i = 0; i < 3; i++) {
+        ValueDict key;
+        size_t found = 0;
+        _BUFFER_POOL->reset_stats();
+        start = chrono::steady_clock::now();
+        for (auto const &a: keys) {
+            key["a"] = Value(a);
+            Handles *handles = indices[i]->lookup(&key);
+            found += handles->size();
+            delete handles;
+        }
+        secs = elapsed(start);
+        cout << "art: lookup with " << names[i] << " " << secs / LOOKUPS * 1e6 << " us, "
+             << (double) (_BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses()) / LOOKUPS << " blocks ("
+             << found << " found)" << endl;
+    }
+
+    art_index.drop();
+    btree_index.drop();
+    hash_index.drop();
+    table.drop();
+}
+
+// counting the rows of a table: select() of every handle against the count the table keeps, before
+// and after reopening it (when the count comes from the file's header)
+static void bench_count() {
+    const int N = 200000;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    HeapTable table("_bench_count", column_names, column_attributes);
+    table.create();
+    Rows rows;
+    for (int a = 0; a < N; a++) {
+        rows.push_back(new Row({Value(a), Value(string(20, (char) ('a' + a % 26))), Value(a % 2 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const &row: rows)
+        delete row;
+
+    auto start = chrono::steady_clock::now();
+    Handles *handles = table.select();
+    size_t selected = handles->size();
+    delete handles;
+    double secs = elapsed(start);
+    cout << "count: select " << secs * 1e3 << " ms (" << selected << " rows)" << endl;
+    for (auto const &reopen: {false, true}) {
+        if (reopen) {
+            table.close();
+            table.open();
+        }
+        start = chrono::steady_clock::now();
+        uint64_t n_rows = table.get_n_rows(), n_bytes = table.get_n_bytes();
+        secs = elapsed(start);
+        cout << "count: kept count" << (reopen ? " after reopen " : " ") << secs * 1e6 << " us (" << n_rows
+             << " rows, " << n_bytes << " bytes in " << table.get_n_blocks() << " blocks)" << endl;
+    }
+    table.drop();
+}
+
+// startup with 10,000 tables in the catalog: opening the schema tables and looking up one table, which
+// read the files' metadata headers and that table's rows through the key indices, against scanning all
+// of _columns as loading the whole catalog up front would. Uses a database of its own, so as to leave
+// no schema tables behind.
+static void bench_startup() {
+    const int N = 10000, LOOKUPS = 1000;
+    string home = env_home + "/_bench_startup";
+    mkdir(home.c_str(), 0775);
+    DbEnv *env = new DbEnv(0U);
+    env->open(home.c_str(), DB_CREATE | DB_INIT_MPOOL, 0);
+    DbEnv *saved_env = _DB_ENV;
+    _DB_ENV = env;
+
+    auto start = chrono::steady_clock::now();
+    initialize_schema_tables();
+    Tables *tables = new Tables();
+    DbRelation &columns = Tables::get_table(Columns::TABLE_NAME);
+    for (int t = 0; t < N; t++) {
+        ValueDict row;
+        row["table_name"] = Value("t" + to_string(t));
+        tables->insert(&row);
+        row["data_type"] = Value("INT");
+        for (auto const &column_name: {"a", "b"}) {
+            row["column_name"] = Value(column_name);
+            columns.insert(&row);
+        }
+    }
+    Tables::close_all();
+    delete tables;
+    cout << "startup: made " << N << " tables in " << elapsed(start) << " s" << endl;
+
+    // as sql5300 starts up, then its first statement about a table
+    _BUFFER_POOL->reset_stats();
+    start = chrono::steady_clock::now();
+    initialize_schema_tables();
+    tables = new Tables();
+    double open_secs = elapsed(start);
+    const Catalog::TableEntry *table = Catalog::find_table("t" + to_string(N / 2));
+    double secs = elapsed(start);
+    cout << "startup: open " << open_secs * 1e3 << " ms, then first lookup " << (secs - open_secs) * 1e3
+         << " ms (" << (table == nullptr ? 0 : table->column_names.size()) << " columns), "
+         << _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() << " blocks in all" << endl;
+    cout << "startup: " << tables->get_n_rows() << " rows in _tables, from its header" << endl;
+
+    mt19937 random(5300);
+    uniform_int_distribution<int> pick(0, N - 1);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; i++)
+        Catalog::find_table("t" + to_string(pick(random)));
+    secs = elapsed(start);
+    cout << "startup: lookups of other tables " << secs / LOOKUPS * 1e6 << " us each" << endl;
+
+    size_t rows;
+    _BUFFER_POOL->reset_stats();
+    secs = scan_time(columns, rows);
+    cout << "startup: scan of _columns " << secs * 1e3 << " ms (" << rows << " rows, "
+         << _BUFFER_POOL->get_hits() + _BUFFER_POOL->get_misses() << " blocks)" << endl;
+
+    Tables::close_all();
+    delete tables;
+    _DB_ENV = saved_env;
+    env->close(0);
+    delete env;
+    DIR *dir = opendir(home.c_str());
+    if (dir != nullptr) {
+        for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+            if (entry->d_name[0] != '.')
+                unlink((home + "/" + entry->d_name).c_str());
+        closedir(dir);
+    }
+    rmdir(home.c_str());
+}
+
+// more tables than the file pool keeps open: point selects spread evenly over all of them, so that most
+// have to reopen a file the pool closed, against selects that mostly go to a few hot tables
+static void bench_files() {
+    const uint N = 4 * _FILE_POOL->get_capacity(), HOT = _FILE_POOL->get_capacity() / 4, OPS = 20000;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    bench_columns(column_names, column_attributes);
+    vector<HeapTable *> tables;
+    for (uint t = 0; t < N; t++) {
+        HeapTable *table = new HeapTable("_bench_files_" + to_string(t), column_names, column_attributes);
+        table->create();
+        ValueDict row;
+        for (int a = 0; a < 10; a++) {
+            bench_row(row, a, 10);
+            table->insert(&row);
+        }
+        tables.push_back(table);
+    }
+
+    mt19937 random(5300);
+    uniform_int_distribution<uint> pick_any(0, N - 1), pick_hot(0, HOT - 1);
+    uniform_int_distribution<int> pick_pct(0, 99);
+    for (auto const &skewed: {false, true}) {
+        _FILE_POOL->reset_stats();
+        ValueDict where;
+        where["a"] = Value(5);
+        size_t found = 0;
+        auto start = chrono::steady_clock::now();
+        for (uint i = 0; i < OPS; i++) {
+            uint t = skewed && pick_pct(random) < 90 ? pick_hot(random) : pick_any(random);
+            Handles *handles = tables[t]->select(&where);
+            found += handles->size();
+            delete handles;
+        }
+        double secs = elapsed(start);
+        cout << "files: " << (skewed ? "90% to " + to_string(HOT) + " tables" : "uniform") << " over " << N
+             << " tables, " << _FILE_POOL->get_capacity() << " open at most: " << secs / OPS * 1e6 << " us/select, "
+             << (double) _FILE_POOL->get_opens() / OPS << " opens and " << (double) _FILE_POOL->get_evictions() / OPS
+             << " evictions per select (" << found << " rows)" << endl;
+    }
+
+    for (auto const &table: tables) {
+        table->drop();
+        delete table;
+    }
+}
+
+struct Benchmark {
+    const char *name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+        {"churn", bench_churn},
+        {"page",  bench_page},
+        {"bulkscan", bench_bulkscan},
+        {"rows", bench_rows},
+        {"ingest", bench_ingest},
+        {"btree", bench_btree},
+        {"hash", bench_hash},
+        {"keys", bench_keys},
+        {"covering", bench_covering},
+        {"zones", bench_zones},
+        {"bloom", bench_bloom},
+        {"bitmap", bench_bitmap},
+        {"olc", bench_olc},
+        {"art", bench_art},
+        {"files", bench_files},
+        {"count", bench_count},
+        {"startup", bench_startup},
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: benchmark dbenvpath [benchmark_name ...]" << endl;
+        return 1;
+    }
+    env_home = argv[1];
+    DbEnv *env = new DbEnv(0U);
+    env->set_message_stream(&cout);
+    env->set_error_stream(&cerr);
+    try {
+        env->open(argv[1], DB_CREATE | DB_INIT_MPOOL, 0);
+    } catch (DbException &exc) {
+        cerr << "(benchmark: " << exc.what() << ")" << endl;
+        return 1;
+    }
+    _DB_ENV = env;
+    _BUFFER_POOL = new BufferPool();
+    _FILE_POOL = new FilePool();
+
+    for (auto const &benchmark: benchmarks) {
+        bool wanted = argc == 2;
+        for (int i = 2; i < argc; i++)
+            if (strcmp(argv[i], benchmark.name) == 0)
+                wanted = true;
+        if (wanted)
+            benchmark.run();
+    }
+    _BUFFER_POOL->flush_all();
+    return EXIT_SUCCESS;
+}
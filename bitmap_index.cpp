@@ -0,0 +1,650 @@
+/**
+ * @file bitmap_index.cpp - implementation of:
+ * Bitmap
+ * BitmapIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <set>
+#include "bitmap_index.h"
+using namespace std;
+
+// magic number of the index file ("BMP2")
+static const uint32_t BITMAP_MAGIC = 0x32504d42;
+
+// 64-bit words in a container's bitset
+static const uint WORDS = 65536 / 64;
+
+// container kinds in the serialized form
+static const char ARRAY = 0;
+static const char BITSET = 1;
+
+// Append a number's bytes.
+template<typename T>
+static void put(string &bytes, T n) {
+    bytes.append((const char *) &n, sizeof(T));
+}
+
+// Take a number's bytes at offset and move past them.
+template<typename T>
+static T take(const string &bytes, size_t &offset) {
+    if (offset + sizeof(T) > bytes.size())
+        throw DbRelationError("bad serialized bitmap");
+    T n;
+    memcpy(&n, bytes.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return n;
+}
+
+/*
+ * *******************
+ * Bitmap
+ * *******************
+ */
+
+bool Bitmap::Container::contains(uint16_t low) const {
+    if (is_bitset())
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    return binary_search(array.begin(), array.end(), low);
+}
+
+void Bitmap::Container::to_bitset() {
+    bits.assign(WORDS, 0);
+    for (auto const &low: array)
+        bits[low >> 6] |= 1ULL << (low & 63);
+    vector<uint16_t>().swap(array);
+}
+
+// Recount a bitset and switch to whichever form suits the cardinality.
+void Bitmap::Container::normalize() {
+    if (is_bitset()) {
+        cardinality = 0;
+        for (auto const &word: bits)
+            cardinality += __builtin_popcountll(word);
+        if (cardinality <= ARRAY_MAX) {
+            array.clear();
+            for (uint w = 0; w < WORDS; w++)
+                for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+                    array.push_back((uint16_t) (w * 64 + __builtin_ctzll(word)));
+            vector<uint64_t>().swap(bits);
+        }
+    } else {
+        cardinality = (uint32_t) array.size();
+        if (cardinality > ARRAY_MAX)
+            to_bitset();
+    }
+}
+
+void Bitmap::add(uint32_t n) {
+    Container &c = this->containers[(uint16_t) (n >> 16)];
+    uint16_t low = (uint16_t) n;
+    if (c.is_bitset()) {
+        uint64_t &word = c.bits[low >> 6], bit = 1ULL << (low & 63);
+        if ((word & bit) == 0) {
+            word |= bit;
+            c.cardinality++;
+        }
+    } else {
+        auto at = lower_bound(c.array.begin(), c.array.end(), low);
+        if (at == c.array.end() || *at != low) {
+            c.array.insert(at, low);
+            c.cardinality++;
+            if (c.cardinality > ARRAY_MAX)
+                c.to_bitset();
+        }
+    }
+}
+
+void Bitmap::remove(uint32_t n) {
+    auto found = this->containers.find((uint16_t) (n >> 16));
+    if (found == this->containers.end())
+        return;
+    Container &c = found->second;
+    uint16_t low = (uint16_t) n;
+    if (c.is_bitset()) {
+        uint64_t &word = c.bits[low >> 6], bit = 1ULL << (low & 63);
+        if ((word & bit) == 0)
+            return;
+        word &= ~bit;
+        if (--c.cardinality <= ARRAY_MAX)
+            c.normalize();
+    } else {
+        auto at = lower_bound(c.array.begin(), c.array.end(), low);
+        if (at == c.array.end() || *at != low)
+            return;
+        c.array.erase(at);
+        c.cardinality--;
+    }
+    if (c.cardinality == 0)
+        this->containers.erase(found);
+}
+
+bool Bitmap::contains(uint32_t n) const {
+    auto found = this->containers.find((uint16_t) (n >> 16));
+    return found != this->containers.end() && found->second.contains((uint16_t) n);
+}
+
+uint64_t Bitmap::count() const {
+    uint64_t n = 0;
+    for (auto const &entry: this->containers)
+        n += entry.second.cardinality;
+    return n;
+}
+
+// Intersect container by container; groups missing from other go.
+void Bitmap::and_with(const Bitmap &other) {
+    for (auto entry = this->containers.begin(); entry != this->containers.end();) {
+        auto found = other.containers.find(entry->first);
+        if (found == other.containers.end()) {
+            entry = this->containers.erase(entry);
+            continue;
+        }
+        Container &c = entry->second;
+        const Container &o = found->second;
+        if (c.is_bitset() && o.is_bitset()) {
+            for (uint w = 0; w < WORDS; w++)
+                c.bits[w] &= o.bits[w];
+        } else if (c.is_bitset()) {
+            vector<uint16_t> kept;
+            for (auto const &low: o.array)
+                if (c.contains(low))
+                    kept.push_back(low);
+            vector<uint64_t>().swap(c.bits);
+            c.array.swap(kept);
+        } else {
+            vector<uint16_t> kept;
+            if (o.is_bitset()) {
+                for (auto const &low: c.array)
+                    if (o.contains(low))
+                        kept.push_back(low);
+            } else {
+                set_intersection(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(),
+                                 back_inserter(kept));
+            }
+            c.array.swap(kept);
+        }
+        c.normalize();
+        if (c.cardinality == 0)
+            entry = this->containers.erase(entry);
+        else
+            entry++;
+    }
+}
+
+// Union container by container; two arrays merge, anything else goes through a bitset.
+void Bitmap::or_with(const Bitmap &other) {
+    for (auto const &entry: other.containers) {
+        auto found = this->containers.find(entry.first);
+        if (found == this->containers.end()) {
+            this->containers[entry.first] = entry.second;
+            continue;
+        }
+        Container &c = found->second;
+        const Container &o = entry.second;
+        if (!c.is_bitset() && !o.is_bitset()) {
+            vector<uint16_t> merged;
+            set_union(c.array.begin(), c.array.end(), o.array.begin(), o.array.end(), back_inserter(merged));
+            c.array.swap(merged);
+        } else {
+            if (!c.is_bitset())
+                c.to_bitset();
+            if (o.is_bitset()) {
+                for (uint w = 0; w < WORDS; w++)
+                    c.bits[w] |= o.bits[w];
+            } else {
+                for (auto const &low: o.array)
+                    c.bits[low >> 6] |= 1ULL << (low & 63);
+            }
+        }
+        c.normalize();
+    }
+}
+
+void Bitmap::and_not(const Bitmap &other) {
+    for (auto entry = this->containers.begin(); entry != this->containers.end();) {
+        auto found = other.containers.find(entry->first);
+        if (found == other.containers.end()) {
+            entry++;
+            continue;
+        }
+        Container &c = entry->second;
+        const Container &o = found->second;
+        if (!c.is_bitset()) {
+            vector<uint16_t> kept;
+            for (auto const &low: c.array)
+                if (!o.contains(low))
+                    kept.push_back(low);
+            c.array.swap(kept);
+        } else if (o.is_bitset()) {
+            for (uint w = 0; w < WORDS; w++)
+                c.bits[w] &= ~o.bits[w];
+        } else {
+            for (auto const &low: o.array)
+                c.bits[low >> 6] &= ~(1ULL << (low & 63));
+        }
+        c.normalize();
+        if (c.cardinality == 0)
+            entry = this->containers.erase(entry);
+        else
+            entry++;
+    }
+}
+
+vector<uint32_t> Bitmap::to_vector() const {
+    vector<uint32_t> numbers;
+    numbers.reserve(count());
+    for (auto const &entry: this->containers) {
+        uint32_t high = (uint32_t) entry.first << 16;
+        const Container &c = entry.second;
+        if (c.is_bitset()) {
+            for (uint w = 0; w < WORDS; w++)
+                for (uint64_t word = c.bits[w]; word != 0; word &= word - 1)
+                    numbers.push_back(high | (w * 64 + __builtin_ctzll(word)));
+        } else {
+            for (auto const &low: c.array)
+                numbers.push_back(high | low);
+        }
+    }
+    return numbers;
+}
+
+uint64_t Bitmap::get_size() const {
+    uint64_t size = 0;
+    for (auto const &entry: this->containers)
+        size += sizeof(uint16_t) + sizeof(Container)
+                + (entry.second.is_bitset() ? WORDS * sizeof(uint64_t) : entry.second.array.size() * sizeof(uint16_t));
+    return size;
+}
+
+// Number of containers, then for each: high bits, kind, cardinality, and the array or bitset.
+void Bitmap::serialize(string &bytes) const {
+    put(bytes, (uint32_t) this->containers.size());
+    for (auto const &entry: this->containers) {
+        const Container &c = entry.second;
+        put(bytes, entry.first);
+        put(bytes, c.is_bitset() ? BITSET : ARRAY);
+        put(bytes, c.cardinality);
+        if (c.is_bitset())
+            bytes.append((const char *) c.bits.data(), WORDS * sizeof(uint64_t));
+        else
+            bytes.append((const char *) c.array.data(), c.array.size() * sizeof(uint16_t));
+    }
+}
+
+void Bitmap::deserialize(const string &bytes, size_t &offset) {
+    this->containers.clear();
+    uint32_t n_containers = take<uint32_t>(bytes, offset);
+    for (uint32_t i = 0; i < n_containers; i++) {
+        uint16_t high = take<uint16_t>(bytes, offset);
+        char kind = take<char>(bytes, offset);
+        Container &c = this->containers[high];
+        c.cardinality = take<uint32_t>(bytes, offset);
+        size_t size = kind == BITSET ? WORDS * sizeof(uint64_t) : c.cardinality * sizeof(uint16_t);
+        if (offset + size > bytes.size() || (kind == ARRAY && c.cardinality > ARRAY_MAX))
+            throw DbRelationError("bad serialized bitmap");
+        if (kind == BITSET) {
+            c.bits.resize(WORDS);
+            memcpy(c.bits.data(), bytes.data() + offset, size);
+        } else {
+            c.array.resize(c.cardinality);
+            memcpy(c.array.data(), bytes.data() + offset, size);
+        }
+        offset += size;
+    }
+}
+
+
+/*
+ * *******************
+ * BitmapIndex
+ * *******************
+ */
+
+BitmapIndex::BitmapIndex(DbRelation& relation, Identifier name, ColumnNames key_columns)
+        : DbIndex(relation, name, key_columns, false),
+          file(relation.get_table_name() + "-" + name + ".db", BITMAP_MAGIC),
+          key_profile(::key_profile(relation, key_columns)), key_ordinals(relation.get_column_ordinals(&key_columns)),
+          bitmaps(), rows() {
+    if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+}
+
+BitmapIndex::~BitmapIndex() {
+    close();
+}
+
+// Create the file and the bitmaps of the rows already in the relation.
+void BitmapIndex::create() {
+    this->file.create();
+    build();
+}
+
+// Remove the file (not written back first).
+void BitmapIndex::drop() {
+    this->file.drop();
+}
+
+// Read the bitmaps if they were written back by a close(); otherwise build them again.
+void BitmapIndex::open() {
+    if (this->file.is_open())
+        return;
+    string bytes;
+    if (!this->file.open(bytes) || !deserialize(bytes))
+        build();
+}
+
+// Write back the bitmaps and close the file.
+void BitmapIndex::close() {
+    if (!this->file.is_open())
+        return;
+    string bytes;
+    serialize(bytes);
+    this->file.close(bytes);
+}
+
+Handles* BitmapIndex::lookup(ValueDict* key_values) const {
+    Bitmap* bitmap = lookup_bitmap(key_values);
+    Handles* found = handles(*bitmap);
+    delete bitmap;
+    return found;
+}
+
+// Nothing matches a key with no bitmap.
+bool BitmapIndex::may_match(const ValueDict* where) const {
+    KeyValue key;
+    if (!where_key(this->key_columns, this->key_profile, where, key))
+        return true;  // left for the scan to decide
+    const_cast<BitmapIndex*>(this)->open();
+    try {
+        return this->bitmaps.find(encode_key(this->key_profile, key)) != this->bitmaps.end();
+    } catch (DbRelationError &e) {
+        return true;  // too big to be a key
+    }
+}
+
+void BitmapIndex::insert(Handle record) {
+    open();
+    uint32_t n = row_number(record);
+    this->bitmaps[row_key(this->relation, this->key_profile, this->key_ordinals, record)].add(n);
+    this->rows.add(n);
+}
+
+// Called while the row is still there, so its key can be read.
+void BitmapIndex::del(Handle record) {
+    open();
+    uint32_t n = row_number(record);
+    auto found = this->bitmaps.find(row_key(this->relation, this->key_profile, this->key_ordinals, record));
+    if (found != this->bitmaps.end()) {
+        found->second.remove(n);
+        if (found->second.empty())
+            this->bitmaps.erase(found);
+    }
+    this->rows.remove(n);
+}
+
+std::string BitmapIndex::report() const {
+    uint64_t size = this->rows.get_size();
+    for (auto const &entry: this->bitmaps)
+        size += entry.second.get_size();
+    return to_string(this->bitmaps.size()) + " keys, " + to_string(this->rows.count()) + " rows in "
+           + to_string(size / 1024) + "KB";
+}
+
+Bitmap* BitmapIndex::lookup_bitmap(const ValueDict* key_values) const {
+    const_cast<BitmapIndex*>(this)->open();
+    KeyBytes key = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values));
+    auto found = this->bitmaps.find(key);
+    return found == this->bitmaps.end() ? new Bitmap() : new Bitmap(found->second);
+}
+
+const Bitmap& BitmapIndex::get_rows() const {
+    const_cast<BitmapIndex*>(this)->open();
+    return this->rows;
+}
+
+uint64_t BitmapIndex::count(const ValueDict* key_values) const {
+    const_cast<BitmapIndex*>(this)->open();
+    KeyBytes key = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values));
+    auto found = this->bitmaps.find(key);
+    return found == this->bitmaps.end() ? 0 : found->second.count();
+}
+
+uint32_t BitmapIndex::row_number(Handle handle) {
+    if (handle.second >= (1U << RECORD_BITS) || handle.first >= (1U << (32 - RECORD_BITS)))
+        throw DbRelationError("row out of range for a bitmap index");
+    return handle.first << RECORD_BITS | handle.second;
+}
+
+Handle BitmapIndex::row_handle(uint32_t row_number) {
+    return Handle(row_number >> RECORD_BITS, (RecordID) (row_number & ((1U << RECORD_BITS) - 1)));
+}
+
+Handles* BitmapIndex::handles(const Bitmap &bitmap) {
+    Handles* found = new Handles();
+    for (auto const &n: bitmap.to_vector())
+        found->push_back(row_handle(n));
+    return found;
+}
+
+// Read back what serialize() wrote, leaving the bitmaps alone if it doesn't make sense.
+bool BitmapIndex::deserialize(const string &bytes) {
+    try {
+        size_t offset = 0;
+        map<KeyBytes, Bitmap> bitmaps;
+        Bitmap rows;
+        uint32_t n_keys = take<uint32_t>(bytes, offset);
+        for (uint32_t i = 0; i < n_keys; i++) {
+            uint16_t size = take<uint16_t>(bytes, offset);
+            if (offset + size > bytes.size())
+                return false;
+            KeyBytes key_bytes = bytes.substr(offset, size);
+            offset += size;
+            bitmaps[key_bytes].deserialize(bytes, offset);
+        }
+        rows.deserialize(bytes, offset);
+        this->bitmaps.swap(bitmaps);
+        this->rows = rows;
+    } catch (DbRelationError &e) {
+        return false;
+    }
+    return true;
+}
+
+// Number of keys, then each key (length and bytes) and its bitmap, then the bitmap of all rows.
+void BitmapIndex::serialize(string &bytes) const {
+    put(bytes, (uint32_t) this->bitmaps.size());
+    for (auto const &entry: this->bitmaps) {
+        put(bytes, (uint16_t) entry.first.size());
+        bytes += entry.first;
+        entry.second.serialize(bytes);
+    }
+    this->rows.serialize(bytes);
+}
+
+// One scan of the relation.
+void BitmapIndex::build() {
+    this->bitmaps.clear();
+    this->rows = Bitmap();
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor) {
+            uint32_t n = row_number(handle);
+            this->bitmaps[row_key(this->relation, this->key_profile, this->key_ordinals, handle)].add(n);
+            this->rows.add(n);
+        }
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Check a bitmap against the set it should hold.
+bool test_bitmap_equals(const Bitmap &bitmap, const set<uint32_t> &expected) {
+    vector<uint32_t> numbers = bitmap.to_vector();
+    return bitmap.count() == expected.size() && equal(numbers.begin(), numbers.end(), expected.begin());
+}
+
+// AND, OR and NOT on mixes of sparse and dense containers, checked against std::set.
+bool test_bitmap() {
+    mt19937 random(5300);
+    Bitmap bitmaps[2];
+    set<uint32_t> sets[2];
+    for (uint i = 0; i < 2; i++) {
+        for (uint j = 0; j < 30000; j++) {
+            // group 0 dense in both, group 1 dense in one, group 2 sparse, group 3 in one only
+            uint32_t high = j % 4 == 3 ? 3 + i : j % 3;
+            uint32_t low = high == 0 || (high == 1 && i == 0) ? random() % 20000 : random() % 65536;
+            uint32_t n = high << 16 | low;
+            bitmaps[i].add(n);
+            sets[i].insert(n);
+        }
+        if (!test_bitmap_equals(bitmaps[i], sets[i]))
+            return false;
+    }
+    set<uint32_t> expected;
+    Bitmap result = bitmaps[0];
+    result.and_with(bitmaps[1]);
+    set_intersection(sets[0].begin(), sets[0].end(), sets[1].begin(), sets[1].end(), inserter(expected, expected.end()));
+    if (!test_bitmap_equals(result, expected))
+        return false;
+    expected.clear();
+    result = bitmaps[0];
+    result.or_with(bitmaps[1]);
+    set_union(sets[0].begin(), sets[0].end(), sets[1].begin(), sets[1].end(), inserter(expected, expected.end()));
+    if (!test_bitmap_equals(result, expected))
+        return false;
+    expected.clear();
+    result = bitmaps[0];
+    result.and_not(bitmaps[1]);
+    set_difference(sets[0].begin(), sets[0].end(), sets[1].begin(), sets[1].end(), inserter(expected, expected.end()));
+    if (!test_bitmap_equals(result, expected))
+        return false;
+
+    // removing down to a handful turns a bitset back into an array
+    uint64_t size = bitmaps[0].get_size();
+    expected = sets[0];
+    for (auto const &n: sets[0])
+        if (n >> 16 == 0 && (n & 0xff) != 0) {
+            bitmaps[0].remove(n);
+            expected.erase(n);
+        }
+    string bytes;
+    bitmaps[0].serialize(bytes);
+    size_t offset = 0;
+    result.deserialize(bytes, offset);
+    return test_bitmap_equals(bitmaps[0], expected) && test_bitmap_equals(result, expected) && offset == bytes.size()
+           && bitmaps[0].get_size() + 65536 / 8 - 1024 < size;
+}
+
+bool test_bitmap_index() {
+    cout << "test_bitmap_index: " << endl;
+    if (!test_bitmap())
+        return false;
+    cout << "bitmap ok" << endl;
+
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::BOOLEAN));
+    HeapTable table("_test_bitmap_cpp", column_names, column_attributes);
+    table.create();
+    const int n = 20000;
+    Rows rows;
+    for (int a = 0; a < n; a++) {
+        rows.push_back(new Row({Value(a), Value("b" + to_string(a % 7)), Value(a % 3 == 0)}));
+        rows.back()->at(2).data_type = ColumnAttribute::BOOLEAN;
+    }
+    delete table.insert_many(&rows);
+    for (auto const& row: rows)
+        delete row;
+
+    BitmapIndex index_b(table, "bitmapb", {"b"});
+    BitmapIndex index_c(table, "bitmapc", {"c"});
+    index_b.create();
+    index_c.create();
+    table.attach_index(&index_b);
+    table.attach_index(&index_c);
+    ValueDict key;
+    key["c"] = Value(1);
+    if (index_c.count(&key) != (n + 2) / 3 || index_b.get_n_keys() != 7)
+        return false;
+    cout << "create ok" << endl;
+
+    // b = 'b3' AND NOT c, checked against a scan
+    key.clear();
+    key["b"] = Value(string("b3"));
+    Bitmap* matches = index_b.lookup_bitmap(&key);
+    key.clear();
+    key["c"] = Value(1);
+    Bitmap* trues = index_c.lookup_bitmap(&key);
+    Bitmap falses = index_c.get_rows();
+    falses.and_not(*trues);
+    matches->and_with(falses);
+    Handles* handles = BitmapIndex::handles(*matches);
+    bool combined = !handles->empty();
+    ColumnNames column_a = {"a"};
+    for (auto const& handle: *handles) {
+        ValueDict* row = table.project(handle, &column_a);
+        int a = (*row)["a"].n;
+        combined = combined && a % 7 == 3 && a % 3 != 0;
+        delete row;
+    }
+    uint64_t expected = 0, b3 = 0;
+    for (int a = 0; a < n; a++) {
+        expected += a % 7 == 3 && a % 3 != 0;
+        b3 += a % 7 == 3;
+    }
+    combined = combined && matches->count() == expected;
+    delete handles;
+    delete matches;
+    delete trues;
+    if (!combined)
+        return false;
+    cout << "and/not ok" << endl;
+
+    key.clear();
+    key["b"] = Value(string("b9"));
+    if (index_b.may_match(&key) || index_b.count(&key) != 0)
+        return false;
+    Row row = {Value(n), Value(string("b9")), Value(0)};
+    row[2].data_type = ColumnAttribute::BOOLEAN;
+    Handle added = table.insert(&row);
+    handles = index_b.lookup(&key);
+    bool inserted = handles->size() == 1 && (*handles)[0] == added;
+    delete handles;
+    table.del(added);
+    if (!inserted || index_b.count(&key) != 0 || index_b.get_rows().count() != (uint64_t) n)
+        return false;
+    cout << "insert/del ok" << endl;
+
+    table.detach_index(&index_b);
+    index_b.close();
+    key["b"] = Value(string("b3"));
+    if (index_b.count(&key) != b3 || index_b.get_rows().count() != (uint64_t) n)
+        return false;
+    index_b.close();
+    BitmapIndex reopened(table, "bitmapb", {"b"});
+    if (reopened.count(&key) != b3 || reopened.get_rows().count() != (uint64_t) n)
+        return false;
+    cout << "close/open ok" << endl;
+
+    table.detach_index(&index_c);
+    reopened.drop();
+    index_c.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file bitmap_index.h - compressed bitmap index implementation of DbIndex.
+ * Bitmap
+ * BitmapIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <map>
+#include <vector>
+#include "heap_storage.h"
+#include "index_key.h"
+#include "synopsis_file.h"
+
+/**
+ * @class Bitmap - compressed set of 32-bit numbers (roaring style).
+ *
+ * The numbers are grouped by their high 16 bits. Each group is kept in a container: a sorted
+ * array of the low 16 bits while it has at most ARRAY_MAX of them, and otherwise a bitset of
+ * 65536 bits. Sparse groups cost two bytes a number and dense ones an eighth of a byte, and the
+ * set operations work a container at a time.
+ */
+class Bitmap {
+public:
+	/**
+	 * Most numbers a container keeps as an array (above that a bitset is smaller).
+	 */
+	static const uint ARRAY_MAX = 4096;
+
+	Bitmap() : containers() {}
+	virtual ~Bitmap() {}
+
+	virtual void add(uint32_t n);
+	virtual void remove(uint32_t n);
+	virtual bool contains(uint32_t n) const;
+	virtual bool empty() const { return containers.empty(); }
+
+	/**
+	 * Number of numbers in the set.
+	 * @returns  cardinality
+	 */
+	virtual uint64_t count() const;
+
+	/**
+	 * Keep only the numbers also in other.
+	 */
+	virtual void and_with(const Bitmap &other);
+
+	/**
+	 * Add the numbers in other.
+	 */
+	virtual void or_with(const Bitmap &other);
+
+	/**
+	 * Remove the numbers in other (NOT other is universe.and_not(other)).
+	 */
+	virtual void and_not(const Bitmap &other);
+
+	/**
+	 * All the numbers, in order.
+	 * @returns  the numbers
+	 */
+	virtual std::vector<uint32_t> to_vector() const;
+
+	/**
+	 * Bytes used by the containers.
+	 * @returns  size in memory (and on disk, near enough)
+	 */
+	virtual uint64_t get_size() const;
+
+	/**
+	 * Append the bitmap's serialized form to bytes.
+	 */
+	virtual void serialize(std::string &bytes) const;
+
+	/**
+	 * Read back a bitmap written by serialize().
+	 * @param bytes   the serialized bitmaps
+	 * @param offset  where this one starts; returned by reference: where it ends
+	 */
+	virtual void deserialize(const std::string &bytes, size_t &offset);
+
+protected:
+	/**
+	 * Low 16 bits of the numbers in one group: array is used while bits is empty.
+	 */
+	struct Container {
+		std::vector<uint16_t> array;  // sorted
+		std::vector<uint64_t> bits;   // 1024 words when in use
+		uint32_t cardinality;
+
+		Container() : array(), bits(), cardinality(0) {}
+		bool is_bitset() const { return !bits.empty(); }
+		bool contains(uint16_t low) const;
+		void to_bitset();
+		void normalize();
+	};
+
+	std::map<uint16_t, Container> containers;  // non-empty containers by high 16 bits
+};
+
+/**
+ * @class BitmapIndex - bitmap index implementation of DbIndex (index type BITMAP), for BOOLEAN and
+ * other low-cardinality columns.
+ *
+ * For each distinct key (see encode_key()) there is a Bitmap of the rows that have it, and one more
+ * of all the rows. A row is numbered by its handle: block id << RECORD_BITS | record id, so the
+ * rows of each 64 blocks fall in one container. Predicates on the indexed columns are combined
+ * with AND, OR and NOT (and_not() from get_rows()) on the bitmaps, and counted, without reading the
+ * relation.
+ *
+ * The bitmaps are held in memory and written back by close() to a SynopsisFile
+ * (<table>-<index>.db). A file that wasn't closed cleanly is rebuilt from the relation when it is
+ * next opened.
+ */
+class BitmapIndex : public DbIndex {
+public:
+	/**
+	 * Bits of a row number for the record id (SlottedPage record ids stay well under this).
+	 */
+	static const uint RECORD_BITS = 10;
+
+	BitmapIndex(DbRelation& relation, Identifier name, ColumnNames key_columns);
+	virtual ~BitmapIndex();
+	BitmapIndex(const BitmapIndex& other) = delete;
+	BitmapIndex(BitmapIndex&& temp) = delete;
+	BitmapIndex& operator=(const BitmapIndex& other) = delete;
+	BitmapIndex& operator=(BitmapIndex&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual void release() { close(); }
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual bool may_match(const ValueDict* where) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+	virtual std::string report() const;
+
+	/**
+	 * The rows with exactly the given key.
+	 * @param key_values  a value for each key column
+	 * @returns           bitmap of their row numbers (freed by caller)
+	 */
+	virtual Bitmap* lookup_bitmap(const ValueDict* key_values) const;
+
+	/**
+	 * All the rows of the relation.
+	 * @returns  bitmap of their row numbers
+	 */
+	virtual const Bitmap& get_rows() const;
+
+	/**
+	 * Number of rows with the given key, without reading the relation.
+	 * @param key_values  a value for each key column
+	 * @returns           count of rows
+	 */
+	virtual uint64_t count(const ValueDict* key_values) const;
+
+	/**
+	 * Number of distinct keys.
+	 * @returns  number of bitmaps (besides the one of all rows)
+	 */
+	virtual uint get_n_keys() const { return (uint) bitmaps.size(); }
+
+	static uint32_t row_number(Handle handle);
+	static Handle row_handle(uint32_t row_number);
+
+	/**
+	 * The rows in a bitmap, in handle order.
+	 * @param bitmap  row numbers
+	 * @returns       their handles (freed by caller)
+	 */
+	static Handles* handles(const Bitmap &bitmap);
+
+protected:
+	SynopsisFile file;
+	KeyProfile key_profile;
+	ColumnOrdinals key_ordinals;
+	std::map<KeyBytes, Bitmap> bitmaps;
+	Bitmap rows;
+
+	virtual bool deserialize(const std::string &bytes);
+	virtual void serialize(std::string &bytes) const;
+	virtual void build();
+};
+
+bool test_bitmap_index();
@@ -0,0 +1,256 @@
+/**
+ * @file bloom_filter.cpp - implementation of:
+ * BloomFilter
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <cstring>
+#include "bloom_filter.h"
+using namespace std;
+
+// magic number of the filter file ("BLM2")
+static const uint32_t BLOOM_MAGIC = 0x324d4c42;
+
+// the filter is sized in blocks of lines
+static const uint LINES_PER_BLOCK = DbBlock::BLOCK_SZ / BloomFilter::LINE_SZ;
+
+// bits in a line
+static const uint LINE_BITS = BloomFilter::LINE_SZ * 8;
+
+BloomFilter::BloomFilter(DbRelation& relation, Identifier name, ColumnNames key_columns)
+        : DbIndex(relation, name, key_columns, false),
+          file(relation.get_table_name() + "-" + name + ".db", BLOOM_MAGIC),
+          key_profile(::key_profile(relation, key_columns)), key_ordinals(relation.get_column_ordinals(&key_columns)),
+          lines(), n_keys(0) {
+    if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+}
+
+BloomFilter::~BloomFilter() {
+    close();
+}
+
+// Create the file and set the bits for the rows already in the relation.
+void BloomFilter::create() {
+    this->file.create();
+    build();
+}
+
+// Remove the file (not written back first).
+void BloomFilter::drop() {
+    this->file.drop();
+}
+
+// Read the bits if they were written back by a close(); otherwise build them again.
+void BloomFilter::open() {
+    if (this->file.is_open())
+        return;
+    string bytes;
+    if (!this->file.open(bytes) || !deserialize(bytes))
+        build();
+}
+
+// Write back the bits and close the file.
+void BloomFilter::close() {
+    if (!this->file.is_open())
+        return;
+    string bytes;
+    serialize(bytes);
+    this->file.close(bytes);
+}
+
+// A Bloom filter only knows which keys are absent.
+Handles* BloomFilter::lookup(ValueDict*) const {
+    throw DbRelationError("BLOOM index " + this->name + " can't look up rows");
+}
+
+// Probe for the key in where, if it has a value for each of our columns (of the right kind).
+bool BloomFilter::may_match(const ValueDict* where) const {
+    KeyValue key;
+    if (!where_key(this->key_columns, this->key_profile, where, key))
+        return true;  // left for the scan to decide
+    return may_contain(key);
+}
+
+// Set the bits for the new row's key, rebuilding at twice the size once the filter is full.
+void BloomFilter::insert(Handle record) {
+    open();
+    add(hash(row_key(this->relation, this->key_profile, this->key_ordinals, record)));
+    if (++this->n_keys > get_capacity())
+        build();
+}
+
+// Bits can't be cleared (other keys may share them); the next build() drops them.
+void BloomFilter::del(Handle) {
+}
+
+std::string BloomFilter::report() const {
+    return to_string(this->n_keys) + " keys in " + to_string(n_lines()) + " lines ("
+           + to_string(this->lines.size() / 1024) + "KB)";
+}
+
+// Look at the bits of the key's line.
+bool BloomFilter::may_contain(const KeyValue &key) const {
+    const_cast<BloomFilter*>(this)->open();
+    try {
+        return probe(hash(encode_key(this->key_profile, key)));
+    } catch (DbRelationError &e) {
+        return true;  // too big to be a key
+    }
+}
+
+// Take the keys added and the lines, if there are whole records of them.
+bool BloomFilter::deserialize(const string &bytes) {
+    uint32_t n_keys;
+    if (bytes.size() < sizeof(n_keys))
+        return false;
+    size_t size = bytes.size() - sizeof(n_keys);
+    if (size == 0 || size % DbBlock::BLOCK_SZ != 0)
+        return false;
+    memcpy(&n_keys, bytes.data(), sizeof(n_keys));
+    this->lines.assign(bytes.begin() + sizeof(n_keys), bytes.end());
+    this->n_keys = n_keys;
+    return true;
+}
+
+// Keys added, then the lines.
+void BloomFilter::serialize(string &bytes) const {
+    bytes.reserve(sizeof(this->n_keys) + this->lines.size());
+    bytes.append((const char*) &this->n_keys, sizeof(this->n_keys));
+    bytes.append(this->lines.begin(), this->lines.end());
+}
+
+// Size the filter for twice the relation's rows (so it doesn't fill up right away) and set
+// their bits, with one scan.
+void BloomFilter::build() {
+    vector<uint64_t> hashes;
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor)
+            hashes.push_back(hash(row_key(this->relation, this->key_profile, this->key_ordinals, handle)));
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+    uint64_t bits = 2 * (uint64_t) hashes.size() * BITS_PER_KEY;
+    uint64_t n_blocks = (bits + LINES_PER_BLOCK * LINE_BITS - 1) / (LINES_PER_BLOCK * LINE_BITS);
+    this->lines.assign((size_t) max(n_blocks, (uint64_t) 1) * DbBlock::BLOCK_SZ, 0);
+    for (auto const& h: hashes)
+        add(h);
+    this->n_keys = (uint32_t) hashes.size();
+}
+
+// The high half of the hash picks the line; the low half gives the K bits in it by double hashing.
+void BloomFilter::add(uint64_t hash) {
+    char* line = &this->lines[(size_t) ((hash >> 32) % n_lines()) * LINE_SZ];
+    uint32_t a = (uint32_t) hash, b = ((a >> 16) | (a << 16)) | 1;
+    for (uint i = 0; i < K; i++) {
+        uint bit = (a + i * b) % LINE_BITS;
+        line[bit / 8] |= (char) (1 << (bit % 8));
+    }
+}
+
+bool BloomFilter::probe(uint64_t hash) const {
+    const char* line = &this->lines[(size_t) ((hash >> 32) % n_lines()) * LINE_SZ];
+    uint32_t a = (uint32_t) hash, b = ((a >> 16) | (a << 16)) | 1;
+    for (uint i = 0; i < K; i++) {
+        uint bit = (a + i * b) % LINE_BITS;
+        if ((line[bit / 8] & (1 << (bit % 8))) == 0)
+            return false;
+    }
+    return true;
+}
+
+// FNV-1a over the encoded key, then mixed so that both halves are usable.
+uint64_t BloomFilter::hash(const KeyBytes &key) {
+    uint64_t h = 14695981039346656037ULL;
+    for (auto const& c: key) {
+        h ^= (uint8_t) c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Check that the filter has every key in [from, to) and return how many of [to, to + n) it claims.
+bool test_bloom_keys(BloomFilter &filter, int from, int to, int n, int &false_positives) {
+    for (int a = from; a < to; a++)
+        if (!filter.may_contain({Value(a)}))
+            return false;
+    false_positives = 0;
+    for (int a = to; a < to + n; a++)
+        if (filter.may_contain({Value(a)}))
+            false_positives++;
+    return true;
+}
+
+bool test_bloom_filter() {
+    cout << "test_bloom_filter: " << endl;
+    const int n = 20000;
+    HeapTable table("_test_bloom_cpp", {"a", "b"},
+                    {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)});
+    test_fill_table(table, 0, n);
+
+    BloomFilter filter(table, "bloomindex", {"a"});
+    filter.create();
+    table.attach_index(&filter);
+    int false_positives;
+    if (!test_bloom_keys(filter, 0, n, n, false_positives) || false_positives > n / 40)
+        return false;
+    cout << "create ok, " << false_positives * 100.0 / n << "% false positives" << endl;
+
+    uint64_t capacity = filter.get_capacity();
+    for (int a = n; a < 3 * n; a++) {
+        Row row = {Value(a), Value(string("more"))};
+        table.insert(&row);
+    }
+    if (filter.get_capacity() <= capacity || !test_bloom_keys(filter, 0, 3 * n, n, false_positives)
+        || false_positives > n / 40)
+        return false;
+    cout << "insert/grow ok" << endl;
+
+    // an absent key is ruled out before any block is read
+    int absent = 3 * n;
+    while (filter.may_contain({Value(absent)}))
+        absent++;
+    ValueDict where;
+    where["a"] = Value(absent);
+    table.reset_scan_stats();
+    Handles* handles = table.select(&where);
+    bool skipped = handles->empty() && table.get_blocks_scanned() == 0;
+    delete handles;
+    where["a"] = Value(17);
+    handles = table.select(&where);
+    bool found = handles->size() == 1;
+    delete handles;
+    if (!skipped || !found)
+        return false;
+    cout << "select ok" << endl;
+
+    table.detach_index(&filter);
+    filter.close();
+    if (!test_bloom_keys(filter, 0, 3 * n, 0, false_positives) || filter.get_n_keys() != 3 * n)
+        return false;
+    filter.close();
+    BloomFilter reopened(table, "bloomindex", {"a"});
+    if (!test_bloom_keys(reopened, 0, 3 * n, 0, false_positives) || reopened.get_n_keys() != 3 * n)
+        return false;
+    cout << "close/open ok" << endl;
+
+    reopened.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bloom_filter.h - blocked Bloom filter implementation of DbIndex.
+ * BloomFilter: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <vector>
+#include "heap_storage.h"
+#include "index_key.h"
+#include "synopsis_file.h"
+
+/**
+ * @class BloomFilter - blocked Bloom filter on a column set of a relation (index type BLOOM).
+ * It can't find rows; it only answers may_match() for column = value conditions on all of its
+ * columns, false meaning no row has those values, so the caller can skip its scan without I/O.
+ *
+ * The filter is an array of LINE_SZ-byte lines. A key's hash picks one line and sets K bits in it,
+ * so a probe touches a single cache line. Deleting a row leaves its bits set (they only cost false
+ * positives). Once the keys added since the filter was built outnumber its capacity (BITS_PER_KEY
+ * bits for each), it is rebuilt from the relation at twice the size, which also clears the bits of
+ * deleted rows.
+ *
+ * The bits are held in memory while open and written back by close() to a SynopsisFile
+ * (<table>-<index>.db): the number of keys added, then the lines. A filter that wasn't closed is
+ * rebuilt from the relation when it is next opened.
+ */
+class BloomFilter : public DbIndex {
+public:
+	/**
+	 * Bytes in a line (one cache line).
+	 */
+	static const uint LINE_SZ = 64;
+
+	/**
+	 * Bits set for each key, all in the key's line.
+	 */
+	static const uint K = 6;
+
+	/**
+	 * Bits of filter per key it is sized for (about 1% false positives).
+	 */
+	static const uint BITS_PER_KEY = 10;
+
+	BloomFilter(DbRelation& relation, Identifier name, ColumnNames key_columns);
+	virtual ~BloomFilter();
+	BloomFilter(const BloomFilter& other) = delete;
+	BloomFilter(BloomFilter&& temp) = delete;
+	BloomFilter& operator=(const BloomFilter& other) = delete;
+	BloomFilter& operator=(BloomFilter&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual void release() { close(); }
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual bool may_match(const ValueDict* where) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+	virtual std::string report() const;
+
+	/**
+	 * Whether the filter may hold a key (the key's columns in order).
+	 * @param key  value of each key column
+	 * @returns    false if no row has the key
+	 */
+	virtual bool may_contain(const KeyValue &key) const;
+
+	/**
+	 * Number of keys the filter is sized for before it is rebuilt.
+	 * @returns  capacity in keys
+	 */
+	virtual uint64_t get_capacity() const { return (uint64_t) lines.size() * 8 / BITS_PER_KEY; }
+
+	/**
+	 * Number of keys added since the filter was last built (deleted rows included).
+	 * @returns  keys added
+	 */
+	virtual uint32_t get_n_keys() const { return n_keys; }
+
+protected:
+	SynopsisFile file;
+	KeyProfile key_profile;
+	ColumnOrdinals key_ordinals;
+	std::vector<char> lines;  // n_lines() * LINE_SZ bytes of bits
+	uint32_t n_keys;
+
+	virtual bool deserialize(const std::string &bytes);
+	virtual void serialize(std::string &bytes) const;
+	virtual void build();
+	virtual void add(uint64_t hash);
+	virtual bool probe(uint64_t hash) const;
+	virtual uint32_t n_lines() const { return (uint32_t) (lines.size() / LINE_SZ); }
+
+	static uint64_t hash(const KeyBytes &key);
+};
+
+bool test_bloom_filter();
@@ -0,0 +1,913 @@
+/**
+ * @file btree.cpp - implementation of:
+ * BTreeNode
+ * BTreeIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include "btree.h"
+using namespace std;
+
+/*
+ * *******************
+ * BTreeNode class
+ * *******************
+ */
+
+// bytes in record 1: leaf flag and link
+static const uint NODE_HEADER_SZ = sizeof(uint8_t) + sizeof(BlockID);
+
+// bytes SlottedPage uses for its block header and for each record's header
+static const uint PAGE_HEADER_SZ = 8;
+static const uint RECORD_HEADER_SZ = 4;
+
+BTreeNode::BTreeNode(HeapFile &file, BlockID block_id)
+        : link(0), keys(), handles(), children(), file(file), id(block_id), leaf(true) {
+    load();
+}
+
+BTreeNode::BTreeNode(HeapFile &file, bool leaf)
+        : link(0), keys(), handles(), children(), file(file), id(0), leaf(leaf) {
+    SlottedPage* block = file.get_new();
+    this->id = block->get_block_id();
+    delete block;
+}
+
+// Unmarshal the node from its block.
+void BTreeNode::load() {
+    SlottedPage* block = this->file.get(this->id);
+    Dbt data;
+    if (!block->view(1, data)) {
+        delete block;
+        throw DbRelationError("index block " + to_string(this->id) + " is not a node");
+    }
+    const char *bytes = (const char *) data.get_data();
+    this->leaf = bytes[0] != 0;
+    memcpy(&this->link, bytes + sizeof(uint8_t), sizeof(BlockID));
+    uint offset = this->leaf ? sizeof(BlockID) + sizeof(RecordID) : sizeof(BlockID);
+    for (RecordID record_id = block->next_id(1); record_id != 0; record_id = block->next_id(record_id)) {
+        block->view(record_id, data);
+        bytes = (const char *) data.get_data();
+        BlockID block_id;
+        memcpy(&block_id, bytes, sizeof(BlockID));
+        if (this->leaf) {
+            RecordID row_id;
+            memcpy(&row_id, bytes + sizeof(BlockID), sizeof(RecordID));
+            this->handles.push_back(Handle(block_id, row_id));
+        } else {
+            this->children.push_back(block_id);
+        }
+        this->keys.push_back(KeyBytes(bytes + offset, data.get_size() - offset));
+    }
+    delete block;
+}
+
+// Marshal the node into a fresh page, then put that page in place of the block.
+bool BTreeNode::save() {
+    char page_bytes[DbBlock::BLOCK_SZ];
+    Dbt page_data(page_bytes, sizeof(page_bytes));
+    SlottedPage page(page_data, get_id(), true);
+    char bytes[DbBlock::BLOCK_SZ];
+    try {
+        bytes[0] = this->leaf ? 1 : 0;
+        memcpy(bytes + sizeof(uint8_t), &this->link, sizeof(BlockID));
+        Dbt header(bytes, NODE_HEADER_SZ);
+        page.add(&header);
+        for (uint i = 0; i < this->keys.size(); i++) {
+            uint size;
+            if (this->leaf) {
+                memcpy(bytes, &this->handles[i].first, sizeof(BlockID));
+                memcpy(bytes + sizeof(BlockID), &this->handles[i].second, sizeof(RecordID));
+                size = sizeof(BlockID) + sizeof(RecordID);
+            } else {
+                memcpy(bytes, &this->children[i], sizeof(BlockID));
+                size = sizeof(BlockID);
+            }
+            memcpy(bytes + size, this->keys[i].data(), this->keys[i].size());
+            size += (uint) this->keys[i].size();
+            Dbt entry(bytes, size);
+            page.add(&entry);
+        }
+    } catch (DbBlockNoRoomError &e) {
+        return false;
+    }
+    this->file.put(&page);
+    return true;
+}
+
+// Binary search for the first key >= key.
+uint BTreeNode::lower_bound(const KeyBytes &key) const {
+    return (uint) (std::lower_bound(this->keys.begin(), this->keys.end(), key) - this->keys.begin());
+}
+
+// Binary search for the first key > key.
+uint BTreeNode::upper_bound(const KeyBytes &key) const {
+    return (uint) (std::upper_bound(this->keys.begin(), this->keys.end(), key) - this->keys.begin());
+}
+
+
+/*
+ * *******************
+ * BTreeIndex class
+ * *******************
+ */
+
+BTreeIndex::BTreeIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique,
+                       ColumnNames included_columns)
+        : DbIndex(relation, name, key_columns, unique), file(relation.get_table_name() + "-" + name), closed(true),
+          root_id(0), height(0), key_profile(::key_profile(relation, key_columns)), included_columns(included_columns),
+          entry_columns(key_columns), entry_profile(), entry_ordinals(), fill(FILL), sort_size(SORT_SZ), n_entries(0),
+          n_runs(0), build_seconds(0) {
+    if (key_columns.empty() || key_columns.size() + included_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+    for (auto const& column: included_columns) {
+        if (find(key_columns.begin(), key_columns.end(), column) != key_columns.end())
+            throw DbRelationError("column " + column + " is already in the key of index " + name);
+        this->entry_columns.push_back(column);
+    }
+    this->entry_profile = ::key_profile(relation, this->entry_columns);
+    this->entry_ordinals = relation.get_column_ordinals(&this->entry_columns);
+}
+
+BTreeIndex::~BTreeIndex() {
+    if (!this->closed)
+        close();  // get the blocks out of the buffer pool before the file goes away
+}
+
+// Scan the relation once for its keys, sort them, and build the tree bottom-up from the sorted entries.
+void BTreeIndex::create() {
+    auto start = chrono::steady_clock::now();
+    this->file.create();  // block 1 (STAT) comes with it
+    this->closed = false;
+    BTreeSorter sorter(this->sort_size);
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor)
+            sorter.add(record_entry(handle), handle);
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+    build(sorter);
+    save_stat();
+    this->n_runs = sorter.get_n_runs();
+    this->build_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void BTreeIndex::drop() {
+    this->file.drop();
+    this->closed = true;
+}
+
+void BTreeIndex::open() {
+    if (!this->closed)
+        return;
+    this->file.open();
+    this->closed = false;
+    read_stat();
+}
+
+void BTreeIndex::close() {
+    this->file.close();
+    this->closed = true;
+}
+
+// All the rows with exactly the given key.
+Handles* BTreeIndex::lookup(ValueDict* key_values) const {
+    KeyBytes key = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values));
+    return scan(&key, &key);
+}
+
+// All the rows whose keys start with the given values. The key columns are encoded one after the other,
+// so their keys all start with the bytes of those values, and scan() compares with max_key as a prefix.
+Handles* BTreeIndex::lookup_prefix(const ValueDict* key_values) const {
+    uint n = 0;
+    while (n < this->key_columns.size() && key_values->find(this->key_columns[n]) != key_values->end())
+        n++;
+    if (n == 0)
+        throw DbRelationError("no value for index column " + this->key_columns[0]);
+    ColumnNames columns(this->key_columns.begin(), this->key_columns.begin() + n);
+    KeyProfile profile(this->key_profile.begin(), this->key_profile.begin() + n);
+    KeyBytes prefix = encode_key(profile, dict_key(columns, profile, key_values));
+    return scan(&prefix, &prefix);
+}
+
+// All the rows with keys from min_key to max_key (either can be nullptr for no limit), in key order.
+// Entries are compared with the bounds on their key bytes only, so included columns don't matter.
+Handles* BTreeIndex::range(ValueDict* min_key, ValueDict* max_key) const {
+    KeyBytes min_value, max_value;
+    if (min_key != nullptr)
+        min_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, min_key));
+    if (max_key != nullptr)
+        max_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, max_key));
+    return scan(min_key == nullptr ? nullptr : &min_value, max_key == nullptr ? nullptr : &max_value);
+}
+
+// Whether every column is a key or included column.
+bool BTreeIndex::covers(const ColumnNames* column_names) const {
+    for (auto const& column: *column_names)
+        if (find(this->entry_columns.begin(), this->entry_columns.end(), column) == this->entry_columns.end())
+            return false;
+    return true;
+}
+
+// Index-only scan: the leading key columns with values in where bound the scan of the leaves, and the
+// rest of where is checked against each decoded entry. The relation is never read.
+Rows* BTreeIndex::lookup_rows(const ValueDict* where, const ColumnNames* column_names) const {
+    if (!covers(column_names))
+        throw DbRelationError("index " + this->name + " does not cover the columns");
+    ColumnNames prefix_columns;
+    if (where != nullptr)
+        for (auto const& column: this->key_columns) {
+            if (where->find(column) == where->end())
+                break;
+            prefix_columns.push_back(column);
+        }
+    KeyProfile prefix_profile(this->key_profile.begin(), this->key_profile.begin() + prefix_columns.size());
+    KeyBytes prefix;
+    if (!prefix_columns.empty())
+        prefix = encode_key(prefix_profile, dict_key(prefix_columns, prefix_profile, where));
+
+    // where's other columns are checked, and the selected ones picked out, by position in the entries
+    ColumnOrdinals checked, selected;
+    Row values;
+    if (where != nullptr)
+        for (auto const& condition: *where) {
+            if (find(prefix_columns.begin(), prefix_columns.end(), condition.first) != prefix_columns.end())
+                continue;
+            auto column = find(this->entry_columns.begin(), this->entry_columns.end(), condition.first);
+            if (column == this->entry_columns.end())
+                throw DbRelationError("index " + this->name + " does not cover column " + condition.first);
+            checked.push_back((uint) (column - this->entry_columns.begin()));
+            values.push_back(condition.second);
+        }
+    for (auto const& column_name: *column_names)
+        selected.push_back((uint) (find(this->entry_columns.begin(), this->entry_columns.end(), column_name)
+                                   - this->entry_columns.begin()));
+
+    vector<KeyBytes> entries;
+    delete scan(prefix_columns.empty() ? nullptr : &prefix, prefix_columns.empty() ? nullptr : &prefix, &entries);
+    Rows* rows = new Rows();
+    for (auto const& entry: entries) {
+        KeyValue decoded = decode_key(this->entry_profile, entry.data(), (uint) entry.size());
+        bool match = true;
+        for (uint i = 0; match && i < checked.size(); i++) {
+            const Value& value = decoded[checked[i]];  // same test as a table scan's
+            match = value.data_type == values[i].data_type
+                    && (value.data_type == ColumnAttribute::TEXT ? value.s == values[i].s : value.n == values[i].n);
+        }
+        if (!match)
+            continue;
+        Row* row = new Row();
+        row->reserve(selected.size());
+        for (auto const& position: selected)
+            row->push_back(decoded[position]);
+        rows->push_back(row);
+    }
+    return rows;
+}
+
+// Descend to the leaf for the record's entry, splitting nodes on the way back up as needed.
+void BTreeIndex::insert(Handle record) {
+    open();
+    KeyBytes key = record_entry(record);
+    if (this->unique) {
+        KeyBytes key_only = key.substr(0, key_size(this->key_profile, key.data(), (uint) key.size()));
+        Handles* existing = scan(&key_only, &key_only);
+        bool duplicate = !existing->empty();
+        delete existing;
+        if (duplicate)
+            throw DbRelationError("duplicate key for unique index " + this->name);
+    }
+
+    // remember the interior nodes we came through and which child we took in each
+    vector<pair<BlockID, uint>> path;
+    BlockID node_id = this->root_id;
+    for (uint level = this->height; level > 1; level--) {
+        BTreeNode interior(this->file, node_id);
+        uint position = interior.upper_bound(key);
+        path.push_back(pair<BlockID, uint>(node_id, position));
+        node_id = interior.child(position);
+    }
+
+    BTreeNode* node = new BTreeNode(this->file, node_id);
+    uint position = node->upper_bound(key);
+    node->keys.insert(node->keys.begin() + position, key);
+    node->handles.insert(node->handles.begin() + position, record);
+    try {
+        KeyBytes boundary;
+        BlockID right_id;
+        while (!node->save()) {
+            split(node, boundary, right_id);
+            delete node;
+            node = nullptr;
+            if (path.empty()) {
+                // grow a new root
+                BTreeNode root(this->file, false);
+                root.link = this->root_id;
+                root.keys.push_back(boundary);
+                root.children.push_back(right_id);
+                root.save();
+                this->root_id = root.get_id();
+                this->height++;
+                save_stat();
+                return;
+            }
+            node = new BTreeNode(this->file, path.back().first);
+            position = path.back().second;
+            path.pop_back();
+            node->keys.insert(node->keys.begin() + position, boundary);
+            node->children.insert(node->children.begin() + position, right_id);
+        }
+    } catch (DbRelationError& e) {
+        delete node;
+        throw;
+    }
+    delete node;
+}
+
+// Remove the entry for the record (if there is one). Nodes are never merged.
+void BTreeIndex::del(Handle record) {
+    open();
+    KeyBytes key = record_entry(record);
+    BTreeNode* leaf = find_leaf(&key);
+    uint i = leaf->lower_bound(key);
+    while (true) {
+        for (; i < leaf->keys.size(); i++) {
+            if (leaf->keys[i] > key) {
+                delete leaf;
+                return;
+            }
+            if (leaf->handles[i] == record) {
+                leaf->keys.erase(leaf->keys.begin() + i);
+                leaf->handles.erase(leaf->handles.begin() + i);
+                leaf->save();
+                delete leaf;
+                return;
+            }
+        }
+        BlockID next = leaf->link;
+        delete leaf;
+        if (next == 0)
+            return;
+        leaf = new BTreeNode(this->file, next);
+        i = 0;
+    }
+}
+
+// Size of the tree, and how it was built if create() was what made it.
+string BTreeIndex::report() const {
+    if (this->closed)
+        return "";
+    uint n_blocks = this->file.get_last_block_id();
+    ostringstream out;
+    out << "height " << this->height << ", " << n_blocks << " blocks (" << n_blocks * DbBlock::BLOCK_SZ / 1024 << "KB)";
+    if (this->build_seconds > 0) {
+        out << ", " << this->n_entries << " entries built in " << this->build_seconds << "s";
+        if (this->n_runs > 0)
+            out << " with " << this->n_runs << " sorted runs";
+    }
+    return out.str();
+}
+
+void BTreeIndex::set_build(uint fill, uint sort_size) {
+    if (fill == 0 || fill > 100)
+        throw DbRelationError("fill factor must be from 1 to 100 percent");
+    this->fill = fill;
+    this->sort_size = sort_size;
+}
+
+// Root block id and height from record 1 of the STAT block.
+void BTreeIndex::read_stat() {
+    SlottedPage* stat = this->file.get(STAT);
+    Dbt data;
+    bool ok = stat->view(1, data);
+    if (ok) {
+        const char *bytes = (const char *) data.get_data();
+        memcpy(&this->root_id, bytes, sizeof(BlockID));
+        memcpy(&this->height, bytes + sizeof(BlockID), sizeof(uint32_t));
+    }
+    delete stat;
+    if (!ok)
+        throw DbRelationError("index " + this->name + " has not been built");
+}
+
+void BTreeIndex::save_stat() {
+    SlottedPage* stat = this->file.get(STAT);
+    char bytes[sizeof(BlockID) + sizeof(uint32_t)];
+    uint32_t height = this->height;
+    memcpy(bytes, &this->root_id, sizeof(BlockID));
+    memcpy(bytes + sizeof(BlockID), &height, sizeof(uint32_t));
+    Dbt data(bytes, sizeof(bytes));
+    Dbt old;
+    if (stat->view(1, old))
+        stat->put(1, data);
+    else
+        stat->add(&data);
+    this->file.put(stat);
+    delete stat;
+}
+
+// Leaf entry for a row in the relation: its key followed by its included columns.
+KeyBytes BTreeIndex::record_entry(Handle record) const {
+    return row_key(this->relation, this->entry_profile, this->entry_ordinals, record);
+}
+
+// Walk the leaves from the first entry >= min_key to the last one whose leading bytes are <= max_key,
+// optionally collecting the entries as well as their handles. The bounds can be encoded keys or
+// any leading columns of them, since the encoding of each column delimits itself.
+Handles* BTreeIndex::scan(const KeyBytes* min_key, const KeyBytes* max_key, vector<KeyBytes>* entries) const {
+    const_cast<BTreeIndex*>(this)->open();
+    Handles* handles = new Handles();
+    BTreeNode* leaf = find_leaf(min_key);
+    uint i = min_key == nullptr ? 0 : leaf->lower_bound(*min_key);
+    while (true) {
+        for (; i < leaf->keys.size(); i++) {
+            if (max_key != nullptr && leaf->keys[i].compare(0, max_key->size(), *max_key) > 0) {
+                delete leaf;
+                return handles;
+            }
+            handles->push_back(leaf->handles[i]);
+            if (entries != nullptr)
+                entries->push_back(leaf->keys[i]);
+        }
+        BlockID next = leaf->link;
+        delete leaf;
+        if (next == 0)
+            return handles;
+        leaf = new BTreeNode(this->file, next);
+        i = 0;
+    }
+}
+
+// Leftmost leaf which could hold key (the leftmost leaf of all if key is nullptr).
+// Equal keys can be on either side of a boundary, so go left of boundaries equal to key.
+BTreeNode* BTreeIndex::find_leaf(const KeyBytes* key) const {
+    BTreeNode* node = new BTreeNode(this->file, this->root_id);
+    for (uint level = this->height; level > 1; level--) {
+        BlockID child_id = node->child(key == nullptr ? 0 : node->lower_bound(*key));
+        delete node;
+        node = new BTreeNode(this->file, child_id);
+    }
+    return node;
+}
+
+// Move the upper half of a full node into a new right sibling and save both.
+// Returns the boundary key to go into the parent and the new sibling's block id.
+void BTreeIndex::split(BTreeNode* node, KeyBytes &boundary, BlockID &right_id) {
+    if (node->keys.size() < 3)
+        throw DbRelationError("index key too big for a block");
+    BTreeNode right(this->file, node->is_leaf());
+    uint mid = (uint) node->keys.size() / 2;
+    if (node->is_leaf()) {
+        right.keys.assign(node->keys.begin() + mid, node->keys.end());
+        right.handles.assign(node->handles.begin() + mid, node->handles.end());
+        node->keys.resize(mid);
+        node->handles.resize(mid);
+        right.link = node->link;
+        node->link = right.get_id();
+        boundary = right.keys[0];
+    } else {
+        boundary = node->keys[mid];
+        right.link = node->children[mid];
+        right.keys.assign(node->keys.begin() + mid + 1, node->keys.end());
+        right.children.assign(node->children.begin() + mid + 1, node->children.end());
+        node->keys.resize(mid);
+        node->children.resize(mid);
+    }
+    if (!right.save() || !node->save())
+        throw DbRelationError("index key too big for a block");
+    right_id = right.get_id();
+}
+
+
+// Fill leaves left to right from the sorted entries. When a node at any level is full, the next
+// entry starts a new node there, and that entry's key and the new node go up into the level above
+// (which is started, with the first node of the level below as its link, the first time it is
+// needed). At the end, the top level's only node is the root.
+void BTreeIndex::build(BTreeSorter &sorter) {
+    const uint capacity = PAGE_HEADER_SZ + (DbBlock::BLOCK_SZ - PAGE_HEADER_SZ) * this->fill / 100;
+    const uint empty = PAGE_HEADER_SZ + RECORD_HEADER_SZ + NODE_HEADER_SZ;
+    vector<BTreeNode*> levels;  // node being filled at each level, leaves first
+    vector<uint> used;          // bytes of its block it will take
+    vector<BlockID> first_ids;  // first node of each level
+    KeyBytes key, previous;
+    Handle handle;
+    this->n_entries = 0;
+    try {
+        levels.push_back(new BTreeNode(this->file, true));
+        used.push_back(empty);
+        first_ids.push_back(levels[0]->get_id());
+        while (sorter.next(key, handle)) {
+            if (this->unique && this->n_entries > 0 && key.compare(0, previous.size(), previous) == 0)
+                throw DbRelationError("duplicate key for unique index " + this->name);
+            uint size = RECORD_HEADER_SZ + sizeof(BlockID) + sizeof(RecordID) + (uint) key.size();
+            if (used[0] + size > capacity && !levels[0]->keys.empty()) {
+                BTreeNode* leaf = new BTreeNode(this->file, true);
+                levels[0]->link = leaf->get_id();
+                if (!levels[0]->save())
+                    throw DbRelationError("index key too big for a block");
+                delete levels[0];
+                levels[0] = leaf;
+                used[0] = empty;
+
+                // the new node's first key and block id go up a level, and maybe further
+                BlockID child_id = leaf->get_id();
+                for (uint level = 1; ; level++) {
+                    if (level == levels.size()) {
+                        levels.push_back(new BTreeNode(this->file, false));
+                        levels.back()->link = first_ids[level - 1];
+                        used.push_back(empty);
+                        first_ids.push_back(levels.back()->get_id());
+                    }
+                    uint boundary_size = RECORD_HEADER_SZ + sizeof(BlockID) + (uint) key.size();
+                    if (used[level] + boundary_size <= capacity || levels[level]->keys.empty()) {
+                        levels[level]->keys.push_back(key);
+                        levels[level]->children.push_back(child_id);
+                        used[level] += boundary_size;
+                        break;
+                    }
+                    BTreeNode* node = new BTreeNode(this->file, false);
+                    node->link = child_id;
+                    if (!levels[level]->save())
+                        throw DbRelationError("index key too big for a block");
+                    delete levels[level];
+                    levels[level] = node;
+                    used[level] = empty;
+                    child_id = node->get_id();
+                }
+            }
+            levels[0]->keys.push_back(key);
+            levels[0]->handles.push_back(handle);
+            used[0] += size;
+            if (this->unique)
+                previous = key.substr(0, key_size(this->key_profile, key.data(), (uint) key.size()));
+            this->n_entries++;
+        }
+        for (auto const& node: levels)
+            if (!node->save())
+                throw DbRelationError("index key too big for a block");
+    } catch (DbRelationError& e) {
+        for (auto const& node: levels)
+            delete node;
+        throw;
+    }
+    this->root_id = levels.back()->get_id();
+    this->height = (uint) levels.size();
+    for (auto const& node: levels)
+        delete node;
+}
+
+
+/*
+ * *******************
+ * BTreeSorter class
+ * *******************
+ */
+
+BTreeSorter::BTreeSorter(uint run_size)
+        : run_size(run_size), buffer_size(0), buffer(), position(0), runs(), heads(),
+          heap(), merging(false) {
+}
+
+BTreeSorter::~BTreeSorter() {
+    for (auto const& run: this->runs)
+        fclose(run);
+}
+
+// Buffer the entry, spilling the buffer to a sorted run once it is run_size bytes.
+void BTreeSorter::add(const KeyBytes &key, Handle handle) {
+    this->buffer.push_back(Entry(key, handle));
+    this->buffer_size += sizeof(Entry) + (uint) key.size();
+    if (this->buffer_size >= this->run_size)
+        spill();
+}
+
+// Entries come straight from the sorted buffer if nothing was spilled; otherwise the
+// runs are merged, taking the least head each time.
+bool BTreeSorter::next(KeyBytes &key, Handle &handle) {
+    auto after = [this](uint a, uint b) { return this->after(a, b); };
+    if (!this->merging) {
+        this->merging = true;
+        if (this->runs.empty()) {
+            sort(this->buffer.begin(), this->buffer.end(), less);
+        } else {
+            if (!this->buffer.empty())
+                spill();
+            this->heads.resize(this->runs.size());
+            for (uint run = 0; run < this->runs.size(); run++) {
+                rewind(this->runs[run]);
+                if (read(run))
+                    this->heap.push_back(run);
+            }
+            make_heap(this->heap.begin(), this->heap.end(), after);
+        }
+    }
+
+    if (this->runs.empty()) {
+        if (this->position == this->buffer.size())
+            return false;
+        key = move(this->buffer[this->position].first);
+        handle = this->buffer[this->position].second;
+        this->position++;
+        return true;
+    }
+    if (this->heap.empty())
+        return false;
+    pop_heap(this->heap.begin(), this->heap.end(), after);
+    uint run = this->heap.back();
+    key = this->heads[run].first;
+    handle = this->heads[run].second;
+    if (read(run))
+        push_heap(this->heap.begin(), this->heap.end(), after);
+    else
+        this->heap.pop_back();
+    return true;
+}
+
+// Sort the buffer and write it out to a temporary file: each entry is the encoded key's
+// 2-byte size, the key, and the handle.
+void BTreeSorter::spill() {
+    sort(this->buffer.begin(), this->buffer.end(), less);
+    FILE *run = tmpfile();
+    if (run == nullptr)
+        throw DbRelationError("cannot make a temporary file for sorting index entries");
+    this->runs.push_back(run);
+    char bytes[sizeof(uint16_t) + MAX_KEY_SZ + sizeof(BlockID) + sizeof(RecordID)];
+    for (auto const& entry: this->buffer) {
+        uint16_t size = (uint16_t) entry.first.size();
+        memcpy(bytes, &size, sizeof(uint16_t));
+        memcpy(bytes + sizeof(uint16_t), entry.first.data(), size);
+        uint offset = sizeof(uint16_t) + size;
+        memcpy(bytes + offset, &entry.second.first, sizeof(BlockID));
+        memcpy(bytes + offset + sizeof(BlockID), &entry.second.second, sizeof(RecordID));
+        offset += sizeof(BlockID) + sizeof(RecordID);
+        if (fwrite(bytes, 1, offset, run) != offset)
+            throw DbRelationError("error writing a sorted run of index entries");
+    }
+    this->buffer.clear();
+    this->buffer_size = 0;
+}
+
+// Read the next entry of a run into its head. Returns false at the end of the run.
+bool BTreeSorter::read(uint run) {
+    FILE *file = this->runs[run];
+    uint16_t size;
+    if (fread(&size, sizeof(uint16_t), 1, file) != 1)
+        return false;
+    char bytes[MAX_KEY_SZ + sizeof(BlockID) + sizeof(RecordID)];
+    if (fread(bytes, 1, size + sizeof(BlockID) + sizeof(RecordID), file) != size + sizeof(BlockID) + sizeof(RecordID))
+        throw DbRelationError("error reading a sorted run of index entries");
+    Entry &head = this->heads[run];
+    head.first.assign(bytes, size);
+    memcpy(&head.second.first, bytes + size, sizeof(BlockID));
+    memcpy(&head.second.second, bytes + size + sizeof(BlockID), sizeof(RecordID));
+    return true;
+}
+
+// For the heap of runs: true if run a's head comes after run b's (so the least is on top).
+bool BTreeSorter::after(uint a, uint b) const {
+    return less(this->heads[b], this->heads[a]);
+}
+
+bool BTreeSorter::less(const Entry &a, const Entry &b) {
+    int c = a.first.compare(b.first);
+    if (c != 0)
+        return c < 0;
+    return a.second < b.second;
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Make a row for the btree tests: a, b (one of 100 padded strings), c
+Row* test_btree_row(int a) {
+    string b = "b" + to_string(a % 100);
+    b.resize(150, '.');
+    Row* row = new Row({Value(a), Value(b), Value(a % 2 == 0)});
+    (*row)[2].data_type = ColumnAttribute::BOOLEAN;
+    return row;
+}
+
+// Check that a lookup on the unique index finds exactly the row for a.
+bool test_btree_lookup(DbRelation &table, DbIndex &index, int a) {
+    ValueDict key;
+    key["a"] = Value(a);
+    Handles* handles = index.lookup(&key);
+    bool ok = handles->size() == 1;
+    if (ok) {
+        ColumnNames column_a = {"a"};
+        ValueDict* row = table.project((*handles)[0], &column_a);
+        ok = (*row)["a"] == Value(a);
+        delete row;
+    }
+    delete handles;
+    return ok;
+}
+
+bool test_btree() {
+    cout << "test_btree: " << endl;
+    ColumnNames column_names = {"a", "b", "c"};
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::BOOLEAN));
+    HeapTable table("_test_btree_cpp", column_names, column_attributes);
+    table.create();
+    const int n = 5000;
+    Rows rows;
+    for (int a = 0; a < n; a++)
+        rows.push_back(test_btree_row(a));
+    delete table.insert_many(&rows);
+    for (auto const& row: rows)
+        delete row;
+
+    BTreeIndex index_a(table, "fooindex", {"a"}, true);
+    BTreeIndex index_b(table, "barindex", {"b"}, false);
+    index_a.create();
+    index_b.create();
+    table.attach_index(&index_a);
+    table.attach_index(&index_b);
+    if (index_a.get_height() < 2 || index_b.get_height() < 3)
+        return false;
+    cout << "create ok, height " << index_a.get_height() << " and " << index_b.get_height() << endl;
+
+    for (int a = 0; a < n; a += 7)
+        if (!test_btree_lookup(table, index_a, a))
+            return false;
+    ValueDict key;
+    key["a"] = Value(n);
+    Handles* handles = index_a.lookup(&key);
+    bool missing = handles->empty();
+    delete handles;
+    if (!missing)
+        return false;
+    Row* row = test_btree_row(42);
+    key.clear();
+    key["b"] = (*row)[1];
+    delete row;
+    handles = index_b.lookup(&key);
+    bool duplicates_ok = handles->size() == n / 100;
+    delete handles;
+    if (!duplicates_ok)
+        return false;
+    cout << "lookup ok" << endl;
+
+    ValueDict min_key, max_key;
+    min_key["a"] = Value(100);
+    max_key["a"] = Value(199);
+    handles = index_a.range(&min_key, &max_key);
+    bool range_ok = handles->size() == 100;
+    ColumnNames column_a = {"a"};
+    for (uint i = 0; range_ok && i < handles->size(); i++) {
+        ValueDict* values = table.project((*handles)[i], &column_a);
+        range_ok = (*values)["a"] == Value(100 + (int) i);
+        delete values;
+    }
+    delete handles;
+    handles = index_a.range(nullptr, &min_key);
+    range_ok = range_ok && handles->size() == 101;
+    delete handles;
+    if (!range_ok)
+        return false;
+    cout << "range ok" << endl;
+
+    row = test_btree_row(17);
+    bool rejected = false;
+    try {
+        table.insert(row);
+    } catch (DbRelationError &e) {
+        rejected = true;
+    }
+    delete row;
+    handles = table.select();
+    rejected = rejected && handles->size() == n;
+    delete handles;
+    if (!rejected)
+        return false;
+    cout << "unique ok" << endl;
+
+    key.clear();
+    key["a"] = Value(17);
+    handles = index_a.lookup(&key);
+    table.del((*handles)[0]);
+    delete handles;
+    handles = index_a.lookup(&key);
+    bool deleted = handles->empty();
+    delete handles;
+    if (!deleted)
+        return false;
+    row = test_btree_row(n + 17);
+    table.insert(row);
+    delete row;
+    if (!test_btree_lookup(table, index_a, n + 17))
+        return false;
+    cout << "insert/del ok" << endl;
+
+    BTreeIndex index_ba(table, "bazindex", {"b", "a"}, true);
+    index_ba.set_build(50, 64 * 1024);  // half-full nodes, and spill sorted runs to disk
+    index_ba.create();
+    if (index_ba.report().find("sorted runs") == string::npos)
+        return false;
+    row = test_btree_row(42);
+    min_key.clear();
+    min_key["b"] = (*row)[1];
+    min_key["a"] = Value(0);
+    max_key.clear();
+    max_key["b"] = (*row)[1];
+    max_key["a"] = Value(n);
+    delete row;
+    handles = index_ba.range(&min_key, &max_key);
+    bool build_ok = handles->size() == n / 100;
+    for (uint i = 0; build_ok && i < handles->size(); i++) {
+        ValueDict* values = table.project((*handles)[i], &column_a);
+        build_ok = (*values)["a"] == Value(42 + 100 * (int) i);
+        delete values;
+    }
+    delete handles;
+    min_key.erase("a");
+    handles = index_ba.lookup_prefix(&min_key);  // just b, the leading key column
+    build_ok = build_ok && handles->size() == n / 100;
+    delete handles;
+    index_ba.drop();
+    BTreeIndex index_c(table, "quxindex", {"c"}, true);
+    try {
+        index_c.create();
+        build_ok = false;
+    } catch (DbRelationError &e) {
+        // duplicate keys
+    }
+    index_c.drop();
+    if (!build_ok)
+        return false;
+    cout << "bulk build ok" << endl;
+
+    BTreeIndex index_cover(table, "coverindex", {"c", "a"}, true, {"b"});
+    index_cover.create();
+    table.attach_index(&index_cover);
+    ColumnNames column_ab = {"a", "b"};
+    ValueDict where;
+    where["c"] = Value(1);
+    where["c"].data_type = ColumnAttribute::BOOLEAN;
+    Rows* found = index_cover.lookup_rows(&where, &column_ab);
+    bool covering_ok = index_cover.covers(&column_ab) && !index_a.covers(&column_ab) && found->size() == n / 2;
+    for (uint i = 0; covering_ok && i < found->size(); i++) {
+        row = test_btree_row(2 * (int) i);
+        covering_ok = (*found)[i]->at(0) == (*row)[0] && (*found)[i]->at(1) == (*row)[1];
+        delete row;
+    }
+    for (auto const& found_row: *found)
+        delete found_row;
+    delete found;
+    row = test_btree_row(42);
+    where["b"] = (*row)[1];  // not a leading key column, so checked entry by entry
+    delete row;
+    found = index_cover.lookup_rows(&where, &column_ab);
+    covering_ok = covering_ok && found->size() == n / 100;
+    for (auto const& found_row: *found)
+        delete found_row;
+    delete found;
+    row = test_btree_row(n + 42);
+    Handle added = table.insert(row);
+    delete row;
+    where.erase("b");
+    found = index_cover.lookup_rows(&where, &column_ab);
+    covering_ok = covering_ok && found->size() == n / 2 + 1 && found->back()->at(0) == Value(n + 42);
+    for (auto const& found_row: *found)
+        delete found_row;
+    delete found;
+    table.del(added);
+    found = index_cover.lookup_rows(nullptr, &column_ab);
+    covering_ok = covering_ok && found->size() == n;
+    for (auto const& found_row: *found)
+        delete found_row;
+    delete found;
+    table.detach_index(&index_cover);
+    index_cover.drop();
+    if (!covering_ok)
+        return false;
+    cout << "covering ok" << endl;
+
+    table.detach_index(&index_a);
+    index_a.close();
+    BTreeIndex reopened(table, "fooindex", {"a"}, true);  // a closed Db can't be opened again
+    if (!test_btree_lookup(table, reopened, n + 17) || !test_btree_lookup(table, reopened, n - 1))
+        return false;
+    cout << "close/open ok" << endl;
+
+    table.detach_index(&index_b);
+    reopened.drop();
+    index_b.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
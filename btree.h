@@ -0,0 +1,266 @@
+/**
+ * @file btree.h - B+tree index implementation of DbIndex.
+ * BTreeNode
+ * BTreeIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <cstdio>
+#include "heap_storage.h"
+#include "index_key.h"
+
+/**
+ * @class BTreeNode - one block of a BTreeIndex, held in memory while it is worked on.
+ *
+ * A node is a SlottedPage of its index's HeapFile:
+ *      Record 1: 1-byte leaf flag followed by the 4-byte link
+ *      Record 2: first entry
+ *      Record 3: second entry
+ *      etc.
+ * Entries are in key order. A leaf entry is the handle (block id and record id) of the row it
+ * indexes followed by the row's encoded key (see encode_key()) and then, for a covering index, the
+ * encoded values of its included columns; the link is the next leaf to the right (0 for the last).
+ * An interior entry is the block id of the child holding the keys from a boundary key up to the
+ * next one, followed by that boundary key; the link is the child for keys before the first
+ * boundary. Keys are compared as bytes.
+ *
+ * The node is decoded when it is read, so it doesn't keep its block pinned in the buffer pool.
+ */
+class BTreeNode {
+public:
+	/**
+	 * Read an existing node.
+	 * @param file      the index's file
+	 * @param block_id  which block the node is in
+	 */
+	BTreeNode(HeapFile &file, BlockID block_id);
+
+	/**
+	 * Make an empty node in a new block (not written until save()).
+	 * @param file  the index's file
+	 * @param leaf  true for a leaf, false for an interior node
+	 */
+	BTreeNode(HeapFile &file, bool leaf);
+
+	virtual ~BTreeNode() {}
+	BTreeNode(const BTreeNode& other) = delete;
+	BTreeNode(BTreeNode&& temp) = delete;
+	BTreeNode& operator=(const BTreeNode& other) = delete;
+	BTreeNode& operator=(BTreeNode&& temp) = delete;
+
+	virtual bool is_leaf() const { return leaf; }
+	virtual BlockID get_id() const { return id; }
+
+	/**
+	 * Write the node back to its block.
+	 * @returns  false if it doesn't fit in a block (nothing is written -- split it)
+	 */
+	virtual bool save();
+
+	/**
+	 * Position of the first key not less than key.
+	 * @param key  key to look for
+	 * @returns    index into keys (keys.size() if they are all less)
+	 */
+	virtual uint lower_bound(const KeyBytes &key) const;
+
+	/**
+	 * Position of the first key greater than key.
+	 * @param key  key to look for
+	 * @returns    index into keys (keys.size() if none is greater)
+	 */
+	virtual uint upper_bound(const KeyBytes &key) const;
+
+	/**
+	 * Child of an interior node to descend to.
+	 * @param position  one more than the index of the boundary on the left of the child
+	 *                  (0 for the link)
+	 * @returns         block id of the child
+	 */
+	virtual BlockID child(uint position) const { return position == 0 ? link : children[position - 1]; }
+
+	BlockID link;                   // leaf: next leaf; interior: child before keys[0]
+	std::vector<KeyBytes> keys;
+	Handles handles;                // leaf only: the row for each key
+	std::vector<BlockID> children;  // interior only: the child starting at each key
+
+protected:
+	HeapFile &file;
+	BlockID id;
+	bool leaf;
+
+	virtual void load();
+};
+
+/**
+ * @class BTreeSorter - external merge sort of (key, handle) entries for building a BTreeIndex.
+ *
+ * Entries are added in any order and come back from next() in key order (handle order among
+ * equal keys). Up to run_size bytes of entries are sorted in memory at a time; beyond that each
+ * sorted run is written to a temporary file and the runs are merged as they are read back.
+ */
+class BTreeSorter {
+public:
+	/**
+	 * @param run_size  bytes of entries to sort in memory at a time
+	 */
+	BTreeSorter(uint run_size);
+	virtual ~BTreeSorter();
+	BTreeSorter(const BTreeSorter& other) = delete;
+	BTreeSorter(BTreeSorter&& temp) = delete;
+	BTreeSorter& operator=(const BTreeSorter& other) = delete;
+	BTreeSorter& operator=(BTreeSorter&& temp) = delete;
+
+	/**
+	 * Add an entry to be sorted (only before the first call to next()).
+	 * @param key     the key
+	 * @param handle  the row it came from
+	 */
+	virtual void add(const KeyBytes &key, Handle handle);
+
+	/**
+	 * Take the next entry in order.
+	 * @param key     returned by reference: its key
+	 * @param handle  returned by reference: its row
+	 * @returns       false if there are no more
+	 */
+	virtual bool next(KeyBytes &key, Handle &handle);
+
+	/**
+	 * Number of sorted runs written to disk.
+	 * @returns  0 if everything was sorted in memory
+	 */
+	virtual uint get_n_runs() const { return (uint) runs.size(); }
+
+protected:
+	typedef std::pair<KeyBytes, Handle> Entry;
+
+	uint run_size;
+	uint buffer_size;
+	std::vector<Entry> buffer;
+	uint position;               // next entry of buffer (when there are no runs)
+	std::vector<FILE*> runs;
+	std::vector<Entry> heads;    // current entry of each run
+	std::vector<uint> heap;      // runs with entries left, as a heap on their heads
+	bool merging;
+
+	virtual void spill();
+	virtual bool read(uint run);
+	virtual bool after(uint a, uint b) const;
+
+	static bool less(const Entry &a, const Entry &b);
+};
+
+/**
+ * @class BTreeIndex - B+tree implementation of DbIndex, stored in its own HeapFile (<table>-<index>.db).
+ *
+ * Block 1 of the file holds the block id of the root and the height of the tree (1 when the root
+ * is a leaf). Leaves are linked left to right, so lookup() and range() descend once and then walk
+ * the leaves. Keys may repeat unless the index is unique, in which case insert() refuses
+ * duplicates. Entries are removed by del() without rebalancing the tree.
+ *
+ * create() builds the tree bottom-up: it scans the relation once, sorts the entries with a
+ * BTreeSorter, and then fills the leaves left to right to the fill factor, adding each new
+ * node's first key to the level above as it goes.
+ *
+ * A covering index also carries the values of some included columns in its leaf entries. They are
+ * encoded like more key columns, so an entry's bytes are its key followed by them, and entries
+ * sort by key first. Queries touching only the key and included columns are answered by
+ * lookup_rows() from the leaves without reading the relation.
+ */
+class BTreeIndex : public DbIndex {
+public:
+	/**
+	 * Default percentage of each node's block that create() fills.
+	 */
+	static const uint FILL = 90;
+
+	/**
+	 * Default bytes of entries create() sorts in memory before spilling a run to disk.
+	 */
+	static const uint SORT_SZ = 32 * 1024 * 1024;
+
+	/**
+	 * @param relation          the indexed relation
+	 * @param name              name of the index
+	 * @param key_columns       the key columns, in key order
+	 * @param unique            whether keys may repeat
+	 * @param included_columns  other columns whose values the leaf entries carry (none by default)
+	 */
+	BTreeIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique,
+			   ColumnNames included_columns = ColumnNames());
+	virtual ~BTreeIndex();
+	BTreeIndex(const BTreeIndex& other) = delete;
+	BTreeIndex(BTreeIndex&& temp) = delete;
+	BTreeIndex& operator=(const BTreeIndex& other) = delete;
+	BTreeIndex& operator=(BTreeIndex&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual Handles* range(ValueDict* min_key, ValueDict* max_key) const;
+	virtual bool covers(const ColumnNames* column_names) const;
+	virtual Rows* lookup_rows(const ValueDict* where, const ColumnNames* column_names) const;
+
+	/**
+	 * All the rows whose leading key columns have the given values.
+	 * @param key_values  values for the first one or more key columns (later key columns are ignored)
+	 * @returns           their handles, in key order (freed by caller)
+	 */
+	virtual Handles* lookup_prefix(const ValueDict* key_values) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+	virtual std::string report() const;
+
+	/**
+	 * Set how create() builds the tree.
+	 * @param fill       percentage of each node's block to fill (the rest is room for later inserts)
+	 * @param sort_size  bytes of entries to sort in memory before spilling a run to disk
+	 */
+	virtual void set_build(uint fill, uint sort_size = SORT_SZ);
+
+	/**
+	 * Height of the tree (1 if the root is a leaf).
+	 * @returns  number of levels
+	 */
+	virtual uint get_height() const { return height; }
+
+	/**
+	 * Columns carried in the leaf entries besides the key.
+	 * @returns  the included columns (empty unless this is a covering index)
+	 */
+	virtual const ColumnNames& get_included_columns() const { return included_columns; }
+
+protected:
+	static const BlockID STAT = 1;
+
+	mutable HeapFile file;
+	bool closed;
+	BlockID root_id;
+	uint height;
+	KeyProfile key_profile;
+	ColumnNames included_columns;
+	ColumnNames entry_columns;      // key columns, then included columns
+	KeyProfile entry_profile;
+	ColumnOrdinals entry_ordinals;
+	uint fill;
+	uint sort_size;
+	unsigned long n_entries;  // added by the last create()
+	uint n_runs;              // sorted runs create() spilled to disk
+	double build_seconds;
+
+	virtual void read_stat();
+	virtual void save_stat();
+	virtual KeyBytes record_entry(Handle record) const;
+	virtual Handles* scan(const KeyBytes* min_key, const KeyBytes* max_key,
+						  std::vector<KeyBytes>* entries = nullptr) const;
+	virtual BTreeNode* find_leaf(const KeyBytes* key) const;
+	virtual void split(BTreeNode* node, KeyBytes &boundary, BlockID &right_id);
+	virtual void build(BTreeSorter &sorter);
+};
+
+bool test_btree();
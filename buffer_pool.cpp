@@ -0,0 +1,186 @@
+/**
+ * @file buffer_pool.cpp - implementation of:
+ * BufferPool
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <memory.h>
+#include "buffer_pool.h"
+using namespace std;
+
+BufferPool::BufferPool(uint n_frames) : frames(n_frames), slab(nullptr), page_table(), file_writes(), clock_hand(0),
+                                        hits(0), misses(0), evictions(0), writes(0) {
+    if (n_frames == 0)
+        throw BufferPoolError("buffer pool must have at least one frame");
+    this->slab = new char[(size_t) n_frames * DbBlock::BLOCK_SZ];
+    for (uint i = 0; i < n_frames; i++) {
+        BufferFrame &frame = this->frames[i];
+        frame.db = nullptr;
+        frame.block_id = 0;
+        frame.data = this->slab + (size_t) i * DbBlock::BLOCK_SZ;
+        frame.pin_count = 0;
+        frame.dirty = false;
+        frame.referenced = false;
+    }
+    this->page_table.reserve(n_frames);
+}
+
+BufferPool::~BufferPool() {
+    delete[] this->slab;
+}
+
+// Pin the block, reading it in on a miss.
+BufferFrame *BufferPool::pin(Db *db, BlockID block_id) {
+    auto found = this->page_table.find(FrameKey(db, block_id));
+    if (found != this->page_table.end()) {
+        this->hits++;
+        BufferFrame &frame = this->frames[found->second];
+        frame.pin_count++;
+        frame.referenced = true;
+        return &frame;
+    }
+    this->misses++;
+    BufferFrame *frame = claim(db, block_id);
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt data;
+    data.set_data(frame->data);
+    data.set_ulen(DbBlock::BLOCK_SZ);
+    data.set_flags(DB_DBT_USERMEM);
+    if (db->get(nullptr, &key, &data, 0) != 0) {
+        this->page_table.erase(FrameKey(db, block_id));
+        frame->db = nullptr;
+        frame->pin_count = 0;
+        throw BufferPoolError("block " + to_string(block_id) + " does not exist");
+    }
+    return frame;
+}
+
+// Pin a freshly allocated block; nothing to read. A stale frame for it is reused unless someone
+// still has it pinned.
+BufferFrame *BufferPool::pin_new(Db *db, BlockID block_id) {
+    BufferFrame *frame = lookup(db, block_id);
+    if (frame != nullptr) {
+        if (frame->pin_count > 0)
+            throw BufferPoolError("new block " + to_string(block_id) + " is already pinned");
+        frame->pin_count = 1;
+        frame->dirty = false;
+        frame->referenced = true;
+    } else {
+        frame = claim(db, block_id);
+    }
+    memset(frame->data, 0, DbBlock::BLOCK_SZ);
+    return frame;
+}
+
+// Drop one pin. The frame stays resident until CLOCK picks it.
+void BufferPool::unpin(BufferFrame *frame) {
+    if (frame->pin_count > 0)
+        frame->pin_count--;
+}
+
+// Resident frame for the block or nullptr.
+BufferFrame *BufferPool::lookup(Db *db, BlockID block_id) const {
+    auto found = this->page_table.find(FrameKey(db, block_id));
+    if (found == this->page_table.end())
+        return nullptr;
+    return const_cast<BufferFrame *>(&this->frames[found->second]);
+}
+
+// Write back all dirty frames of the given file.
+void BufferPool::flush(Db *db) {
+    for (auto &frame: this->frames)
+        if (frame.db == db && frame.dirty)
+            write_back(frame);
+}
+
+// Release all frames of the given file without writing them. Pinned ones are left with their pins
+// (and so skipped by victim()) but no file.
+void BufferPool::discard(Db *db) {
+    for (auto &frame: this->frames) {
+        if (frame.db == db) {
+            this->page_table.erase(FrameKey(frame.db, frame.block_id));
+            frame.db = nullptr;
+            frame.dirty = false;
+            frame.referenced = false;
+        }
+    }
+    this->file_writes.erase(db);
+}
+
+// Write a block that has no frame, counting it like a write-back.
+void BufferPool::write_through(Db *db, BlockID block_id, Dbt *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    db->put(nullptr, &key, data, 0);
+    this->file_writes[db]++;
+}
+
+// Blocks written to the given file so far.
+unsigned long BufferPool::get_file_writes(Db *db) const {
+    auto found = this->file_writes.find(db);
+    return found == this->file_writes.end() ? 0 : found->second;
+}
+
+// Any pinned frames of the given file?
+bool BufferPool::is_pinned(Db *db) const {
+    for (auto const &frame: this->frames)
+        if (frame.db == db && frame.pin_count > 0)
+            return true;
+    return false;
+}
+
+// Write back every dirty frame.
+void BufferPool::flush_all() {
+    for (auto &frame: this->frames)
+        if (frame.db != nullptr && frame.dirty)
+            write_back(frame);
+}
+
+// CLOCK: sweep past pinned frames, giving referenced frames a second chance.
+// Free frames are taken immediately, once no one holds a pin on them from a discarded file.
+uint BufferPool::victim() {
+    uint n = (uint) this->frames.size();
+    for (uint steps = 0; steps < 2 * n; steps++) {
+        uint i = this->clock_hand;
+        this->clock_hand = (this->clock_hand + 1) % n;
+        BufferFrame &frame = this->frames[i];
+        if (frame.pin_count > 0)
+            continue;
+        if (frame.db == nullptr)
+            return i;
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        return i;
+    }
+    throw BufferPoolError("all " + to_string(n) + " buffer frames are pinned");
+}
+
+void BufferPool::write_back(BufferFrame &frame) {
+    BlockID block_id = frame.block_id;
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt data(frame.data, DbBlock::BLOCK_SZ);
+    frame.db->put(nullptr, &key, &data, 0);
+    frame.dirty = false;
+    this->writes++;
+    this->file_writes[frame.db]++;
+}
+
+// Get a frame for the block (evicting if necessary), register it, and pin it once.
+BufferFrame *BufferPool::claim(Db *db, BlockID block_id) {
+    uint i = victim();
+    BufferFrame &frame = this->frames[i];
+    if (frame.db != nullptr) {
+        if (frame.dirty)
+            write_back(frame);
+        this->page_table.erase(FrameKey(frame.db, frame.block_id));
+        this->evictions++;
+    }
+    frame.db = db;
+    frame.block_id = block_id;
+    frame.pin_count = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    this->page_table[FrameKey(db, block_id)] = i;
+    return &frame;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file buffer_pool.h - Buffer pool manager sitting between DbFile's and Berkeley DB.
+ * BufferFrame
+ * BufferPool
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class BufferPoolError - generic exception class for BufferPool
+ */
+class BufferPoolError : public std::runtime_error {
+public:
+    explicit BufferPoolError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class BufferFrame - one DbBlock::BLOCK_SZ slot of the buffer pool.
+ * A frame is owned by at most one (Berkeley DB file, BlockID) at a time. While pin_count
+ * is non-zero the frame cannot be evicted and its data pointer stays valid.
+ */
+class BufferFrame {
+public:
+    Db *db;              // file the resident block belongs to (nullptr if frame is free)
+    BlockID block_id;    // which block of db is resident
+    char *data;          // DbBlock::BLOCK_SZ bytes of block memory
+    uint pin_count;      // number of outstanding users of this frame
+    bool dirty;          // must be written back before the frame is reused
+    bool referenced;     // CLOCK reference bit
+};
+
+/**
+ * @class BufferPool - fixed array of block frames with pin/unpin, dirty tracking and CLOCK eviction.
+ *
+ * Blocks are read from Berkeley DB on a miss and written back lazily: when a dirty frame
+ * is chosen as a victim, or when its file is flushed (on HeapFile::close or at shutdown).
+ * Repeated access to a resident block is just a hash lookup.
+ */
+class BufferPool {
+public:
+    /**
+     * Number of frames used when none is specified (4MB of blocks).
+     */
+    static const uint DEFAULT_FRAMES = 1024;
+
+    BufferPool(uint n_frames = DEFAULT_FRAMES);
+    virtual ~BufferPool();
+    BufferPool(const BufferPool &other) = delete;
+    BufferPool(BufferPool &&temp) = delete;
+    BufferPool &operator=(const BufferPool &other) = delete;
+    BufferPool &operator=(BufferPool &&temp) = delete;
+
+    /**
+     * Pin the given block into a frame, reading it from db if it isn't resident.
+     * @param db        Berkeley DB file holding the block
+     * @param block_id  which block to pin
+     * @returns         the pinned frame (release with unpin())
+     * @throws          BufferPoolError if the block doesn't exist or every frame is pinned
+     */
+    virtual BufferFrame *pin(Db *db, BlockID block_id);
+
+    /**
+     * Pin a frame for a block which has just been allocated, without reading it from db.
+     * The frame's data is zeroed.
+     * @param db        Berkeley DB file holding the block
+     * @param block_id  which block to pin
+     * @returns         the pinned frame (release with unpin())
+     * @throws          BufferPoolError if the block is resident and pinned, or every frame is pinned
+     */
+    virtual BufferFrame *pin_new(Db *db, BlockID block_id);
+
+    /**
+     * Release one pin on a frame.
+     * @param frame  frame returned from pin() or pin_new()
+     */
+    virtual void unpin(BufferFrame *frame);
+
+    /**
+     * Find the frame holding a block, if it is resident.
+     * @param db        Berkeley DB file holding the block
+     * @param block_id  which block to find
+     * @returns         the frame or nullptr if the block isn't resident (not pinned)
+     */
+    virtual BufferFrame *lookup(Db *db, BlockID block_id) const;
+
+    /**
+     * Write back all the dirty frames belonging to db.
+     * @param db  Berkeley DB file to flush
+     */
+    virtual void flush(Db *db);
+
+    /**
+     * Forget all the frames belonging to db without writing them back, so that none of them can be
+     * found through a later Db at the same address. A pinned frame stays out of use until its last
+     * unpin().
+     * @param db  Berkeley DB file to discard (call flush first to keep changes)
+     */
+    virtual void discard(Db *db);
+
+    /**
+     * Write a block that isn't resident straight through to db.
+     * @param db        Berkeley DB file holding the block
+     * @param block_id  which block to write
+     * @param data      DbBlock::BLOCK_SZ bytes of block
+     */
+    virtual void write_through(Db *db, BlockID block_id, Dbt *data);
+
+    /**
+     * Number of blocks written to db (dirty frames written back or blocks written through) since
+     * it was opened. A copy of a block read from db before this last changed may be stale.
+     * @param db  Berkeley DB file to check
+     * @returns   count of writes so far
+     */
+    virtual unsigned long get_file_writes(Db *db) const;
+
+    /**
+     * Whether any block of db is pinned.
+     * @param db  Berkeley DB file to check
+     * @returns   true if one of its frames has a non-zero pin_count
+     */
+    virtual bool is_pinned(Db *db) const;
+
+    /**
+     * Write back every dirty frame in the pool.
+     */
+    virtual void flush_all();
+
+    // statistics for sizing the pool to the working set
+    virtual uint get_n_frames() const { return (uint) frames.size(); }
+    virtual unsigned long get_hits() const { return hits; }
+    virtual unsigned long get_misses() const { return misses; }
+    virtual unsigned long get_evictions() const { return evictions; }
+    virtual unsigned long get_writes() const { return writes; }
+    virtual void reset_stats() { hits = misses = evictions = writes = 0; }
+
+protected:
+    // page table key: (file, block)
+    typedef std::pair<Db *, BlockID> FrameKey;
+
+    struct FrameKeyHash {
+        size_t operator()(const FrameKey &key) const {
+            return std::hash<void *>()(key.first) ^ (std::hash<BlockID>()(key.second) * 0x9e3779b1U);
+        }
+    };
+
+    std::vector<BufferFrame> frames;
+    char *slab;
+    std::unordered_map<FrameKey, uint, FrameKeyHash> page_table;
+    std::unordered_map<Db *, unsigned long> file_writes;  // per file, for get_file_writes()
+    uint clock_hand;
+    unsigned long hits, misses, evictions, writes;
+
+    virtual uint victim();
+    virtual void write_back(BufferFrame &frame);
+    virtual BufferFrame *claim(Db *db, BlockID block_id);
+};
+
+/**
+ * Global buffer pool used by all HeapFile's.
+ */
+extern BufferPool *_BUFFER_POOL;
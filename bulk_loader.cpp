@@ -0,0 +1,223 @@
+/**
+ * @file bulk_loader.cpp - implementation of:
+ * BulkLoader
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include "bulk_loader.h"
+using namespace std;
+
+BulkLoader::BulkLoader(DbRelation &relation, uint n_threads, uint chunk_size)
+        : relation(relation), column_attributes(relation.get_column_attributes()),
+          n_threads(n_threads == 0 ? 1 : n_threads), chunk_size(chunk_size), rows(0), bytes(0), seconds(0) {
+}
+
+// Read the file a chunk at a time, carrying any partial last line over to the next chunk.
+unsigned long BulkLoader::load(const string &path) {
+    auto start = chrono::steady_clock::now();
+    this->rows = this->bytes = 0;
+    this->seconds = 0;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        throw BulkLoadError("cannot open " + path);
+    char *buffer = new char[this->chunk_size];
+    size_t carry = 0;
+    unsigned long line = 1;
+    try {
+        while (true) {
+            size_t n = carry + fread(buffer + carry, 1, this->chunk_size - carry, file);
+            if (ferror(file))
+                throw BulkLoadError("error reading " + path);
+            bool eof = n < this->chunk_size;
+            if (n == 0)
+                break;
+            size_t cut = n;
+            if (!eof) {
+                while (cut > 0 && buffer[cut - 1] != '\n')
+                    cut--;
+                if (cut == 0)
+                    throw BulkLoadError("line " + to_string(line) + " is longer than "
+                                        + to_string(this->chunk_size) + " bytes");
+            }
+            line += insert(buffer, buffer + cut, line);
+            this->bytes += cut;
+            carry = n - cut;
+            memmove(buffer, buffer + cut, carry);
+            if (eof)
+                break;
+        }
+    } catch (...) {
+        delete[] buffer;
+        fclose(file);
+        this->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        throw;
+    }
+    delete[] buffer;
+    fclose(file);
+    this->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return this->rows;
+}
+
+string BulkLoader::report() const {
+    double mb = (double) this->bytes / (1024 * 1024);
+    ostringstream out;
+    out << "loaded " << this->rows << " rows (" << mb << "MB) in " << this->seconds << "s";
+    if (this->seconds > 0)
+        out << ": " << this->rows / this->seconds << " rows/s, " << mb / this->seconds << " MB/s";
+    return out.str();
+}
+
+// Parse whole lines [begin, end) in parallel and insert them in order. The first line is
+// line number line of the file. Returns the number of lines consumed.
+unsigned long BulkLoader::insert(const char *begin, const char *end, unsigned long line) {
+    uint n_parts = this->n_threads;
+    size_t part_size = (end - begin) / n_parts + 1;
+    vector<Part> parts(n_parts);
+    const char *part_begin = begin;
+    for (uint i = 0; i < n_parts; i++) {
+        const char *part_end = i == n_parts - 1 ? end : min(end, part_begin + part_size);
+        while (part_end < end && part_end[-1] != '\n')
+            part_end++;
+        parts[i].begin = part_begin;
+        parts[i].end = part_end;
+        part_begin = part_end;
+    }
+
+    if (n_parts == 1) {
+        parse(parts[0]);
+    } else {
+        vector<thread> threads;
+        for (uint i = 1; i < n_parts; i++)
+            threads.push_back(thread(&BulkLoader::parse, this, ref(parts[i])));
+        parse(parts[0]);
+        for (auto &t: threads)
+            t.join();
+    }
+
+    // a part's rows are all good even if it stopped at a bad line
+    unsigned long lines = 0;
+    string error;
+    for (auto &part: parts) {
+        if (error.empty() && !part.rows.empty()) {
+            try {
+                delete this->relation.insert_many(&part.rows);
+                this->rows += part.rows.size();
+            } catch (DbRelationError &e) {
+                error = "near line " + to_string(line + lines + part.lines - 1) + ": " + e.what();
+            }
+        }
+        if (error.empty() && !part.error.empty())
+            error = "line " + to_string(line + lines + part.lines - 1) + ": " + part.error;
+        lines += part.lines;
+        for (auto const &row: part.rows)
+            delete row;
+    }
+    if (!error.empty())
+        throw BulkLoadError(error);
+    return lines;
+}
+
+// Parse the lines of one part, stopping at the first bad one. Runs on its own thread.
+void BulkLoader::parse(Part &part) const {
+    part.lines = 0;
+    const char *p = part.begin;
+    while (p < part.end) {
+        const char *eol = (const char *) memchr(p, '\n', part.end - p);
+        if (eol == nullptr)
+            eol = part.end;
+        part.lines++;
+        const char *line_end = eol;
+        if (line_end > p && line_end[-1] == '\r')
+            line_end--;
+        if (line_end > p) {
+            Row *row = new Row();
+            row->reserve(this->column_attributes.size());
+            try {
+                parse_line(p, line_end, *row);
+            } catch (BulkLoadError &e) {
+                delete row;
+                part.error = e.what();
+                return;
+            }
+            part.rows.push_back(row);
+        }
+        p = eol + 1;
+    }
+}
+
+// Split one line into fields and convert each to its column's type.
+void BulkLoader::parse_line(const char *begin, const char *end, Row &row) const {
+    const char *p = begin;
+    string field;
+    for (uint column = 0; column < this->column_attributes.size(); column++) {
+        if (column > 0) {
+            if (p >= end || *p != ',')
+                throw BulkLoadError("expected " + to_string(this->column_attributes.size()) + " fields, got "
+                                    + to_string(column));
+            p++;
+        }
+        field.clear();
+        bool quoted = p < end && *p == '"';
+        if (quoted) {
+            p++;
+            while (true) {
+                if (p >= end)
+                    throw BulkLoadError("unterminated quoted field");
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        field += '"';
+                        p += 2;
+                        continue;
+                    }
+                    p++;
+                    break;
+                }
+                field += *p++;
+            }
+        } else {
+            const char *comma = (const char *) memchr(p, ',', end - p);
+            const char *field_end = comma == nullptr ? end : comma;
+            field.assign(p, field_end - p);
+            p = field_end;
+        }
+
+        Value value;
+        value.data_type = this->column_attributes[column].get_data_type();
+        switch (value.data_type) {
+            case ColumnAttribute::INT: {
+                const char *digits = field.c_str();
+                char *digits_end;
+                errno = 0;
+                long n = strtol(digits, &digits_end, 10);
+                if (field.empty() || *digits_end != '\0' || errno != 0 || n < INT32_MIN || n > INT32_MAX)
+                    throw BulkLoadError("bad INT value '" + field + "' in field " + to_string(column + 1));
+                value.n = (int32_t) n;
+                break;
+            }
+            case ColumnAttribute::TEXT:
+                value.s = field;
+                break;
+            case ColumnAttribute::BOOLEAN:
+                if (field == "true" || field == "TRUE" || field == "1")
+                    value.n = 1;
+                else if (field == "false" || field == "FALSE" || field == "0")
+                    value.n = 0;
+                else
+                    throw BulkLoadError("bad BOOLEAN value '" + field + "' in field " + to_string(column + 1));
+                break;
+            default:
+                throw BulkLoadError("Only know how to load INT, TEXT, and BOOLEAN");
+        }
+        row.push_back(value);
+    }
+    if (p != end)
+        throw BulkLoadError("more than " + to_string(this->column_attributes.size()) + " fields");
+}
@@ -0,0 +1,92 @@
+/**
+ * @file bulk_loader.h - Loading CSV files into relations in bulk.
+ * BulkLoadError
+ * BulkLoader
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <string>
+#include "storage_engine.h"
+
+/**
+ * @class BulkLoadError - generic exception class for BulkLoader
+ */
+class BulkLoadError : public std::runtime_error {
+public:
+    explicit BulkLoadError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class BulkLoader - load the rows of a CSV file into a relation, a large chunk at a time.
+ *
+ * Each line of the file is one row with a field for every column of the relation, in column order.
+ * Fields are separated by commas and may be double-quoted (with "" for a quote inside quotes);
+ * quoted fields can't span lines. BOOLEAN fields are true, false, 1 or 0. Blank lines are skipped.
+ *
+ * The file is read CHUNK_SZ at a time. Each chunk is split at line boundaries into one part per
+ * thread and the parts are parsed in parallel into positional Rows. The parts are then handed to
+ * DbRelation::insert_many() in file order, so the rows end up in the relation in file order and
+ * a HeapTable packs them a block at a time.
+ *
+ * There are no transactions: if a line is bad, the rows before it stay loaded.
+ */
+class BulkLoader {
+public:
+    /**
+     * Bytes of the file read and parsed at a time.
+     */
+    static const uint CHUNK_SZ = 8 * 1024 * 1024;
+
+    /**
+     * @param relation    open (or openable) relation to load into
+     * @param n_threads   number of threads to parse with (0 for one)
+     * @param chunk_size  bytes of the file to read at a time (longest possible line)
+     */
+    BulkLoader(DbRelation &relation, uint n_threads = 1, uint chunk_size = CHUNK_SZ);
+    virtual ~BulkLoader() {}
+    BulkLoader(const BulkLoader &other) = delete;
+    BulkLoader(BulkLoader &&temp) = delete;
+    BulkLoader &operator=(const BulkLoader &other) = delete;
+    BulkLoader &operator=(BulkLoader &&temp) = delete;
+
+    /**
+     * Append all the rows of a CSV file to the relation.
+     * @param path  file to load
+     * @returns     number of rows loaded
+     * @throws      BulkLoadError if the file can't be read or has a bad line
+     */
+    virtual unsigned long load(const std::string &path);
+
+    // statistics for the last load()
+    virtual unsigned long get_rows() const { return rows; }
+    virtual unsigned long get_bytes() const { return bytes; }
+    virtual double get_seconds() const { return seconds; }
+
+    /**
+     * Summary of the last load() with rows/s and MB/s.
+     * @returns  one line of text
+     */
+    virtual std::string report() const;
+
+protected:
+    DbRelation &relation;
+    ColumnAttributes column_attributes;
+    uint n_threads;
+    uint chunk_size;
+    unsigned long rows, bytes;
+    double seconds;
+
+    // what parsing one part of a chunk came up with
+    struct Part {
+        const char *begin, *end;
+        Rows rows;
+        unsigned long lines;  // lines consumed (up to and including a bad one)
+        std::string error;    // empty if all the lines were good
+    };
+
+    virtual void parse(Part &part) const;
+    virtual void parse_line(const char *begin, const char *end, Row &row) const;
+    virtual unsigned long insert(const char *begin, const char *end, unsigned long line);
+};
@@ -0,0 +1,48 @@
+/**
+ * @file file_pool.cpp - implementation of:
+ * FilePool
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include "file_pool.h"
+#include "heap_storage.h"
+using namespace std;
+
+FilePool::FilePool(uint capacity) : capacity(capacity), lru(), opens(0), evictions(0) {
+    if (capacity == 0)
+        throw FilePoolError("file pool must allow at least one open file");
+}
+
+// Put the file at the front and make room for it.
+void FilePool::opened(HeapFile *file) {
+    this->lru.push_front(file);
+    file->lru_entry = this->lru.begin();
+    this->opens++;
+    evict();
+}
+
+// Move the file to the front.
+void FilePool::touch(HeapFile *file) {
+    if (file->lru_entry != this->lru.begin())
+        this->lru.splice(this->lru.begin(), this->lru, file->lru_entry);
+}
+
+// Take the file out of the list.
+void FilePool::closed(HeapFile *file) {
+    this->lru.erase(file->lru_entry);
+    file->lru_entry = this->lru.end();
+}
+
+// Close files from the back of the list, skipping busy ones, until we're within capacity.
+// The front one is the file being opened, so it is never considered.
+void FilePool::evict() {
+    auto it = this->lru.end();
+    while (this->lru.size() > this->capacity && prev(it) != this->lru.begin()) {
+        HeapFile *file = *--it;
+        if (file->is_busy())
+            continue;
+        ++it;  // the victim is erased by close(), but the entry after it stays put
+        file->evict();
+        this->evictions++;
+    }
+}
@@ -0,0 +1,83 @@
+/**
+ * @file file_pool.h - Bounded set of open HeapFile's.
+ * FilePool
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <list>
+#include "storage_engine.h"
+
+class HeapFile;  // forward declare
+
+/**
+ * @class FilePoolError - generic exception class for FilePool
+ */
+class FilePoolError : public std::runtime_error {
+public:
+    explicit FilePoolError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class FilePool - keeps at most so many HeapFile's open, closing the least recently used ones.
+ *
+ * A HeapFile registers here when it opens its Berkeley DB file and reports every use, which moves
+ * it to the front of the LRU list. When a newly opened file puts the pool over capacity, files are
+ * closed from the back of the list, each along with its table's zone map and in-memory indices (see
+ * HeapTable::release()). Closing loses nothing: the file's metadata is written to its free space
+ * map and the others write back their contents, and each is opened again on its next use.
+ * A file that is busy (with blocks pinned in the buffer pool or a scan open) is passed over, so the
+ * pool can go over capacity for as long as everything in it is busy.
+ */
+class FilePool {
+public:
+    /**
+     * Number of open files allowed when none is specified.
+     */
+    static const uint DEFAULT_CAPACITY = 256;
+
+    FilePool(uint capacity = DEFAULT_CAPACITY);
+    virtual ~FilePool() {}
+    FilePool(const FilePool &other) = delete;
+    FilePool(FilePool &&temp) = delete;
+    FilePool &operator=(const FilePool &other) = delete;
+    FilePool &operator=(FilePool &&temp) = delete;
+
+    /**
+     * Register a file that has just been opened, closing cold ones if there are too many.
+     * @param file  the newly opened file
+     */
+    virtual void opened(HeapFile *file);
+
+    /**
+     * Note a use of an open file.
+     * @param file  file registered with opened()
+     */
+    virtual void touch(HeapFile *file);
+
+    /**
+     * Unregister a file that has been closed (by its owner or by the pool).
+     * @param file  file registered with opened()
+     */
+    virtual void closed(HeapFile *file);
+
+    // statistics for sizing the pool
+    virtual uint get_capacity() const { return capacity; }
+    virtual uint get_n_open() const { return (uint) lru.size(); }
+    virtual unsigned long get_opens() const { return opens; }
+    virtual unsigned long get_evictions() const { return evictions; }
+    virtual void reset_stats() { opens = evictions = 0; }
+
+protected:
+    uint capacity;
+    std::list<HeapFile *> lru;  // most recently used first
+    unsigned long opens, evictions;
+
+    virtual void evict();
+};
+
+/**
+ * Global file pool used by all HeapFile's.
+ */
+extern FilePool *_FILE_POOL;
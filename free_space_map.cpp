@@ -0,0 +1,243 @@
+/**
+ * @file free_space_map.cpp - implementation of:
+ * FreeSpaceMap
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <memory.h>
+#include "free_space_map.h"
+using namespace std;
+
+// magic number in the header record ("FSM1")
+static const uint32_t FSM_MAGIC = 0x314d5346;
+
+FreeSpaceMap::FreeSpaceMap(string name) : dbfilename(name + ".fsm.db"), closed(true), db(nullptr),
+                                          buckets(), page_max(), dirty_pages(), trusted(false),
+                                          file_blocks(0), file_rows(0), file_bytes(0) {
+}
+
+// Create the map file. Any stale map left behind under the same name is ignored
+// since we start out covering no blocks.
+void FreeSpaceMap::create() {
+    db_open(DB_CREATE);
+    this->buckets.clear();
+    this->page_max.clear();
+    this->dirty_pages.clear();
+    this->trusted = true;
+    this->file_blocks = 0;
+    this->file_rows = 0;
+    this->file_bytes = 0;
+}
+
+// Remove the map file. Tables created before we had free space maps don't have one.
+void FreeSpaceMap::drop() {
+    this->dirty_pages.clear();
+    close();
+    Db db(_DB_ENV, 0);
+    try {
+        db.remove(this->dbfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // nothing to remove
+    }
+}
+
+// Open the map, making an empty one if there isn't one yet (the owning file will fill it in).
+// Until close(), the header on disk says the map isn't clean.
+void FreeSpaceMap::open() {
+    if (!this->closed)
+        return;
+    try {
+        db_open();
+    } catch (DbException &e) {
+        create();
+        this->trusted = false;  // the file is older than its map
+        return;
+    }
+    read();
+    write_header(false);
+}
+
+// Write out changes and close the map file.
+void FreeSpaceMap::close() {
+    if (this->closed)
+        return;
+    write();
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+    this->closed = true;
+}
+
+// What the header said about the owning file, if it can be believed.
+bool FreeSpaceMap::get_file_stats(uint32_t &n_blocks, uint64_t &n_rows, uint64_t &n_bytes) const {
+    if (!this->trusted)
+        return false;
+    n_blocks = this->file_blocks;
+    n_rows = this->file_rows;
+    n_bytes = this->file_bytes;
+    return true;
+}
+
+// Remember the owning file's sizes for the header.
+void FreeSpaceMap::set_file_stats(uint32_t n_blocks, uint64_t n_rows, uint64_t n_bytes) {
+    this->file_blocks = n_blocks;
+    this->file_rows = n_rows;
+    this->file_bytes = n_bytes;
+}
+
+// Record the free bytes in the given block.
+void FreeSpaceMap::set(BlockID block_id, uint free_bytes) {
+    if (block_id == 0)
+        return;
+    if (block_id > this->buckets.size()) {
+        this->buckets.resize(block_id, 0);
+        uint n_pages = (block_id + BLOCKS_PER_PAGE - 1) / BLOCKS_PER_PAGE;
+        this->page_max.resize(n_pages, 0);
+        this->dirty_pages.resize(n_pages, true);
+    }
+    uint8_t b = bucket(free_bytes);
+    uint page = (block_id - 1) / BLOCKS_PER_PAGE;
+    if (this->buckets[block_id - 1] != b) {
+        this->buckets[block_id - 1] = b;
+        this->dirty_pages[page] = true;
+    }
+    if (b > this->page_max[page])
+        this->page_max[page] = b;
+}
+
+// Forget blocks past n_blocks.
+void FreeSpaceMap::truncate(uint32_t n_blocks) {
+    if (n_blocks >= this->buckets.size())
+        return;
+    this->buckets.resize(n_blocks);
+    uint n_pages = (n_blocks + BLOCKS_PER_PAGE - 1) / BLOCKS_PER_PAGE;
+    this->page_max.resize(n_pages);
+    this->dirty_pages.resize(n_pages);
+    if (n_pages > 0)
+        this->dirty_pages[n_pages - 1] = true;
+}
+
+// First fit, but try the hint first. Map pages whose maximum is too small are skipped;
+// page_max is only an upper bound (set() never lowers it), so it is tightened as we scan.
+BlockID FreeSpaceMap::find(uint size, BlockID hint) {
+    uint need = (size + BUCKET_SZ - 1) / BUCKET_SZ;
+    if (need > UINT8_MAX)
+        return 0;
+    if (hint != 0 && hint <= this->buckets.size() && this->buckets[hint - 1] >= need)
+        return hint;
+    for (uint page = 0; page < this->page_max.size(); page++) {
+        if (this->page_max[page] < need)
+            continue;
+        uint first = page * BLOCKS_PER_PAGE;
+        uint last = min(first + BLOCKS_PER_PAGE, (uint) this->buckets.size());
+        uint8_t max_seen = 0;
+        for (uint i = first; i < last; i++) {
+            if (this->buckets[i] >= need)
+                return i + 1;
+            max_seen = max(max_seen, this->buckets[i]);
+        }
+        this->page_max[page] = max_seen;
+    }
+    return 0;
+}
+
+// Wrapper for Berkeley DB open, with a new handle each time (they can't be reopened).
+void FreeSpaceMap::db_open(uint flags) {
+    this->db = new Db(_DB_ENV, 0);
+    this->db->set_re_len(DbBlock::BLOCK_SZ);
+    try {
+        this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    } catch (DbException &e) {
+        delete this->db;
+        this->db = nullptr;
+        throw;
+    }
+    this->closed = false;
+}
+
+// Load the whole map into memory.
+void FreeSpaceMap::read() {
+    char block[DbBlock::BLOCK_SZ];
+    BlockID record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data;
+    data.set_data(block);
+    data.set_ulen(sizeof(block));
+    data.set_flags(DB_DBT_USERMEM);
+
+    uint32_t n_blocks = 0;
+    this->trusted = false;
+    if (this->db->get(nullptr, &key, &data, 0) == 0 && *(uint32_t *) block == FSM_MAGIC) {
+        uint32_t header[3];  // maps written before the file's sizes were kept have zeros after n_blocks
+        memcpy(header, block, sizeof(header));
+        n_blocks = header[1];
+        char *stats = block + sizeof(header);
+        memcpy(&this->file_blocks, stats, sizeof(this->file_blocks));
+        stats += sizeof(this->file_blocks);
+        memcpy(&this->file_rows, stats, sizeof(this->file_rows));
+        stats += sizeof(this->file_rows);
+        memcpy(&this->file_bytes, stats, sizeof(this->file_bytes));
+        // ... and those written before the bytes were kept have rows but no bytes
+        this->trusted = header[2] != 0 && (this->file_rows == 0 || this->file_bytes != 0);
+    }
+    uint n_pages = (n_blocks + BLOCKS_PER_PAGE - 1) / BLOCKS_PER_PAGE;
+    this->buckets.assign(n_blocks, 0);
+    this->page_max.assign(n_pages, 0);
+    this->dirty_pages.assign(n_pages, false);
+    for (uint page = 0; page < n_pages; page++) {
+        record = page + 2;
+        if (this->db->get(nullptr, &key, &data, 0) != 0) {
+            this->dirty_pages[page] = true;  // lost -- leave as all full and write it back
+            continue;
+        }
+        uint first = page * BLOCKS_PER_PAGE;
+        uint count = min(BLOCKS_PER_PAGE, n_blocks - first);
+        memcpy(&this->buckets[first], block, count);
+        for (uint i = 0; i < count; i++)
+            this->page_max[page] = max(this->page_max[page], (uint8_t) block[i]);
+    }
+}
+
+// Write back any changed map pages and then the header, marked clean.
+void FreeSpaceMap::write() {
+    char block[DbBlock::BLOCK_SZ];
+    BlockID record;
+    Dbt key(&record, sizeof(record));
+    Dbt data(block, sizeof(block));
+    uint32_t n_blocks = (uint32_t) this->buckets.size();
+    for (uint page = 0; page < this->dirty_pages.size(); page++) {
+        if (!this->dirty_pages[page])
+            continue;
+        uint first = page * BLOCKS_PER_PAGE;
+        uint count = min(BLOCKS_PER_PAGE, n_blocks - first);
+        memset(block, 0, sizeof(block));
+        memcpy(block, &this->buckets[first], count);
+        record = page + 2;
+        this->db->put(nullptr, &key, &data, 0);
+        this->dirty_pages[page] = false;
+    }
+    write_header(true);
+}
+
+// Write the header record: magic, blocks covered, clean flag, then the owning file's blocks, rows and bytes.
+void FreeSpaceMap::write_header(bool clean) {
+    char block[DbBlock::BLOCK_SZ];
+    BlockID record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data(block, sizeof(block));
+    uint32_t header[3] = {FSM_MAGIC, (uint32_t) this->buckets.size(), clean ? 1U : 0U};
+    memset(block, 0, sizeof(block));
+    memcpy(block, header, sizeof(header));
+    char *stats = block + sizeof(header);
+    memcpy(stats, &this->file_blocks, sizeof(this->file_blocks));
+    stats += sizeof(this->file_blocks);
+    memcpy(stats, &this->file_rows, sizeof(this->file_rows));
+    stats += sizeof(this->file_rows);
+    memcpy(stats, &this->file_bytes, sizeof(this->file_bytes));
+    this->db->put(nullptr, &key, &data, 0);
+}
+
+// Free bytes to bucket number, rounding down.
+uint8_t FreeSpaceMap::bucket(uint free_bytes) {
+    return (uint8_t) min(free_bytes / BUCKET_SZ, (uint) UINT8_MAX);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file free_space_map.h - Per-file map of free space in each block.
+ * FreeSpaceMap
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class FreeSpaceMap - coarse record of the free bytes in every block of a DbFile.
+ *
+ * Each block gets one byte holding its free space in BUCKET_SZ units (rounded down, so the map
+ * never promises more room than there is). The map is advisory: callers still have to check
+ * the block itself, and report back what they find with set().
+ *
+ * Persisted in its own Berkeley DB RecNo file (<name>.fsm.db) of DbBlock::BLOCK_SZ records:
+ *      Record 1: header -- magic number, number of blocks covered, clean flag, and the owning
+ *                file's number of blocks, of rows, and of bytes in those rows
+ *      Record 2: bucket bytes for blocks 1 to BLOCKS_PER_PAGE
+ *      Record 3: bucket bytes for blocks BLOCKS_PER_PAGE+1 to 2*BLOCKS_PER_PAGE
+ *      etc.
+ * The whole map is held in memory while open and the changed records written on close().
+ * Blocks added since the map was last written are simply not covered by it; the owning
+ * file is expected to set() them after open().
+ *
+ * The header doubles as the owning file's metadata, so the file can be opened without asking
+ * Berkeley DB how many blocks it has. As with ZoneMap, the clean flag is cleared on disk when the
+ * map is opened and set again by close(), and the file's sizes are only reported if it was set.
+ */
+class FreeSpaceMap {
+public:
+    /**
+     * Granularity of the free space buckets in bytes.
+     */
+    static const uint BUCKET_SZ = 16;
+
+    /**
+     * Number of blocks whose buckets fit in one map record.
+     */
+    static const uint BLOCKS_PER_PAGE = DbBlock::BLOCK_SZ;
+
+    FreeSpaceMap(std::string name);
+    virtual ~FreeSpaceMap() { delete db; }
+    FreeSpaceMap(const FreeSpaceMap &other) = delete;
+    FreeSpaceMap(FreeSpaceMap &&temp) = delete;
+    FreeSpaceMap &operator=(const FreeSpaceMap &other) = delete;
+    FreeSpaceMap &operator=(FreeSpaceMap &&temp) = delete;
+
+    /**
+     * Create the map file (covering no blocks).
+     */
+    virtual void create();
+
+    /**
+     * Remove the map file (if there is one).
+     */
+    virtual void drop();
+
+    /**
+     * Open the map file, creating an empty one if it doesn't exist yet.
+     */
+    virtual void open();
+
+    /**
+     * Write out any changes and close the map file.
+     */
+    virtual void close();
+
+    /**
+     * The owning file's sizes, as given to set_file_stats() before the map was last closed.
+     * @param n_blocks  returned by reference: number of blocks in the file
+     * @param n_rows    returned by reference: number of rows in the file
+     * @param n_bytes   returned by reference: total size of those rows
+     * @returns         false (and nothing returned) if the map wasn't closed cleanly last time
+     */
+    virtual bool get_file_stats(uint32_t &n_blocks, uint64_t &n_rows, uint64_t &n_bytes) const;
+
+    /**
+     * Set the owning file's sizes, to be written into the header by close().
+     * @param n_blocks  number of blocks in the file
+     * @param n_rows    number of rows in the file
+     * @param n_bytes   total size of those rows
+     */
+    virtual void set_file_stats(uint32_t n_blocks, uint64_t n_rows, uint64_t n_bytes);
+
+    /**
+     * Number of blocks covered by the map.
+     * @returns  blocks 1 through this have a bucket
+     */
+    virtual uint32_t get_n_blocks() const { return (uint32_t) buckets.size(); }
+
+    /**
+     * Record the free space in a block (extending the map if needed).
+     * @param block_id    which block
+     * @param free_bytes  bytes available for a new record in the block
+     */
+    virtual void set(BlockID block_id, uint free_bytes);
+
+    /**
+     * Forget all blocks after the given one.
+     * @param n_blocks  number of blocks to keep
+     */
+    virtual void truncate(uint32_t n_blocks);
+
+    /**
+     * Find a block that should have room for a new record.
+     * @param size  bytes needed for the new record
+     * @param hint  block to try first (0 for none)
+     * @returns     the lowest-numbered suitable block (after hint), or 0 if none is known
+     */
+    virtual BlockID find(uint size, BlockID hint = 0);
+
+protected:
+    std::string dbfilename;
+    bool closed;
+    Db *db;  // a new one for each open (a Berkeley DB handle can't be reopened)
+    std::vector<uint8_t> buckets;    // buckets[block_id - 1]
+    std::vector<uint8_t> page_max;   // upper bound on the buckets of each map page
+    std::vector<bool> dirty_pages;
+    bool trusted;          // the header was marked clean when read
+    uint32_t file_blocks;
+    uint64_t file_rows;
+    uint64_t file_bytes;
+
+    virtual void db_open(uint flags = 0);
+    virtual void read();
+    virtual void write();
+    virtual void write_header(bool clean);
+    static uint8_t bucket(uint free_bytes);
+};
@@ -0,0 +1,484 @@
+/**
+ * @file hash_index.cpp - implementation of:
+ * HashIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <cstring>
+#include "hash_index.h"
+using namespace std;
+
+// bytes in an entry before the key: hash, block id, record id
+static const uint ENTRY_HEADER_SZ = sizeof(uint32_t) + sizeof(BlockID) + sizeof(RecordID);
+
+// directory block ids that fit in record 2 of the STAT block
+static const uint MAX_DIRECTORY = 1000;
+
+// Next block in the chain (record 1 of a bucket or free block).
+static BlockID chain_link(const SlottedPage *page) {
+    Dbt data;
+    page->view(1, data);
+    BlockID link;
+    memcpy(&link, data.get_data(), sizeof(BlockID));
+    return link;
+}
+
+// Handle held in an entry.
+static Handle entry_handle(const char *entry) {
+    BlockID block_id;
+    RecordID record_id;
+    memcpy(&block_id, entry + sizeof(uint32_t), sizeof(BlockID));
+    memcpy(&record_id, entry + sizeof(uint32_t) + sizeof(BlockID), sizeof(RecordID));
+    return Handle(block_id, record_id);
+}
+
+HashIndex::HashIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), file(relation.get_table_name() + "-" + name), closed(true),
+          level(0), split_next(0), free_list(0), n_bytes(0), buckets(), directory(),
+          key_profile(::key_profile(relation, key_columns)), key_ordinals(relation.get_column_ordinals(&key_columns)) {
+    if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+}
+
+HashIndex::~HashIndex() {
+    if (!this->closed)
+        close();
+}
+
+// Create the index file with INITIAL_BUCKETS empty buckets and add every row of the relation.
+void HashIndex::create() {
+    this->file.create();  // block 1 (STAT) comes with it
+    this->closed = false;
+    this->level = this->split_next = 0;
+    this->free_list = 0;
+    this->n_bytes = 0;
+    this->buckets.clear();
+    this->directory.assign(1, new_block());
+    for (uint i = 0; i < INITIAL_BUCKETS; i++) {
+        this->buckets.push_back(new_block());
+        put_chain(vector<BlockID>(1, this->buckets.back()), vector<string>());
+    }
+    save_directory(0);
+    save_stat();
+
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor)
+            insert(handle);
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+}
+
+void HashIndex::drop() {
+    this->file.drop();
+    this->closed = true;
+}
+
+void HashIndex::open() {
+    if (!this->closed)
+        return;
+    this->file.open();
+    this->closed = false;
+    read_stat();
+}
+
+void HashIndex::close() {
+    this->file.close();
+    this->closed = true;
+}
+
+// All the rows with exactly the given key: one block read unless the bucket has overflowed.
+Handles* HashIndex::lookup(ValueDict* key_values) const {
+    const_cast<HashIndex*>(this)->open();
+    KeyBytes key = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values));
+    return scan(key.data(), (uint) key.size(), hash(key.data(), (uint) key.size()));
+}
+
+// Add an entry to the first block in the record's bucket with room for it, adding an overflow
+// block to the chain if none has. Then split a bucket if the index has grown past FILL.
+void HashIndex::insert(Handle record) {
+    open();
+    char bytes[ENTRY_HEADER_SZ + MAX_KEY_SZ];
+    uint size = marshal_entry(record, bytes);
+    uint32_t h;
+    memcpy(&h, bytes, sizeof(uint32_t));
+    if (this->unique) {
+        Handles* existing = scan(bytes + ENTRY_HEADER_SZ, size - ENTRY_HEADER_SZ, h);
+        bool duplicate = !existing->empty();
+        delete existing;
+        if (duplicate)
+            throw DbRelationError("duplicate key for unique index " + this->name);
+    }
+
+    Dbt entry(bytes, size);
+    BlockID block_id = this->buckets[bucket_of(h)];
+    while (true) {
+        SlottedPage* page = this->file.get(block_id);
+        try {
+            page->add(&entry);
+            this->file.put(page);
+            delete page;
+            break;
+        } catch (DbBlockNoRoomError& e) {
+            // try the next block in the chain
+        }
+        BlockID next = chain_link(page);
+        if (next == 0) {
+            next = new_block();
+            put_chain(vector<BlockID>(1, next), vector<string>(1, string(bytes, size)));
+            Dbt link(&next, sizeof(BlockID));
+            page->put(1, link);
+            this->file.put(page);
+            delete page;
+            break;
+        }
+        delete page;
+        block_id = next;
+    }
+
+    this->n_bytes += size + sizeof(uint32_t);  // plus the record's header in the block
+    if (this->n_bytes * 100 > (uint64_t) this->buckets.size() * DbBlock::BLOCK_SZ * FILL
+            && this->buckets.size() < DIR_SZ * MAX_DIRECTORY)
+        split();
+    save_stat();
+}
+
+// Remove the entry for the record (if there is one). Buckets are never merged.
+void HashIndex::del(Handle record) {
+    open();
+    char bytes[ENTRY_HEADER_SZ + MAX_KEY_SZ];
+    uint size = marshal_entry(record, bytes);
+    uint32_t h;
+    memcpy(&h, bytes, sizeof(uint32_t));
+    for (BlockID block_id = this->buckets[bucket_of(h)]; block_id != 0;) {
+        SlottedPage* page = this->file.get(block_id);
+        Dbt data;
+        for (RecordID record_id = page->next_id(1); record_id != 0; record_id = page->next_id(record_id)) {
+            page->view(record_id, data);
+            if (data.get_size() == size && memcmp(data.get_data(), bytes, size) == 0) {
+                page->del(record_id);
+                this->file.put(page);
+                delete page;
+                this->n_bytes -= size + sizeof(uint32_t);
+                save_stat();
+                return;
+            }
+        }
+        block_id = chain_link(page);
+        delete page;
+    }
+}
+
+// Hashing state from the STAT block, and the bucket directory from the directory blocks.
+void HashIndex::read_stat() {
+    SlottedPage* stat = this->file.get(STAT);
+    Dbt data;
+    if (!stat->view(1, data)) {
+        delete stat;
+        throw DbRelationError("index " + this->name + " has not been built");
+    }
+    const char *bytes = (const char *) data.get_data();
+    uint32_t n;
+    memcpy(&n, bytes, sizeof(uint32_t));
+    this->level = n;
+    memcpy(&n, bytes + sizeof(uint32_t), sizeof(uint32_t));
+    this->split_next = n;
+    memcpy(&this->free_list, bytes + 2 * sizeof(uint32_t), sizeof(BlockID));
+    memcpy(&this->n_bytes, bytes + 2 * sizeof(uint32_t) + sizeof(BlockID), sizeof(uint64_t));
+    stat->view(2, data);
+    this->directory.resize(data.get_size() / sizeof(BlockID));
+    memcpy(this->directory.data(), data.get_data(), data.get_size());
+    delete stat;
+
+    this->buckets.clear();
+    for (auto const& block_id: this->directory) {
+        SlottedPage* page = this->file.get(block_id);
+        page->view(1, data);
+        const BlockID *ids = (const BlockID *) data.get_data();
+        this->buckets.insert(this->buckets.end(), ids, ids + data.get_size() / sizeof(BlockID));
+        delete page;
+    }
+}
+
+void HashIndex::save_stat() {
+    char page_bytes[DbBlock::BLOCK_SZ];
+    Dbt page_data(page_bytes, sizeof(page_bytes));
+    SlottedPage stat(page_data, STAT, true);
+    char bytes[2 * sizeof(uint32_t) + sizeof(BlockID) + sizeof(uint64_t)];
+    uint32_t n = this->level;
+    memcpy(bytes, &n, sizeof(uint32_t));
+    n = this->split_next;
+    memcpy(bytes + sizeof(uint32_t), &n, sizeof(uint32_t));
+    memcpy(bytes + 2 * sizeof(uint32_t), &this->free_list, sizeof(BlockID));
+    memcpy(bytes + 2 * sizeof(uint32_t) + sizeof(BlockID), &this->n_bytes, sizeof(uint64_t));
+    Dbt data(bytes, sizeof(bytes));
+    stat.add(&data);
+    Dbt directory_data(this->directory.data(), (uint32_t) (this->directory.size() * sizeof(BlockID)));
+    stat.add(&directory_data);
+    this->file.put(&stat);
+}
+
+// Write the directory block holding the given bucket's block id.
+void HashIndex::save_directory(uint bucket) {
+    uint first = bucket / DIR_SZ * DIR_SZ;
+    uint n = min((uint) this->buckets.size() - first, DIR_SZ);
+    char page_bytes[DbBlock::BLOCK_SZ];
+    Dbt page_data(page_bytes, sizeof(page_bytes));
+    SlottedPage page(page_data, this->directory[bucket / DIR_SZ], true);
+    Dbt data(&this->buckets[first], n * sizeof(BlockID));
+    page.add(&data);
+    this->file.put(&page);
+}
+
+// Linear hashing: buckets before the split pointer have already been split at this level.
+uint HashIndex::bucket_of(uint32_t hash) const {
+    uint n = INITIAL_BUCKETS << this->level;
+    uint bucket = hash % n;
+    if (bucket < this->split_next)
+        bucket = hash % (2 * n);
+    return bucket;
+}
+
+// Entry for the record: hash of its key, its handle, and its key. Returns the size.
+uint HashIndex::marshal_entry(Handle record, char *bytes) const {
+    KeyBytes key = row_key(this->relation, this->key_profile, this->key_ordinals, record);
+    uint size = (uint) key.size();
+    memcpy(bytes + ENTRY_HEADER_SZ, key.data(), size);
+    uint32_t h = hash(bytes + ENTRY_HEADER_SZ, size);
+    memcpy(bytes, &h, sizeof(uint32_t));
+    memcpy(bytes + sizeof(uint32_t), &record.first, sizeof(BlockID));
+    memcpy(bytes + sizeof(uint32_t) + sizeof(BlockID), &record.second, sizeof(RecordID));
+    return ENTRY_HEADER_SZ + size;
+}
+
+// Block for a bucket's chain, from the free list if there is one on it.
+BlockID HashIndex::new_block() {
+    if (this->free_list != 0) {
+        BlockID block_id = this->free_list;
+        SlottedPage* page = this->file.get(block_id);
+        this->free_list = chain_link(page);
+        delete page;
+        return block_id;
+    }
+    SlottedPage* page = this->file.get_new();
+    BlockID block_id = page->get_block_id();
+    delete page;
+    return block_id;
+}
+
+// Put a block no longer in any chain on the free list.
+void HashIndex::free_block(BlockID block_id) {
+    char page_bytes[DbBlock::BLOCK_SZ];
+    Dbt page_data(page_bytes, sizeof(page_bytes));
+    SlottedPage page(page_data, block_id, true);
+    Dbt link(&this->free_list, sizeof(BlockID));
+    page.add(&link);
+    this->file.put(&page);
+    this->free_list = block_id;
+}
+
+// Handles of the entries with the given encoded key in its bucket.
+Handles* HashIndex::scan(const char *key, uint size, uint32_t hash) const {
+    Handles* handles = new Handles();
+    for (BlockID block_id = this->buckets[bucket_of(hash)]; block_id != 0;) {
+        SlottedPage* page = this->file.get(block_id);
+        Dbt data;
+        for (RecordID record_id = page->next_id(1); record_id != 0; record_id = page->next_id(record_id)) {
+            page->view(record_id, data);
+            const char *entry = (const char *) data.get_data();
+            if (data.get_size() == ENTRY_HEADER_SZ + size && memcmp(entry, &hash, sizeof(uint32_t)) == 0
+                    && memcmp(entry + ENTRY_HEADER_SZ, key, size) == 0)
+                handles->push_back(entry_handle(entry));
+        }
+        block_id = chain_link(page);
+        delete page;
+    }
+    return handles;
+}
+
+// Rewrite a bucket as the given entries, packed into the blocks of chain (and more blocks if
+// they run out). Blocks of chain left over go on the free list.
+void HashIndex::put_chain(const vector<BlockID> &chain, const vector<string> &entries) {
+    uint e = 0;
+    BlockID block_id = chain[0];
+    for (uint c = 0; ; c++) {
+        char page_bytes[DbBlock::BLOCK_SZ];
+        Dbt page_data(page_bytes, sizeof(page_bytes));
+        SlottedPage page(page_data, block_id, true);
+        BlockID link = 0;
+        Dbt link_data(&link, sizeof(BlockID));
+        page.add(&link_data);
+        try {
+            for (; e < entries.size(); e++) {
+                Dbt data((void *) entries[e].data(), (uint32_t) entries[e].size());
+                page.add(&data);
+            }
+        } catch (DbBlockNoRoomError& ex) {
+            link = c + 1 < chain.size() ? chain[c + 1] : new_block();
+            page.put(1, link_data);
+        }
+        this->file.put(&page);
+        if (link == 0) {
+            for (c++; c < chain.size(); c++)
+                free_block(chain[c]);
+            return;
+        }
+        block_id = link;
+    }
+}
+
+// Split the bucket at the split pointer into itself and a new bucket at the end.
+void HashIndex::split() {
+    uint n = INITIAL_BUCKETS << this->level;
+    uint old_bucket = this->split_next;
+    uint new_bucket = (uint) this->buckets.size();  // == old_bucket + n
+    vector<BlockID> chain;
+    vector<string> stay, move;
+    for (BlockID block_id = this->buckets[old_bucket]; block_id != 0;) {
+        chain.push_back(block_id);
+        SlottedPage* page = this->file.get(block_id);
+        Dbt data;
+        for (RecordID record_id = page->next_id(1); record_id != 0; record_id = page->next_id(record_id)) {
+            page->view(record_id, data);
+            uint32_t h;
+            memcpy(&h, data.get_data(), sizeof(uint32_t));
+            string entry((const char *) data.get_data(), data.get_size());
+            if (h % (2 * n) == old_bucket)
+                stay.push_back(entry);
+            else
+                move.push_back(entry);
+        }
+        block_id = chain_link(page);
+        delete page;
+    }
+
+    if (new_bucket % DIR_SZ == 0)
+        this->directory.push_back(new_block());
+    this->buckets.push_back(new_block());
+    put_chain(chain, stay);
+    put_chain(vector<BlockID>(1, this->buckets.back()), move);
+    save_directory(new_bucket);
+    if (++this->split_next == n) {
+        this->level++;
+        this->split_next = 0;
+    }
+}
+
+// FNV-1a
+uint32_t HashIndex::hash(const char *bytes, uint size) {
+    uint32_t h = 2166136261U;
+    for (uint i = 0; i < size; i++) {
+        h ^= (uint8_t) bytes[i];
+        h *= 16777619U;
+    }
+    return h;
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Check that a lookup on the unique index finds exactly the row for a.
+bool test_hash_lookup(DbRelation &table, DbIndex &index, int a) {
+    ValueDict key;
+    key["a"] = Value(a);
+    Handles* handles = index.lookup(&key);
+    bool ok = handles->size() == 1;
+    if (ok) {
+        ColumnNames column_a = {"a"};
+        ValueDict* row = table.project((*handles)[0], &column_a);
+        ok = (*row)["a"] == Value(a);
+        delete row;
+    }
+    delete handles;
+    return ok;
+}
+
+bool test_hash_index() {
+    cout << "test_hash_index: " << endl;
+    const int n = 20000;
+    HeapTable table("_test_hash_cpp", {"a", "b"},
+                    {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)});
+    test_fill_table(table, 0, n);
+
+    HashIndex index_a(table, "fooindex", {"a"}, true);
+    HashIndex index_b(table, "barindex", {"b"}, false);
+    index_a.create();
+    index_b.create();
+    table.attach_index(&index_a);
+    table.attach_index(&index_b);
+    if (index_a.get_n_buckets() <= HashIndex::INITIAL_BUCKETS)
+        return false;
+    cout << "create ok, " << index_a.get_n_buckets() << " buckets" << endl;
+
+    for (int a = 0; a < n; a++)
+        if (!test_hash_lookup(table, index_a, a))
+            return false;
+    ValueDict key;
+    key["a"] = Value(n);
+    Handles* handles = index_a.lookup(&key);
+    bool missing = handles->empty();
+    delete handles;
+    key.clear();
+    key["b"] = Value(string("b42"));
+    handles = index_b.lookup(&key);
+    bool duplicates_ok = handles->size() == n / 100;  // all in one bucket, so over several blocks
+    delete handles;
+    if (!missing || !duplicates_ok)
+        return false;
+    cout << "lookup ok" << endl;
+
+    Row row = {Value(17), Value(string("b17"))};
+    bool rejected = false;
+    try {
+        table.insert(&row);
+    } catch (DbRelationError &e) {
+        rejected = true;
+    }
+    handles = table.select();
+    rejected = rejected && handles->size() == n;
+    delete handles;
+    if (!rejected)
+        return false;
+    cout << "unique ok" << endl;
+
+    key.clear();
+    key["a"] = Value(17);
+    handles = index_a.lookup(&key);
+    table.del((*handles)[0]);
+    delete handles;
+    handles = index_a.lookup(&key);
+    bool deleted = handles->empty();
+    delete handles;
+    if (!deleted)
+        return false;
+    row[0] = Value(n + 17);
+    table.insert(&row);
+    if (!test_hash_lookup(table, index_a, n + 17))
+        return false;
+    cout << "insert/del ok" << endl;
+
+    index_a.close();
+    if (!test_hash_lookup(table, index_a, n + 17) || !test_hash_lookup(table, index_a, n - 1))
+        return false;
+    index_a.close();
+    row[0] = Value(n + 18);
+    table.insert(&row);  // reopened by the insert
+    if (!test_hash_lookup(table, index_a, n + 18))
+        return false;
+    cout << "close/open ok" << endl;
+
+    table.detach_index(&index_a);
+    table.detach_index(&index_b);
+    index_a.drop();
+    index_b.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
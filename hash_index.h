@@ -0,0 +1,99 @@
+/**
+ * @file hash_index.h - linear hashing implementation of DbIndex.
+ * HashIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include "heap_storage.h"
+#include "index_key.h"
+
+/**
+ * @class HashIndex - linear hashing implementation of DbIndex, stored in its own HeapFile
+ * (<table>-<index>.db). Only does equality lookups; range() is not supported.
+ *
+ * Each bucket is a chain of blocks: a primary block and any overflow blocks linked from it.
+ * A bucket block is a SlottedPage:
+ *      Record 1: 4-byte block id of the next block in the chain (0 for the last)
+ *      Record 2: first entry
+ *      etc.
+ * An entry is the key's 4-byte hash, the handle (block id and record id) of the row, and the
+ * encoded key (see encode_key()).
+ *
+ * The file starts with INITIAL_BUCKETS buckets. Whenever the entries average more than FILL of a
+ * block per bucket, the bucket at the split pointer is split in two, so chains stay about one
+ * block long and a lookup reads one block (the directory of bucket blocks is kept in memory).
+ *
+ * Block 1 (STAT) holds the hashing state:
+ *      Record 1: level, split pointer, head of the list of free blocks, bytes of entries
+ *      Record 2: block ids of the directory blocks
+ * and each directory block holds one record of up to DIR_SZ bucket block ids.
+ */
+class HashIndex : public DbIndex {
+public:
+	/**
+	 * Number of buckets in a new index (doubled at each level).
+	 */
+	static const uint INITIAL_BUCKETS = 4;
+
+	/**
+	 * Number of bucket block ids in a directory block.
+	 */
+	static const uint DIR_SZ = 1000;
+
+	/**
+	 * Percentage of a block's bytes the buckets can average before one is split.
+	 */
+	static const uint FILL = 75;
+
+	HashIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique);
+	virtual ~HashIndex();
+	HashIndex(const HashIndex& other) = delete;
+	HashIndex(HashIndex&& temp) = delete;
+	HashIndex& operator=(const HashIndex& other) = delete;
+	HashIndex& operator=(HashIndex&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+
+	/**
+	 * Number of buckets the entries are spread over.
+	 * @returns  number of buckets
+	 */
+	virtual uint get_n_buckets() const { return (uint) buckets.size(); }
+
+protected:
+	static const BlockID STAT = 1;
+
+	mutable HeapFile file;
+	bool closed;
+	uint level;
+	uint split_next;
+	BlockID free_list;
+	uint64_t n_bytes;
+	std::vector<BlockID> buckets;      // primary block of each bucket
+	std::vector<BlockID> directory;    // blocks holding buckets, DIR_SZ at a time
+	KeyProfile key_profile;
+	ColumnOrdinals key_ordinals;
+
+	virtual void read_stat();
+	virtual void save_stat();
+	virtual void save_directory(uint bucket);
+	virtual uint bucket_of(uint32_t hash) const;
+	virtual uint marshal_entry(Handle record, char *bytes) const;
+	virtual BlockID new_block();
+	virtual void free_block(BlockID block_id);
+	virtual Handles* scan(const char *key, uint size, uint32_t hash) const;
+	virtual void put_chain(const std::vector<BlockID> &chain, const std::vector<std::string> &entries);
+	virtual void split();
+
+	static uint32_t hash(const char *bytes, uint size);
+};
+
+bool test_hash_index();
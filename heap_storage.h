@@ -11,6 +11,10 @@
 
 #include "db_cxx.h"
 #include "storage_engine.h"
+#include "buffer_pool.h"
+#include "free_space_map.h"
+#include "file_pool.h"
+#include "zone_map.h"
 
 /**
  * @class SlottedPage - heap file implementation of DbBlock.
@@ -18,21 +22,32 @@
  *      Manage a database block that contains several records.
         Modeled after slotted-page from Database Systems Concepts, 6ed, Figure 10-9.
 
-        Record id are handed out sequentially starting with 1 as records are added with add().
-        Each record has a header which is a fixed offset from the beginning of the block:
+        Record id are handed out sequentially starting with 1 as records are added with add(), except
+        that add() first reuses the ids of deleted records (tombstones), lowest first. A live record
+        keeps its id until it is deleted.
+        The block starts with an 8-byte header, followed by a 4-byte header for each record:
             Bytes 0x00 - Ox01: number of records
             Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x04 - 0x05: number of fragmented free bytes
+            Bytes 0x06 - 0x07: lowest deleted record id (0 if none)
+            Bytes 0x08 - 0x09: size of record 1
+            Bytes 0x0A - 0x0B: offset to record 1
             etc.
+
+        Deleting or shrinking a record doesn't move any other record; the bytes it gave up are
+        counted as fragmented space. The block is only compacted when an add() or put() needs
+        that space to be contiguous.
+
+        A page read through a HeapFile lives in a BufferPool frame; the SlottedPage holds one pin on
+        that frame, released when the SlottedPage is deleted.
  *
  */
 class SlottedPage : public DbBlock {
 public:
-	SlottedPage(Dbt &block, BlockID block_id, bool is_new=false);
+	SlottedPage(Dbt &block, BlockID block_id, bool is_new=false, BufferFrame *frame=nullptr);
 	// Big 5 - we only need the destructor, copy-ctor, move-ctor, and op= are unnecessary
 	// but we delete them explicitly just to make sure we don't use them accidentally
-	virtual ~SlottedPage() {}
+	virtual ~SlottedPage();
 	SlottedPage(const SlottedPage& other) = delete;
 	SlottedPage(SlottedPage&& temp) = delete;
 	SlottedPage& operator=(const SlottedPage& other) = delete;
@@ -44,31 +59,138 @@ public:
 	virtual void del(RecordID record_id);
 	virtual RecordIDs* ids(void) const;
 
+	/**
+	 * Point data at a record in this block, without copying or allocating (unlike get()).
+	 * @param record_id  which record to look at
+	 * @param data       returned by reference: the record's bytes (good while the block is)
+	 * @returns          false if the record has been deleted
+	 */
+	virtual bool view(RecordID record_id, Dbt &data) const;
+
+	/**
+	 * Step through the non-deleted record ids without building a list.
+	 * Reads the block itself, so it sees changes made through other SlottedPage's on the same frame.
+	 * @param after  record id to start after (0 to start at the beginning)
+	 * @returns      the next non-deleted record id, or 0 if there are no more
+	 */
+	virtual RecordID next_id(RecordID after = 0) const;
+
+	/**
+	 * Space available for a new record, including fragmented space add() would compact.
+	 * @returns  number of data bytes add() could store (its header is already accounted for)
+	 */
+	virtual uint16_t free_space() const;
+
 protected:
+	static const uint16_t HEADER_SZ = 8;  // bytes in the block header (before record 1's header)
+
 	uint16_t num_records;
 	uint16_t end_free;
+	uint16_t frag_bytes;
+	RecordID free_slot;  // lowest tombstone, 0 if none
+	BufferFrame *frame;  // pinned buffer pool frame holding this block (nullptr if not pooled)
 
 	virtual void get_header(uint16_t &size, uint16_t &loc, RecordID id=0) const;
 	virtual void put_header(RecordID id=0, uint16_t size=0, uint16_t loc=0);
 	virtual bool has_room(uint16_t size) const;
-	virtual void slide(uint16_t start, uint16_t end);
+	virtual uint16_t contiguous_free(uint16_t new_headers) const;
+	virtual uint16_t new_header_size() const;
+	virtual RecordID next_free_slot(RecordID after) const;
+	virtual void compact();
 	virtual uint16_t get_n(uint16_t offset) const;
 	virtual void put_n(uint16_t offset, uint16_t n);
 	virtual void* address(uint16_t offset) const;
 };
 
+/**
+ * @class TextView - non-owning reference to the bytes of a TEXT field (C++11 has no std::string_view)
+ */
+class TextView {
+public:
+	const char *data;
+	uint16_t size;
+
+	TextView() : data(nullptr), size(0) {}
+	TextView(const char *data, uint16_t size) : data(data), size(size) {}
+	std::string str() const { return std::string(data, size); }
+	bool operator==(const std::string &other) const {
+		return other.size() == size && other.compare(0, size, data, size) == 0;
+	}
+	bool operator!=(const std::string &other) const { return !(*this == other); }
+};
+
+/**
+ * @class RecordView - read-only view of one HeapTable row in place in its block
+ *
+ * Reads INT and BOOLEAN fields directly out of the marshaled bytes and exposes TEXT fields as
+ * TextView's into the block. A Value is only built when asked for with get_value().
+ * The view is only good while the block it was reset() on is.
+ * Columns are referred to by their ordinal position in the table.
+ */
+class RecordView {
+public:
+	RecordView(const ColumnAttributes &column_attributes);
+	virtual ~RecordView() {}
+
+	/**
+	 * Look at a different record (as marshaled by HeapTable).
+	 * @param data  the record's bytes
+	 */
+	virtual void reset(const Dbt &data);
+
+	virtual ColumnAttribute::DataType get_data_type(uint column) const;
+	virtual int32_t get_int(uint column) const;
+	virtual bool get_boolean(uint column) const;
+	virtual TextView get_text(uint column) const;
+
+	/**
+	 * Materialize a field.
+	 * @param column  ordinal of the column
+	 * @returns       the field's value
+	 */
+	virtual Value get_value(uint column) const;
+
+	/**
+	 * Same test as Value::operator==, without materializing the field.
+	 * @param column  ordinal of the column
+	 * @param value   value to compare to (must be of the column's type to match)
+	 * @returns       true if the field equals value
+	 */
+	virtual bool matches(uint column, const Value &value) const;
+
+protected:
+	const ColumnAttributes &column_attributes;
+	const char *bytes;
+	std::vector<uint16_t> offsets;  // offsets[i] is where column i's field starts
+};
+
+class HeapTable;  // forward declare
+
 /**
  * @class HeapFile - heap file implementation of DbFile
  *
  * Heap file organization. Built on top of Berkeley DB RecNo file. There is one of our
-        database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
-        for buffer management and file management.
+        database blocks for each Berkeley DB record in the RecNo file. Berkeley DB does the file management;
+        blocks are cached in the global BufferPool, so get() of a resident block doesn't touch Berkeley DB
+        and put() just marks the frame dirty (it is written back on eviction or close()).
         Uses SlottedPage for storing records within blocks.
+        Keeps a FreeSpaceMap of the blocks, updated on every put(), so that space freed by deletes
+        can be found again by find_room(). The map's header also keeps the number of blocks, of
+        rows, and of bytes in those rows, which spares open() a Berkeley DB stat call after a clean
+        close() and lets the owner report its size without a scan.
+        Open files are kept in the global FilePool, which may close a file that hasn't been used in a
+        while (and with it the other files of its table, see HeapTable::release()); anything that
+        needs the Berkeley DB file calls open() first, which opens it again.
  */
 class HeapFile : public DbFile {
 public:
+	/**
+	 * get_n_rows() when the file wasn't closed cleanly (and nobody has counted since).
+	 */
+	static const uint64_t UNKNOWN_ROWS = UINT64_MAX;
+
 	HeapFile(std::string name);
-	virtual ~HeapFile() {}
+	virtual ~HeapFile();
 	HeapFile(const HeapFile& other) = delete;
 	HeapFile(HeapFile&& temp) = delete;
 	HeapFile& operator=(const HeapFile& other) = delete;
@@ -82,6 +204,7 @@ public:
 	virtual SlottedPage* get(BlockID block_id);
 	virtual void put(DbBlock* block);
 	virtual BlockIDs* block_ids() const;
+	virtual BlockCursor* cursor();
 
 	/**
 	 * Get the id of the current final block in the heap file.
@@ -89,17 +212,152 @@ public:
 	 */
 	virtual uint32_t get_last_block_id() {return last;}
 
+	/**
+	 * Number of rows in the file, as kept up to date by the owner with add_rows().
+	 * @returns  the count, or UNKNOWN_ROWS
+	 */
+	virtual uint64_t get_n_rows() const { return n_rows; }
+
+	/**
+	 * Total size of the rows in the file, as kept up to date with add_rows().
+	 * @returns  bytes of record data (not counting block or record headers); meaningless if
+	 *           get_n_rows() is UNKNOWN_ROWS
+	 */
+	virtual uint64_t get_n_bytes() const { return n_bytes; }
+
+	/**
+	 * Set the number and size of the rows (after counting them).
+	 * @param n_rows   rows in the file
+	 * @param n_bytes  total size of those rows
+	 */
+	virtual void set_n_rows(uint64_t n_rows, uint64_t n_bytes) {
+		this->n_rows = n_rows;
+		this->n_bytes = n_bytes;
+	}
+
+	/**
+	 * Note rows added to or removed from the file's blocks.
+	 * @param n_rows   number added (negative for removed)
+	 * @param n_bytes  their total size (negative for removed)
+	 */
+	virtual void add_rows(int64_t n_rows, int64_t n_bytes) {
+		if (this->n_rows != UNKNOWN_ROWS) {
+			this->n_rows += n_rows;
+			this->n_bytes += n_bytes;
+		}
+	}
+
+	/**
+	 * Find a block which the free space map says has room for a new record.
+	 * The last block is preferred; otherwise the lowest-numbered block with room is chosen.
+	 * @param size  number of bytes in the new record
+	 * @returns     block id of a candidate block, or 0 if there isn't one (use get_new())
+	 */
+	virtual BlockID find_room(uint size);
+
+	/**
+	 * Whether the file can't be closed by the FilePool just now.
+	 * @returns  true if any of its blocks are pinned in the buffer pool or a scan of it is open
+	 */
+	virtual bool is_busy() const;
+
+	/**
+	 * Have the FilePool release the table's other files whenever it closes this one.
+	 * @param table  the table this is the file of
+	 */
+	virtual void set_table(HeapTable* table) { this->table = table; }
+
 protected:
 	std::string dbfilename;
 	uint32_t last;
+	uint64_t n_rows;
+	uint64_t n_bytes;
 	bool closed;
-	Db db;
+	Db* db;  // a new one for each open (a Berkeley DB handle can't be reopened)
+	FreeSpaceMap fsm;
+	uint n_scans;  // HeapFileScan's with a cursor open on db
+	std::list<HeapFile*>::iterator lru_entry;  // where the FilePool has us while we're open
+	HeapTable* table;  // nullptr unless set_table()
 	virtual void db_open(uint flags=0);
+	virtual void evict();
 	virtual uint32_t get_block_count();
+
+	friend class HeapFileScan;
+	friend class FilePool;
+};
+
+/**
+ * @class HeapFileCursor - cursor over the block ids of a HeapFile
+ * Covers the blocks that existed when it was opened.
+ */
+class HeapFileCursor : public BlockCursor {
+public:
+	HeapFileCursor(HeapFile &file) : file(file), block_id(0), last(0) {}
+	virtual ~HeapFileCursor() {}
+
+	virtual void open();
+	virtual bool next(BlockID &block_id);
+	virtual void close() {}
+
+protected:
+	HeapFile &file;
+	BlockID block_id;
+	BlockID last;
+};
+
+/**
+ * @class HeapFileScan - sequential scan of the blocks of a HeapFile using a Berkeley DB cursor
+ * with bulk retrieval (DB_MULTIPLE_KEY), so each library call fetches many blocks into one buffer.
+ *
+ * Blocks that are resident in the buffer pool are taken from there instead (pinned), so changes that
+ * haven't been written back yet are seen. Once a block has been written to the file since the current
+ * batch was fetched, the rest of the batch is read through the buffer pool too, as its copies may be stale. A block returned by next() belongs to the scan and is good
+ * until the following call to next() or close(). Covers the blocks that existed when it was opened.
+ */
+class HeapFileScan : public Cursor<SlottedPage*> {
+public:
+	/**
+	 * Default size of the bulk retrieval buffer.
+	 */
+	static const uint BULK_SZ = 256 * 1024;
+
+	HeapFileScan(HeapFile &file, uint bulk_size=BULK_SZ);
+	virtual ~HeapFileScan();
+	HeapFileScan(const HeapFileScan& other) = delete;
+	HeapFileScan(HeapFileScan&& temp) = delete;
+	HeapFileScan& operator=(const HeapFileScan& other) = delete;
+	HeapFileScan& operator=(HeapFileScan&& temp) = delete;
+
+	virtual void open();
+	virtual bool next(SlottedPage* &block);
+	virtual void close();
+
+	/**
+	 * Skip ahead: the next block returned will be the given one.
+	 * @param block_id  a block of the file after the last one returned
+	 */
+	virtual void seek(BlockID block_id);
+
+protected:
+	HeapFile &file;
+	uint bulk_size;
+	char *buffer;
+	Dbt bulk;
+	Dbc *dbc;
+	DbMultipleRecnoDataIterator *records;  // position within the current bulk buffer
+	SlottedPage *block;                     // last block returned
+	BlockID last;
+	BlockID start;                          // block for the next fetch() to start at, 0 to carry on
+	unsigned long fetched_writes;           // the file's write count when the bulk buffer was filled
+	bool done;
+
+	virtual bool fetch();
 };
 
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ * Keeps its attached indices up to date as rows are inserted and deleted, and a ZoneMap of its
+ * blocks, which lets scans with a where clause skip blocks that can't hold a match.
  */
 
 class HeapTable : public DbRelation {
@@ -119,23 +377,140 @@ public:
 	virtual void close();
 
 	virtual Handle insert(const ValueDict* row);
+	virtual Handle insert(const Row* row);
+	virtual Handles* insert_many(const Rows* rows);
 	virtual void update(const Handle handle, const ValueDict* new_values);
 	virtual void del(const Handle handle);
 
 	virtual Handles* select();
 	virtual Handles* select(const ValueDict* where);
+	virtual HandleCursor* cursor(const ValueDict* where = nullptr);
 	virtual ValueDict* project(Handle handle);
 	virtual ValueDict* project(Handle handle, const ColumnNames* column_names);
+	virtual Row* project(Handle handle, const ColumnOrdinals* column_ordinals);
 	using DbRelation::project;
 
+	/**
+	 * Number of blocks scans with a where clause have skipped because the zone map ruled them out.
+	 * @returns  blocks skipped since the table object was made (or reset_scan_stats())
+	 */
+	virtual unsigned long get_blocks_skipped() const { return blocks_skipped; }
+
+	/**
+	 * Number of blocks scans have read.
+	 * @returns  blocks read since the table object was made (or reset_scan_stats())
+	 */
+	virtual unsigned long get_blocks_scanned() const { return blocks_scanned; }
+
+	virtual void reset_scan_stats() { blocks_skipped = blocks_scanned = 0; }
+
+	/**
+	 * Number of rows in the table.
+	 * @returns  the count kept by the file, or (if it wasn't closed cleanly) what a scan finds
+	 */
+	virtual uint64_t get_n_rows();
+
+	/**
+	 * Total size of the rows in the table, kept the same way as get_n_rows().
+	 * @returns  bytes of record data, not counting block or record headers
+	 */
+	virtual uint64_t get_n_bytes();
+
+	/**
+	 * Number of blocks in the table's file.
+	 * @returns  the file's last block id
+	 */
+	virtual uint32_t get_n_blocks();
+
+	/**
+	 * Close the zone map and the files attached indices keep open outside the FilePool (see
+	 * DbIndex::release()); each is opened again on its next use. Called by the pool when it closes
+	 * the table's file, so that a table it has closed holds no Berkeley DB files open.
+	 */
+	virtual void release();
+
 protected:
 	HeapFile file;
-	virtual ValueDict* validate(const ValueDict* row) const;
-	virtual Handle append(const ValueDict* row);
-	virtual Dbt* marshal(const ValueDict* row) const;
-	virtual ValueDict* unmarshal(Dbt* data) const;
+	ZoneMap zones;
+	unsigned long blocks_skipped;
+	unsigned long blocks_scanned;
+	virtual Row* validate(const ValueDict* row) const;
+	virtual void validate(const Row* row) const;
+	virtual Handle append(const Row* row);
+	virtual RecordID add_record(const Dbt* data, SlottedPage* &block);
+	virtual void add_to_indices(const Handles* handles);
+	virtual void remove(const Handle handle);
+	virtual void count_rows();
+	virtual uint marshal(const Row* row, char* bytes) const;
+	virtual Row* unmarshal(Dbt* data) const;
+	virtual void bind(const ValueDict* where, ColumnOrdinals &columns, Row &values) const;
 	virtual bool selected(Handle handle, const ValueDict* where);
+	virtual bool selected(const RecordView &view, const ColumnOrdinals &columns, const Row &values) const;
+
+	friend class HeapTableCursor;
+};
+
+/**
+ * @class HeapTableCursor - cursor over the handles of the rows of a HeapTable matching a where clause
+ * Reads the blocks with a HeapFileScan and checks the where clause against a RecordView of each
+ * record in place, so memory use doesn't depend on the size of the table and rows that don't
+ * match are never materialized.
+ * No block is read if one of the table's indices says nothing can match (DbIndex::may_match()).
+ * Blocks the table's zone map rules out are skipped, each asked about as the cursor reaches it. With
+ * a where clause the cursor starts out reading the blocks that may match one at a time from the buffer
+ * pool. Once it has asked about SAMPLE blocks, if at least one in SPARSE of them may match, it goes
+ * over to the scan for the rest.
+ * Rows may be deleted through the table while the cursor is open.
+ */
+class HeapTableCursor : public HandleCursor {
+public:
+	/**
+	 * Read the blocks one at a time when fewer than one in this many may match.
+	 */
+	static const uint SPARSE = 8;
+
+	/**
+	 * Blocks to ask the zone map about before going over to the scan.
+	 */
+	static const uint SAMPLE = 64;
+
+	HeapTableCursor(HeapTable &table, const ValueDict* where);
+	virtual ~HeapTableCursor();
+	HeapTableCursor(const HeapTableCursor& other) = delete;
+	HeapTableCursor(HeapTableCursor&& temp) = delete;
+	HeapTableCursor& operator=(const HeapTableCursor& other) = delete;
+	HeapTableCursor& operator=(HeapTableCursor&& temp) = delete;
+
+	virtual void open();
+	virtual bool next(Handle &handle);
+	virtual void close();
+
+protected:
+	HeapTable &table;
+	ColumnOrdinals where_columns;  // where clause, bound to column positions once
+	Row where_values;
+	ValueDict where;               // where clause as given, for the table's indices to rule out
+	HeapFileScan blocks;
+	SlottedPage* block;      // current block (owned by blocks unless sparse), nullptr between blocks
+	RecordID record_id;      // last record id returned from block
+	RecordView view;
+	BlockID next_block_id;   // next block to ask the zone map about when sparse
+	BlockID last;
+	uint probed, matched;    // blocks asked about so far, and how many of them may match
+	bool sparse;
+
+	virtual bool next_block();
+	virtual void release_block();
 };
 
 bool test_heap_storage();
 
+/**
+ * Create and fill the table the index tests build on (columns a INT and b TEXT).
+ * Row a has b = "b" followed by a's last two digits, so b has 100 distinct values.
+ * @param table  table with columns a INT and b TEXT, not yet created
+ * @param from   first value of a
+ * @param to     one past the last value of a
+ */
+void test_fill_table(HeapTable &table, int from, int to);
+
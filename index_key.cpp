@@ -0,0 +1,209 @@
+/**
+ * @file index_key.cpp - implementation of the index search key functions
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <climits>
+#include <iostream>
+#include "index_key.h"
+using namespace std;
+
+// TEXT encoding: 0x00 in the text is ESCAPE ESCAPED; the end of the text is ESCAPE TERMINATOR
+static const char ESCAPE = '\x00';
+static const char ESCAPED = '\xff';
+static const char TERMINATOR = '\x01';
+
+// Look up the type of each key column in the relation.
+KeyProfile key_profile(const DbRelation &relation, const ColumnNames &key_columns) {
+    ColumnOrdinals ordinals = relation.get_column_ordinals(&key_columns);
+    const ColumnAttributes &column_attributes = relation.get_column_attributes();
+    KeyProfile profile;
+    for (auto const &ordinal: ordinals)
+        profile.push_back(column_attributes[ordinal].get_data_type());
+    return profile;
+}
+
+// Pick the key columns out of key_values, checking they are there and of the right kind.
+KeyValue dict_key(const ColumnNames &key_columns, const KeyProfile &key_profile, const ValueDict *key_values) {
+    KeyValue key;
+    for (uint i = 0; i < key_columns.size(); i++) {
+        ValueDict::const_iterator column = key_values->find(key_columns[i]);
+        if (column == key_values->end())
+            throw DbRelationError("no value for index column " + key_columns[i]);
+        if ((column->second.data_type == ColumnAttribute::TEXT) != (key_profile[i] == ColumnAttribute::TEXT))
+            throw DbRelationError("wrong type of value for index column " + key_columns[i]);
+        key.push_back(column->second);
+        key.back().data_type = key_profile[i];
+    }
+    return key;
+}
+
+// Like dict_key(), but a missing or mistyped column just means there's no key.
+bool where_key(const ColumnNames &key_columns, const KeyProfile &key_profile, const ValueDict *where, KeyValue &key) {
+    if (where == nullptr)
+        return false;
+    key.clear();
+    for (uint i = 0; i < key_columns.size(); i++) {
+        ValueDict::const_iterator column = where->find(key_columns[i]);
+        if (column == where->end())
+            return false;
+        if ((column->second.data_type == ColumnAttribute::TEXT) != (key_profile[i] == ColumnAttribute::TEXT))
+            return false;
+        key.push_back(column->second);
+        key.back().data_type = key_profile[i];
+    }
+    return true;
+}
+
+// Project just the key columns and encode them.
+KeyBytes row_key(DbRelation &relation, const KeyProfile &key_profile, const ColumnOrdinals &key_ordinals, Handle handle) {
+    Row* row = relation.project(handle, &key_ordinals);
+    KeyBytes key;
+    try {
+        encode_key(key_profile, *row, key);
+    } catch (DbRelationError &e) {
+        delete row;
+        throw;
+    }
+    delete row;
+    return key;
+}
+
+void encode_key(const KeyProfile &key_profile, const KeyValue &key, KeyBytes &bytes) {
+    size_t start = bytes.size();
+    for (uint i = 0; i < key_profile.size(); i++) {
+        switch (key_profile[i]) {
+            case ColumnAttribute::INT: {
+                uint32_t n = (uint32_t) key[i].n ^ 0x80000000U;  // so negatives come before positives
+                bytes += (char) (n >> 24);
+                bytes += (char) (n >> 16);
+                bytes += (char) (n >> 8);
+                bytes += (char) n;
+                break;
+            }
+            case ColumnAttribute::TEXT:
+                for (auto const &c: key[i].s) {
+                    bytes += c;
+                    if (c == ESCAPE)
+                        bytes += ESCAPED;
+                }
+                bytes += ESCAPE;
+                bytes += TERMINATOR;
+                break;
+            case ColumnAttribute::BOOLEAN:
+                bytes += (char) (key[i].n != 0);
+                break;
+        }
+    }
+    if (bytes.size() - start > MAX_KEY_SZ)
+        throw DbRelationError("index key too big");
+}
+
+KeyBytes encode_key(const KeyProfile &key_profile, const KeyValue &key) {
+    KeyBytes bytes;
+    encode_key(key_profile, key, bytes);
+    return bytes;
+}
+
+KeyValue decode_key(const KeyProfile &key_profile, const char *bytes, uint size) {
+    KeyValue key(key_profile.size());
+    uint offset = 0;
+    for (uint i = 0; i < key_profile.size(); i++) {
+        Value &value = key[i];
+        value.data_type = key_profile[i];
+        switch (value.data_type) {
+            case ColumnAttribute::INT: {
+                const unsigned char *b = (const unsigned char *) bytes + offset;
+                uint32_t n = ((uint32_t) b[0] << 24) | ((uint32_t) b[1] << 16) | ((uint32_t) b[2] << 8) | b[3];
+                value.n = (int32_t) (n ^ 0x80000000U);
+                offset += 4;
+                break;
+            }
+            case ColumnAttribute::TEXT:
+                value.s.clear();
+                while (offset + 1 < size && !(bytes[offset] == ESCAPE && bytes[offset + 1] == TERMINATOR)) {
+                    value.s += bytes[offset];
+                    offset += bytes[offset] == ESCAPE ? 2 : 1;
+                }
+                offset += 2;
+                break;
+            case ColumnAttribute::BOOLEAN:
+                value.n = bytes[offset] != 0;
+                offset += 1;
+                break;
+        }
+        if (offset > size)
+            throw DbRelationError("bad encoded index key");
+    }
+    return key;
+}
+
+// Skip over each column's encoding without decoding it.
+uint key_size(const KeyProfile &key_profile, const char *bytes, uint size) {
+    uint offset = 0;
+    for (auto const &data_type: key_profile) {
+        switch (data_type) {
+            case ColumnAttribute::INT:
+                offset += 4;
+                break;
+            case ColumnAttribute::TEXT:
+                while (offset + 1 < size && !(bytes[offset] == ESCAPE && bytes[offset + 1] == TERMINATOR))
+                    offset += bytes[offset] == ESCAPE ? 2 : 1;
+                offset += 2;
+                break;
+            case ColumnAttribute::BOOLEAN:
+                offset += 1;
+                break;
+        }
+        if (offset > size)
+            throw DbRelationError("bad encoded index key");
+    }
+    return offset;
+}
+
+
+// Check that two keys encode in the same order as a < b and decode back to themselves.
+bool test_key_order(const KeyProfile &key_profile, const KeyValue &a, const KeyValue &b) {
+    KeyBytes bytes_a = encode_key(key_profile, a), bytes_b = encode_key(key_profile, b);
+    if (bytes_a.compare(bytes_b) >= 0)
+        return false;
+    for (auto const *bytes: {&bytes_a, &bytes_b}) {
+        const KeyValue &original = bytes == &bytes_a ? a : b;
+        KeyValue decoded = decode_key(key_profile, bytes->data(), (uint) bytes->size());
+        for (uint i = 0; i < key_profile.size(); i++)
+            if (key_profile[i] == ColumnAttribute::TEXT ? decoded[i].s != original[i].s : decoded[i].n != original[i].n)
+                return false;
+        if (key_size(key_profile, (*bytes + "tail").data(), (uint) bytes->size() + 4) != bytes->size())
+            return false;
+    }
+    return true;
+}
+
+bool test_index_key() {
+    cout << "test_index_key: " << endl;
+    KeyProfile ints = {ColumnAttribute::INT};
+    int32_t ns[] = {INT_MIN, -65536, -256, -1, 0, 1, 255, 256, 65536, INT_MAX};
+    for (uint i = 0; i + 1 < sizeof(ns) / sizeof(ns[0]); i++)
+        if (!test_key_order(ints, {Value(ns[i])}, {Value(ns[i + 1])}))
+            return false;
+    cout << "int ok" << endl;
+
+    KeyProfile texts = {ColumnAttribute::TEXT};
+    string ss[] = {"", string(1, '\0'), string(2, '\0'), string("\0\x01", 2), "\x01", "a", string("a\0", 2),
+                   string("a\0b", 3), "a\x01", "ab", "abc", "b", "\xff", "\xff\xff"};
+    for (uint i = 0; i + 1 < sizeof(ss) / sizeof(ss[0]); i++)
+        if (!test_key_order(texts, {Value(ss[i])}, {Value(ss[i + 1])}))
+            return false;
+    cout << "text ok" << endl;
+
+    // the first column decides unless equal, whatever the lengths of the values
+    KeyProfile composite = {ColumnAttribute::TEXT, ColumnAttribute::INT, ColumnAttribute::BOOLEAN};
+    Value no(0), yes(1);
+    no.data_type = yes.data_type = ColumnAttribute::BOOLEAN;
+    if (!test_key_order(composite, {Value(string("a")), Value(INT_MAX), yes}, {Value(string("ab")), Value(INT_MIN), no})
+        || !test_key_order(composite, {Value(string("ab")), Value(-1), yes}, {Value(string("ab")), Value(0), no})
+        || !test_key_order(composite, {Value(string("ab")), Value(0), no}, {Value(string("ab")), Value(0), yes}))
+        return false;
+    cout << "composite ok" << endl;
+    return true;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file index_key.h - Search keys shared by the index implementations.
+ * KeyProfile
+ * KeyValue
+ * KeyBytes
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+#include "storage_engine.h"
+
+/*
+ * Convenient aliases for types
+ */
+typedef std::vector<ColumnAttribute::DataType> KeyProfile;  // data type of each key column
+typedef std::vector<Value> KeyValue;                        // one value per key column
+typedef std::string KeyBytes;                               // encoded key, see encode_key()
+
+/**
+ * Largest encoded key an index will take (so that a few always fit in a block).
+ */
+const uint MAX_KEY_SZ = DbBlock::BLOCK_SZ / 4;
+
+/**
+ * Data types of an index's key columns.
+ * @param relation     the indexed relation
+ * @param key_columns  the key columns, in key order
+ * @returns            the type of each key column
+ */
+KeyProfile key_profile(const DbRelation &relation, const ColumnNames &key_columns);
+
+/**
+ * Search key from a dictionary holding a value for each key column.
+ * @param key_columns  the index's key columns, in key order
+ * @param key_profile  their data types
+ * @param key_values   column name to value (may have other columns too)
+ * @returns            the key
+ */
+KeyValue dict_key(const ColumnNames &key_columns, const KeyProfile &key_profile, const ValueDict *key_values);
+
+/**
+ * Search key from the column = value conditions of a where clause, if they fix every key column.
+ * @param key_columns  the index's key columns, in key order
+ * @param key_profile  their data types
+ * @param where        column name to value (may have other columns too)
+ * @param key          returned by reference: the key
+ * @returns            false (and no key) if a key column has no condition, or one with a value
+ *                     of the wrong kind, so the where clause can't be answered by key
+ */
+bool where_key(const ColumnNames &key_columns, const KeyProfile &key_profile, const ValueDict *where, KeyValue &key);
+
+/**
+ * Encoded key of a row of the relation.
+ * @param relation      the indexed relation
+ * @param key_profile   data types of the key columns
+ * @param key_ordinals  where the key columns are in the relation, in key order
+ * @param handle        the row
+ * @returns             its key, encoded
+ */
+KeyBytes row_key(DbRelation &relation, const KeyProfile &key_profile, const ColumnOrdinals &key_ordinals, Handle handle);
+
+/**
+ * Encode a key so that encoded keys compare with memcmp (or KeyBytes::compare) in the same order
+ * as their values compare column by column. Each column's encoding is self-delimiting:
+ *      INT:     4 bytes, big-endian with the sign bit flipped
+ *      BOOLEAN: 1 byte, 0 or 1
+ *      TEXT:    the bytes with each 0x00 escaped as 0x00 0xFF, then the terminator 0x00 0x01
+ * so a composite key is just its columns' encodings one after the other.
+ * @param key_profile  data types of the key columns
+ * @param key          the key
+ * @param bytes        the encoded key is appended to this
+ */
+void encode_key(const KeyProfile &key_profile, const KeyValue &key, KeyBytes &bytes);
+
+/**
+ * Encode a key.
+ * @param key_profile  data types of the key columns
+ * @param key          the key
+ * @returns            the encoded key
+ */
+KeyBytes encode_key(const KeyProfile &key_profile, const KeyValue &key);
+
+/**
+ * Decode a key written by encode_key().
+ * @param key_profile  data types of the key columns
+ * @param bytes        the encoded key
+ * @param size         number of bytes in it
+ * @returns            the key
+ */
+KeyValue decode_key(const KeyProfile &key_profile, const char *bytes, uint size);
+
+/**
+ * Length of the encoded key at the start of some bytes (which may carry more after it).
+ * @param key_profile  data types of the key columns
+ * @param bytes        an encoded key, possibly followed by other bytes
+ * @param size         number of bytes in all
+ * @returns            number of bytes the key takes
+ */
+uint key_size(const KeyProfile &key_profile, const char *bytes, uint size);
+
+bool test_index_key();
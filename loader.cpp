@@ -0,0 +1,65 @@
+/**
+ * @file loader.cpp - standalone bulk loader: the same as COPY ... FROM in sql5300, without the shell
+ * Run as: loader dbenvpath table_name file.csv [threads]
+ * The table must already exist. Parses with one thread per core unless told otherwise.
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "db_cxx.h"
+#include "bulk_loader.h"
+#include "schema_tables.h"
+using namespace std;
+
+DbEnv *_DB_ENV;
+BufferPool *_BUFFER_POOL;
+FilePool *_FILE_POOL;
+
+int main(int argc, char *argv[]) {
+    if (argc != 4 && argc != 5) {
+        cerr << "Usage: loader dbenvpath table_name file.csv [threads]" << endl;
+        return 1;
+    }
+    uint n_threads = argc == 5 ? (uint) atoi(argv[4]) : thread::hardware_concurrency();
+
+    DbEnv *env = new DbEnv(0U);
+    env->set_message_stream(&cout);
+    env->set_error_stream(&cerr);
+    try {
+        env->open(argv[1], DB_CREATE | DB_INIT_MPOOL, 0);
+    } catch (DbException &exc) {
+        cerr << "(loader: " << exc.what() << ")" << endl;
+        return 1;
+    }
+    _DB_ENV = env;
+    _BUFFER_POOL = new BufferPool();
+    _FILE_POOL = new FilePool();
+    initialize_schema_tables();
+
+    Identifier table_name = argv[2];
+    Tables tables;
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    tables.get_columns(table_name, column_names, column_attributes);
+    if (column_names.empty() || table_name[0] == '_') {
+        cerr << "loader: no table " << table_name << endl;
+        return 1;
+    }
+
+    DbRelation &table = tables.get_table(table_name);
+    BulkLoader loader(table, n_threads);
+    int status = EXIT_SUCCESS;
+    try {
+        loader.load(argv[3]);
+    } catch (BulkLoadError &e) {
+        cerr << "loader: " << e.what() << endl;
+        status = EXIT_FAILURE;
+    }
+    Tables::close_all();  // the table, its indices, and the schema tables, so their metadata is trusted next time
+    _BUFFER_POOL->flush_all();
+    cout << table_name << ": " << loader.report() << endl;
+    return status;
+}
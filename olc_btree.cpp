@@ -0,0 +1,598 @@
+/**
+ * @file olc_btree.cpp - implementation of:
+ * OLCBTreeIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <algorithm>
+#include <thread>
+#include "olc_btree.h"
+using namespace std;
+
+// key of unused entry slots, and less than any encoded key (so it also starts a scan from the left)
+static const KeyBytes NO_KEY;
+
+// bit of a version set while a writer holds the node
+static const uint64_t LOCKED = 2;
+
+OLCBTreeIndex::Leaf::Leaf() : Node(true), next(nullptr) {
+    for (auto &entry: this->entries)
+        entry = {&NO_KEY, Handle(0, 0)};
+}
+
+OLCBTreeIndex::Inner::Inner() : Node(false) {
+    for (auto &separator: this->separators)
+        separator = {&NO_KEY, Handle(0, 0)};
+    for (auto &child: this->children)
+        child = nullptr;
+}
+
+OLCBTreeIndex::OLCBTreeIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), closed(true), root(nullptr),
+          key_profile(::key_profile(relation, key_columns)), key_ordinals(relation.get_column_ordinals(&key_columns)),
+          retired_mutex(), retired(), restarts(0), n_entries(0) {
+    if (key_columns.empty() || key_columns.size() > DbIndex::MAX_COMPOSITE)
+        throw DbRelationError("bad number of columns for index " + name);
+}
+
+OLCBTreeIndex::~OLCBTreeIndex() {
+    close();
+}
+
+// Nothing is kept on disk, so creating is just building the tree.
+void OLCBTreeIndex::create() {
+    open();
+}
+
+void OLCBTreeIndex::drop() {
+    close();
+}
+
+// Build the tree from the relation.
+void OLCBTreeIndex::open() {
+    if (!this->closed)
+        return;
+    this->root.store(new Leaf());
+    this->closed = false;
+    this->restarts = 0;
+    this->n_entries = 0;
+    try {
+        build();
+    } catch (DbRelationError &e) {
+        close();
+        throw;
+    }
+}
+
+// Free the nodes and keys (no other thread may be using the index).
+void OLCBTreeIndex::close() {
+    if (this->closed)
+        return;
+    free_nodes(this->root.load());
+    this->root.store(nullptr);
+    for (auto const &key: this->retired)
+        delete key;
+    this->retired.clear();
+    this->closed = true;
+}
+
+// All the rows with exactly the given key.
+Handles* OLCBTreeIndex::lookup(ValueDict* key_values) const {
+    const_cast<OLCBTreeIndex*>(this)->open();
+    return lookup_key(encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, key_values)));
+}
+
+// All the rows with keys from min_key to max_key (either can be nullptr for no limit), in key order.
+Handles* OLCBTreeIndex::range(ValueDict* min_key, ValueDict* max_key) const {
+    const_cast<OLCBTreeIndex*>(this)->open();
+    KeyBytes min_value, max_value;
+    if (min_key != nullptr)
+        min_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, min_key));
+    if (max_key != nullptr)
+        max_value = encode_key(this->key_profile, dict_key(this->key_columns, this->key_profile, max_key));
+    return range_keys(min_key == nullptr ? nullptr : &min_value, max_key == nullptr ? nullptr : &max_value);
+}
+
+void OLCBTreeIndex::insert(Handle record) {
+    open();
+    if (!insert_key(row_key(this->relation, this->key_profile, this->key_ordinals, record), record))
+        throw DbRelationError("duplicate key for unique index " + this->name);
+}
+
+// Called while the row is still there, so its key can be read.
+void OLCBTreeIndex::del(Handle record) {
+    open();
+    remove_key(row_key(this->relation, this->key_profile, this->key_ordinals, record), record);
+}
+
+std::string OLCBTreeIndex::report() const {
+    return to_string(get_n_entries()) + " entries, height " + to_string(get_height()) + " (in memory), "
+           + to_string(get_restarts()) + " restarts";
+}
+
+// Descend from the root, splitting any full node on the way (and then starting again), and add the
+// entry to its leaf with only the leaf latched.
+bool OLCBTreeIndex::insert_key(const KeyBytes &key, Handle handle) {
+    const KeyBytes *owned = new KeyBytes(key);
+    while (true) {
+        bool restart = false;
+        Node *node = this->root.load();
+        uint64_t version = read_lock(node, restart);
+        if (node != this->root.load())
+            restart = true;
+        Inner *parent = nullptr;
+        uint64_t parent_version = 0;
+        while (!restart && !node->leaf) {
+            Inner *inner = (Inner *) node;
+            if (inner->count == FANOUT) {
+                split(inner, version, parent, parent_version);
+                restart = true;
+                break;
+            }
+            Node *child = inner->children[child_position(inner, key, handle)];
+            if (child == nullptr) {
+                restart = true;
+                break;
+            }
+            uint64_t child_version = read_lock(child, restart);
+            check(inner, version, restart);  // the child is still the one for the key
+            parent = inner;
+            parent_version = version;
+            node = child;
+            version = child_version;
+        }
+        if (!restart) {
+            Leaf *leaf = (Leaf *) node;
+            if (leaf->count == FANOUT) {
+                split(leaf, version, parent, parent_version);
+                restart = true;
+            } else {
+                upgrade(leaf, version, restart);
+            }
+            if (!restart) {
+                uint position = lower_bound(leaf, key, handle);
+                if (position < leaf->count && compare(leaf->entries[position], key, handle) == 0) {
+                    write_unlock(leaf);
+                    delete owned;
+                    return false;
+                }
+                copy_backward(leaf->entries + position, leaf->entries + leaf->count, leaf->entries + leaf->count + 1);
+                leaf->entries[position] = {owned, handle};
+                leaf->count++;
+                write_unlock(leaf);
+                this->n_entries++;
+                return true;
+            }
+        }
+        this->restarts++;
+    }
+}
+
+// Find the leaf optimistically and latch only it. The key's bytes may still be being read by
+// another thread, so they are set aside until close().
+bool OLCBTreeIndex::remove_key(const KeyBytes &key, Handle handle) {
+    while (true) {
+        bool restart = false;
+        uint64_t version;
+        Leaf *leaf = const_cast<Leaf *>(find_leaf(key, handle, version));
+        upgrade(leaf, version, restart);
+        if (restart) {
+            this->restarts++;
+            continue;
+        }
+        uint position = lower_bound(leaf, key, handle);
+        bool found = position < leaf->count && compare(leaf->entries[position], key, handle) == 0
+                     && leaf->entries[position].handle == handle;
+        const KeyBytes *removed = nullptr;
+        if (found) {
+            removed = leaf->entries[position].key;
+            copy(leaf->entries + position + 1, leaf->entries + leaf->count, leaf->entries + position);
+            leaf->count--;
+            this->n_entries--;
+        }
+        write_unlock(leaf);
+        if (removed != nullptr) {
+            lock_guard<mutex> guard(this->retired_mutex);
+            this->retired.push_back(removed);
+        }
+        return found;
+    }
+}
+
+Handles* OLCBTreeIndex::lookup_key(const KeyBytes &key) const {
+    Handles *handles = new Handles();
+    collect(&key, &key, handles);
+    return handles;
+}
+
+Handles* OLCBTreeIndex::range_keys(const KeyBytes *min, const KeyBytes *max) const {
+    Handles *handles = new Handles();
+    collect(min, max, handles);
+    return handles;
+}
+
+// Follow the first children down to a leaf.
+uint OLCBTreeIndex::get_height() const {
+    const Node *node = this->root.load();
+    if (node == nullptr)
+        return 0;
+    uint height = 1;
+    for (; !node->leaf; height++)
+        node = ((const Inner *) node)->children[0];
+    return height;
+}
+
+void OLCBTreeIndex::build() {
+    HandleCursor* cursor = this->relation.cursor();
+    try {
+        for (auto const& handle: *cursor)
+            if (!insert_key(row_key(this->relation, this->key_profile, this->key_ordinals, handle), handle))
+                throw DbRelationError("duplicate key for unique index " + this->name);
+    } catch (DbRelationError& e) {
+        delete cursor;
+        throw;
+    }
+    delete cursor;
+}
+
+// Order of an entry against (key, handle): by key bytes, then by handle unless the index is unique.
+int OLCBTreeIndex::compare(const Entry &entry, const KeyBytes &key, Handle handle) const {
+    int c = entry.key->compare(key);
+    if (c != 0 || this->unique)
+        return c;
+    return entry.handle < handle ? -1 : (handle < entry.handle ? 1 : 0);
+}
+
+// First entry in the leaf not before (key, handle). The count may be mid-change, so it is capped.
+uint OLCBTreeIndex::lower_bound(const Leaf *leaf, const KeyBytes &key, Handle handle) const {
+    uint low = 0, high = min((uint) leaf->count, FANOUT);
+    while (low < high) {
+        uint middle = (low + high) / 2;
+        if (compare(leaf->entries[middle], key, handle) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Child whose subtree holds (key, handle): the one after the last separator not after it.
+uint OLCBTreeIndex::child_position(const Inner *inner, const KeyBytes &key, Handle handle) const {
+    uint low = 0, high = min((uint) inner->count, FANOUT);
+    while (low < high) {
+        uint middle = (low + high) / 2;
+        if (compare(inner->separators[middle], key, handle) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Descend to the leaf for (key, handle) without latching anything. Returns the leaf and the version
+// it had when its parent was last seen unchanged; the caller checks or upgrades that version.
+const OLCBTreeIndex::Leaf* OLCBTreeIndex::find_leaf(const KeyBytes &key, Handle handle, uint64_t &version) const {
+    while (true) {
+        bool restart = false;
+        const Node *node = this->root.load();
+        version = read_lock(node, restart);
+        if (node != this->root.load())
+            restart = true;
+        while (!restart && !node->leaf) {
+            const Inner *inner = (const Inner *) node;
+            const Node *child = inner->children[child_position(inner, key, handle)];
+            if (child == nullptr) {
+                restart = true;
+                break;
+            }
+            uint64_t child_version = read_lock(child, restart);
+            check(inner, version, restart);
+            node = child;
+            version = child_version;
+        }
+        if (!restart)
+            return (const Leaf *) node;
+        this->restarts++;
+    }
+}
+
+// Walk the leaves from min to max, coupling each to the next: the next leaf's version is noted
+// before the current one is checked. Any failed check starts the whole scan again.
+void OLCBTreeIndex::collect(const KeyBytes *min, const KeyBytes *max, Handles *handles) const {
+    const KeyBytes &from = min == nullptr ? NO_KEY : *min;
+    while (true) {
+        bool restart = false;
+        handles->clear();
+        uint64_t version;
+        const Leaf *leaf = find_leaf(from, Handle(0, 0), version);
+        uint position = lower_bound(leaf, from, Handle(0, 0));
+        while (true) {
+            uint count = std::min((uint) leaf->count, FANOUT);
+            bool done = false;
+            for (; position < count; position++) {
+                const Entry &entry = leaf->entries[position];
+                if (max != nullptr && entry.key->compare(*max) > 0) {
+                    done = true;
+                    break;
+                }
+                handles->push_back(entry.handle);
+            }
+            const Leaf *next = leaf->next;
+            if (done || next == nullptr) {
+                check(leaf, version, restart);
+                break;
+            }
+            uint64_t next_version = read_lock(next, restart);
+            check(leaf, version, restart);
+            if (restart)
+                break;
+            leaf = next;
+            version = next_version;
+            position = 0;
+        }
+        if (!restart)
+            return;
+        this->restarts++;
+    }
+}
+
+// Split a full node in two, latching it and its parent (or, for the root, checking it still is
+// the root once latched). Does nothing if either changed since the caller saw them; the caller
+// starts again from the root either way.
+void OLCBTreeIndex::split(Node *node, uint64_t version, Inner *parent, uint64_t parent_version) {
+    bool restart = false;
+    if (parent != nullptr) {
+        upgrade(parent, parent_version, restart);
+        if (restart)
+            return;
+    }
+    upgrade(node, version, restart);
+    if (restart) {
+        if (parent != nullptr)
+            write_unlock(parent);
+        return;
+    }
+    if (parent == nullptr && node != this->root.load()) {
+        write_unlock(node);
+        return;
+    }
+
+    Entry separator;
+    Node *right;
+    if (node->leaf) {
+        Leaf *leaf = (Leaf *) node;
+        Leaf *sibling = new Leaf();
+        uint half = leaf->count / 2;
+        copy(leaf->entries + half, leaf->entries + leaf->count, sibling->entries);
+        sibling->count = (uint16_t) (leaf->count - half);
+        sibling->next = leaf->next;
+        separator = sibling->entries[0];
+        leaf->next = sibling;
+        leaf->count = (uint16_t) half;
+        right = sibling;
+    } else {
+        Inner *inner = (Inner *) node;
+        Inner *sibling = new Inner();
+        uint half = inner->count / 2;
+        separator = inner->separators[half];
+        copy(inner->separators + half + 1, inner->separators + inner->count, sibling->separators);
+        copy(inner->children + half + 1, inner->children + inner->count + 1, sibling->children);
+        sibling->count = (uint16_t) (inner->count - half - 1);
+        inner->count = (uint16_t) half;
+        right = sibling;
+    }
+
+    if (parent != nullptr) {
+        uint position = child_position(parent, *separator.key, separator.handle);
+        copy_backward(parent->separators + position, parent->separators + parent->count,
+                      parent->separators + parent->count + 1);
+        copy_backward(parent->children + position + 1, parent->children + parent->count + 1,
+                      parent->children + parent->count + 2);
+        parent->separators[position] = separator;
+        parent->children[position + 1] = right;
+        parent->count++;
+    } else {
+        Inner *top = new Inner();
+        top->separators[0] = separator;
+        top->children[0] = node;
+        top->children[1] = right;
+        top->count = 1;
+        this->root.store(top);
+    }
+    write_unlock(node);
+    if (parent != nullptr)
+        write_unlock(parent);
+}
+
+// Note a node's version, restarting if a writer holds it.
+uint64_t OLCBTreeIndex::read_lock(const Node *node, bool &restart) {
+    uint64_t version = node->version.load();
+    if ((version & LOCKED) != 0)
+        restart = true;
+    return version;
+}
+
+// Restart if the node has changed since its version was noted.
+void OLCBTreeIndex::check(const Node *node, uint64_t version, bool &restart) {
+    if (node->version.load() != version)
+        restart = true;
+}
+
+// Latch the node if it is still at the noted version; otherwise restart.
+void OLCBTreeIndex::upgrade(Node *node, uint64_t version, bool &restart) {
+    if (!node->version.compare_exchange_strong(version, version + LOCKED))
+        restart = true;
+}
+
+// Let go of the node, leaving it at a new version.
+void OLCBTreeIndex::write_unlock(Node *node) {
+    node->version.fetch_add(LOCKED);
+}
+
+// Free a subtree and the keys in its leaves (separators share their keys with leaf entries or the
+// retired keys).
+void OLCBTreeIndex::free_nodes(Node *node) {
+    if (node->leaf) {
+        Leaf *leaf = (Leaf *) node;
+        for (uint i = 0; i < leaf->count; i++)
+            delete leaf->entries[i].key;
+        delete leaf;
+    } else {
+        Inner *inner = (Inner *) node;
+        for (uint i = 0; i <= inner->count; i++)
+            free_nodes(inner->children[i]);
+        delete inner;
+    }
+}
+
+
+/*
+ * *******************
+ * Tests
+ * *******************
+ */
+
+// Encoded TEXT key.
+static KeyBytes test_olc_key(const string &s) {
+    return encode_key({ColumnAttribute::TEXT}, {Value(s)});
+}
+
+// Writers add keys while readers keep looking up keys that are already there, then half the new
+// keys are removed the same way. Every lookup must see exactly the rows that it should.
+bool test_olc_threads(OLCBTreeIndex &index, const KeyBytes &stable_key, uint stable_rows) {
+    const uint n_writers = 4, n_readers = 2, n = 20000;
+    atomic<bool> ok(true), writing(true);
+    vector<thread> readers;
+    for (uint r = 0; r < n_readers; r++)
+        readers.push_back(thread([&]() {
+            while (writing.load()) {
+                Handles *handles = index.lookup_key(stable_key);
+                if (handles->size() != stable_rows || !is_sorted(handles->begin(), handles->end()))
+                    ok = false;
+                delete handles;
+            }
+        }));
+    vector<thread> writers;
+    for (uint w = 0; w < n_writers; w++)
+        writers.push_back(thread([&, w]() {
+            for (uint i = 0; i < n; i++)
+                if (!index.insert_key(test_olc_key("w" + to_string(w) + "-" + to_string(i)), Handle(1000 + w, i)))
+                    ok = false;
+        }));
+    for (auto &writer: writers)
+        writer.join();
+    writers.clear();
+    for (uint w = 0; w < n_writers; w++)
+        writers.push_back(thread([&, w]() {
+            for (uint i = 0; i < n; i += 2)
+                if (!index.remove_key(test_olc_key("w" + to_string(w) + "-" + to_string(i)), Handle(1000 + w, i)))
+                    ok = false;
+        }));
+    for (auto &writer: writers)
+        writer.join();
+    writing = false;
+    for (auto &reader: readers)
+        reader.join();
+    if (!ok)
+        return false;
+
+    for (uint w = 0; w < n_writers; w++)
+        for (uint i = 0; i < n; i++) {
+            Handles *handles = index.lookup_key(test_olc_key("w" + to_string(w) + "-" + to_string(i)));
+            bool found = i % 2 == 0 ? handles->empty() : handles->size() == 1 && handles->at(0) == Handle(1000 + w, i);
+            delete handles;
+            if (!found)
+                return false;
+        }
+    return true;
+}
+
+bool test_olc_btree() {
+    cout << "test_olc_btree: " << endl;
+    ColumnNames column_names = {"a", "b"};
+    const int n = 3000;
+    HeapTable table("_test_olc_cpp", column_names,
+                    {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)});
+    test_fill_table(table, 0, n);
+
+    OLCBTreeIndex index_a(table, "olc_a", {"a"}, true);
+    OLCBTreeIndex index_b(table, "olc_b", {"b"}, false);
+    index_a.create();
+    index_b.create();
+    table.attach_index(&index_a);
+    table.attach_index(&index_b);
+    if (index_a.get_n_entries() != n || index_a.get_height() < 2)
+        return false;
+    ValueDict key;
+    for (int a = 0; a < n; a++) {
+        key["a"] = Value(a);
+        Handles* handles = index_a.lookup(&key);
+        bool found = handles->size() == 1;
+        if (found) {
+            ValueDict* values = table.project(handles->at(0), &column_names);
+            found = (*values)["a"] == Value(a);
+            delete values;
+        }
+        delete handles;
+        if (!found)
+            return false;
+    }
+    key.clear();
+    key["b"] = Value("b17");
+    Handles* handles = index_b.lookup(&key);
+    bool found = handles->size() == n / 100;
+    delete handles;
+    if (!found)
+        return false;
+    cout << "lookup ok" << endl;
+
+    ValueDict min_key, max_key;
+    min_key["a"] = Value(100);
+    max_key["a"] = Value(199);
+    handles = index_a.range(&min_key, &max_key);
+    bool range_ok = handles->size() == 100;
+    for (uint i = 0; range_ok && i < handles->size(); i++) {
+        ValueDict* values = table.project(handles->at(i), &column_names);
+        range_ok = (*values)["a"] == Value(100 + (int) i);
+        delete values;
+    }
+    delete handles;
+    handles = index_a.range(nullptr, &min_key);
+    range_ok = range_ok && handles->size() == 101;
+    delete handles;
+    if (!range_ok)
+        return false;
+    cout << "range ok" << endl;
+
+    Row row = {Value(17), Value(string("dup"))};
+    bool duplicate = false;
+    try {
+        table.insert(&row);
+    } catch (DbRelationError &e) {
+        duplicate = true;
+    }
+    key.clear();
+    key["a"] = Value(17);
+    handles = table.select(&key);
+    for (auto const& handle: *handles)
+        table.del(handle);
+    delete handles;
+    handles = index_a.lookup(&key);
+    bool deleted = handles->empty() && index_a.get_n_entries() == n - 1;
+    delete handles;
+    if (!duplicate || !deleted)
+        return false;
+    cout << "insert/delete ok" << endl;
+
+    table.detach_index(&index_a);
+    table.detach_index(&index_b);
+    if (!test_olc_threads(index_b, test_olc_key("b42"), n / 100))
+        return false;
+    cout << "threads ok, " << index_b.get_restarts() << " restarts" << endl;
+
+    index_a.drop();
+    index_b.drop();
+    table.drop();
+    cout << "drop ok" << endl;
+    return true;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file olc_btree.h - in-memory B+tree implementation of DbIndex with optimistic lock coupling.
+ * OLCBTreeIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "heap_storage.h"
+#include "index_key.h"
+
+/**
+ * @class OLCBTreeIndex - B+tree index held in memory whose key-level operations (insert_key(),
+ * remove_key(), lookup_key(), range_keys()) can be called from many threads at once (index type OLC).
+ *
+ * Each node has a version latch: a counter whose bit 1 is set while a writer holds the node, and
+ * which goes up each time a writer lets go of it. Readers never write to shared memory: they note a
+ * node's version, read it, and check the version is unchanged before trusting what they read (or
+ * going on to a child), restarting from the root if it changed. Writers descend the same way and
+ * only latch (by bumping the version) the nodes they change: the leaf they insert into or delete
+ * from, plus the parent when a full node is split on the way down (so a parent always has room for
+ * a separator).
+ *
+ * Entries are (key, handle) pairs ordered by key bytes and then, unless the index is unique, by
+ * handle, so equal keys are fine. Nodes are never merged or freed while the index is open, and the
+ * bytes of a deleted key are kept until close(), so a reader racing with a writer only ever follows
+ * pointers to live memory; anything it read is thrown away if the version check fails.
+ *
+ * Only the tree is thread safe: insert() and del() read the key from the relation, which is not.
+ * The tree isn't persisted; it is built from the relation by create() and open().
+ */
+class OLCBTreeIndex : public DbIndex {
+public:
+	/**
+	 * Most entries in a leaf, and separators in an interior node.
+	 */
+	static const uint FANOUT = 64;
+
+	OLCBTreeIndex(DbRelation& relation, Identifier name, ColumnNames key_columns, bool unique);
+	virtual ~OLCBTreeIndex();
+	OLCBTreeIndex(const OLCBTreeIndex& other) = delete;
+	OLCBTreeIndex(OLCBTreeIndex&& temp) = delete;
+	OLCBTreeIndex& operator=(const OLCBTreeIndex& other) = delete;
+	OLCBTreeIndex& operator=(OLCBTreeIndex&& temp) = delete;
+
+	virtual void create();
+	virtual void drop();
+	virtual void open();
+	virtual void close();
+	virtual Handles* lookup(ValueDict* key_values) const;
+	virtual Handles* range(ValueDict* min_key, ValueDict* max_key) const;
+	virtual void insert(Handle record);
+	virtual void del(Handle record);
+	virtual std::string report() const;
+
+	/**
+	 * Add an entry (thread safe).
+	 * @param key     encoded key (see encode_key())
+	 * @param handle  the row
+	 * @returns       false if the index is unique and already has the key (nothing is added)
+	 */
+	virtual bool insert_key(const KeyBytes &key, Handle handle);
+
+	/**
+	 * Remove an entry (thread safe).
+	 * @param key     encoded key
+	 * @param handle  the row
+	 * @returns       false if there was no such entry
+	 */
+	virtual bool remove_key(const KeyBytes &key, Handle handle);
+
+	/**
+	 * All the rows with exactly the given key (thread safe).
+	 * @param key  encoded key
+	 * @returns    their handles (freed by caller)
+	 */
+	virtual Handles* lookup_key(const KeyBytes &key) const;
+
+	/**
+	 * All the rows with keys in a range (thread safe).
+	 * @param min  least key (inclusive), nullptr for no lower bound
+	 * @param max  greatest key (inclusive), nullptr for no upper bound
+	 * @returns    their handles, in key order (freed by caller)
+	 */
+	virtual Handles* range_keys(const KeyBytes *min, const KeyBytes *max) const;
+
+	/**
+	 * Number of times an operation has gone back to the root, because a node changed under it or
+	 * (for an insert) after splitting a full node.
+	 * @returns  restarts since the index was opened
+	 */
+	virtual uint64_t get_restarts() const { return restarts.load(); }
+
+	virtual uint64_t get_n_entries() const { return n_entries.load(); }
+
+	/**
+	 * Levels in the tree (1 while the root is a leaf).
+	 * @returns  height
+	 */
+	virtual uint get_height() const;
+
+protected:
+	struct Entry {
+		const KeyBytes *key;  // never null: unused slots point at an empty key
+		Handle handle;
+	};
+
+	struct Node {
+		std::atomic<uint64_t> version;
+		bool leaf;
+		uint16_t count;
+
+		Node(bool leaf) : version(0), leaf(leaf), count(0) {}
+	};
+
+	struct Leaf : Node {
+		Entry entries[FANOUT];
+		Leaf *next;  // leaf to the right
+
+		Leaf();
+	};
+
+	struct Inner : Node {
+		Entry separators[FANOUT];     // first entry of children[i + 1]
+		Node *children[FANOUT + 1];
+
+		Inner();
+	};
+
+	bool closed;
+	std::atomic<Node*> root;
+	KeyProfile key_profile;
+	ColumnOrdinals key_ordinals;
+	std::mutex retired_mutex;
+	std::vector<const KeyBytes*> retired;  // keys of deleted entries, freed by close()
+	mutable std::atomic<uint64_t> restarts;
+	std::atomic<uint64_t> n_entries;
+
+	virtual void build();
+	virtual int compare(const Entry &entry, const KeyBytes &key, Handle handle) const;
+	virtual uint lower_bound(const Leaf *leaf, const KeyBytes &key, Handle handle) const;
+	virtual uint child_position(const Inner *inner, const KeyBytes &key, Handle handle) const;
+	virtual const Leaf* find_leaf(const KeyBytes &key, Handle handle, uint64_t &version) const;
+	virtual void collect(const KeyBytes *min, const KeyBytes *max, Handles *handles) const;
+	virtual void split(Node *node, uint64_t version, Inner *parent, uint64_t parent_version);
+
+	static uint64_t read_lock(const Node *node, bool &restart);
+	static void check(const Node *node, uint64_t version, bool &restart);
+	static void upgrade(Node *node, uint64_t version, bool &restart);
+	static void write_unlock(Node *node);
+	static void free_nodes(Node *node);
+};
+
+bool test_olc_btree();
@@ -3,8 +3,15 @@
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Summer 2018"
  */
+#include <algorithm>
 #include "schema_tables.h"
 #include "ParseTreeToString.h"
+#include "btree.h"
+#include "hash_index.h"
+#include "bloom_filter.h"
+#include "bitmap_index.h"
+#include "olc_btree.h"
+#include "art_index.h"
 
 
 void initialize_schema_tables() {
@@ -39,6 +46,134 @@ bool is_acceptable_data_type(std::string dt) {
     return dt == "INT" || dt == "TEXT" || dt == "BOOLEAN";  // for now
 }
 
+// Open a schema table's key index, building it from the table if the database was made before it had one.
+static void open_key_index(BTreeIndex &key_index) {
+    try {
+        key_index.open();
+    } catch (DbException& e) {
+        key_index.create();
+    }
+}
+
+// Rows of a schema table matching where. When where gives the first key column, they are found
+// through the key index and checked against the rest of where, rather than by a scan.
+static Handles* select_by_key(HeapTable &table, const BTreeIndex &key_index, const ValueDict* where) {
+    if (where == nullptr || where->find(key_index.get_key_columns()[0]) == where->end())
+        return table.HeapTable::select(where);
+    ColumnNames column_names;
+    Row values;
+    for (auto const& column: *where) {
+        column_names.push_back(column.first);
+        values.push_back(column.second);
+    }
+    ColumnOrdinals ordinals = table.get_column_ordinals(&column_names);  // unknown columns throw, as in a scan
+    Handles* candidates = key_index.lookup_prefix(where);
+    Handles* handles = new Handles();
+    for (auto const& handle: *candidates) {
+        Row* row = table.project(handle, &ordinals);
+        bool match = true;
+        for (uint i = 0; i < values.size(); i++) {
+            const Value& value = row->at(i);  // compared as the column's type, like a scan does
+            if (value.data_type == ColumnAttribute::TEXT ? value.s != values[i].s : value.n != values[i].n) {
+                match = false;
+                break;
+            }
+        }
+        if (match)
+            handles->push_back(handle);
+        delete row;
+    }
+    delete candidates;
+    return handles;
+}
+
+// the data type named in a _columns row
+static ColumnAttribute::DataType data_type_of(std::string dt) {
+    if (dt == "INT")
+        return ColumnAttribute::INT;
+    else if (dt == "TEXT")
+        return ColumnAttribute::TEXT;
+    else if (dt == "BOOLEAN")
+        return ColumnAttribute::BOOLEAN;
+    else
+        throw DbRelationError("Unknown data type");
+}
+
+
+/*
+ * ****************************
+ * Catalog class implementation
+ * ****************************
+ */
+std::unordered_map<Identifier,Catalog::TableEntry> Catalog::tables;
+
+// Entry for the table (read in if we haven't yet), or nullptr.
+const Catalog::TableEntry* Catalog::find_table(Identifier table_name) {
+    auto found = Catalog::tables.find(table_name);
+    return found == Catalog::tables.end() ? load(table_name) : &found->second;
+}
+
+// Entry for the index, or nullptr.
+const Catalog::IndexEntry* Catalog::find_index(Identifier table_name, Identifier index_name) {
+    const TableEntry* table = find_table(table_name);
+    if (table == nullptr)
+        return nullptr;
+    auto found = table->indices.find(index_name);
+    return found == table->indices.end() ? nullptr : &found->second;
+}
+
+// The next find_table() reads the table in again.
+void Catalog::forget(Identifier table_name) {
+    Catalog::tables.erase(table_name);
+}
+
+// Read in a table's rows from the schema tables. Nothing is kept if there is no such table.
+const Catalog::TableEntry* Catalog::load(Identifier table_name) {
+    ValueDict where;
+    where["table_name"] = Value(table_name);
+    Handles* handles = Tables::get_table(Tables::TABLE_NAME).select(&where);
+    bool exists = !handles->empty();
+    delete handles;
+    if (!exists)
+        return nullptr;
+    TableEntry &table = Catalog::tables[table_name];
+
+    // the key indices give rows in key order; sort them back into the order a scan would give them
+    DbRelation &columns = Tables::get_table(Columns::TABLE_NAME);
+    handles = columns.select(&where);
+    sort(handles->begin(), handles->end());
+    for (auto const& handle: *handles) {
+        ValueDict* row = columns.project(handle);
+        table.column_names.push_back(row->at("column_name").s);
+        table.column_attributes.push_back(ColumnAttribute(data_type_of(row->at("data_type").s)));
+        delete row;
+    }
+    delete handles;
+
+    DbRelation &indices = Tables::get_table(Indices::TABLE_NAME);
+    handles = indices.select(&where);
+    sort(handles->begin(), handles->end());
+    for (auto const& handle: *handles) {
+        ValueDict* row = indices.project(handle);
+        Identifier index_name = row->at("index_name").s;
+        if (table.indices.find(index_name) == table.indices.end())
+            table.index_names.push_back(index_name);
+        IndexEntry &index = table.indices[index_name];
+        uint which = (uint) row->at("seq_in_index").n;  // seq_in_index is 1-based
+        if (which > index.columns.size()) {
+            index.columns.resize(which);
+            index.included.resize(which);
+        }
+        index.columns[which - 1] = row->at("column_name").s;
+        index.included[which - 1] = row->at("is_included").n != 0;
+        index.index_type = row->at("index_type").s;
+        index.is_unique = row->at("is_unique").n != 0;
+        delete row;
+    }
+    delete handles;
+    return &table;
+}
+
 
 /*
  * ***************************
@@ -47,7 +182,8 @@ bool is_acceptable_data_type(std::string dt) {
  */
 const Identifier Tables::TABLE_NAME = "_tables";
 Columns* Tables::columns_table = nullptr;
-std::map<Identifier,DbRelation*> Tables::table_cache;
+Indices* Tables::indices_table = nullptr;
+std::unordered_map<Identifier,DbRelation*> Tables::table_cache;
 
 // get the column name for _tables column
 ColumnNames& Tables::COLUMN_NAMES() {
@@ -68,16 +204,31 @@ ColumnAttributes& Tables::COLUMN_ATTRIBUTES() {
 }
 
 // ctor - we have a fixed table structure of just one column: table_name
-Tables::Tables() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+Tables::Tables() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()), filter(*this, "_bloom", {"table_name"}),
+        key_index(*this, "_key", {"table_name"}, false) {
+    attach_index(&this->filter);
+    attach_index(&this->key_index);
     Tables::table_cache[TABLE_NAME] = this;
     if (Tables::columns_table == nullptr)
         columns_table = new Columns();
     Tables::table_cache[columns_table->TABLE_NAME] = columns_table;
+    if (Tables::indices_table == nullptr)
+        indices_table = new Indices();
+    Tables::table_cache[indices_table->TABLE_NAME] = indices_table;
+}
+
+// dtor - stop handing this one out of the table cache
+Tables::~Tables() {
+    auto found = Tables::table_cache.find(TABLE_NAME);
+    if (found != Tables::table_cache.end() && found->second == this)
+        Tables::table_cache.erase(found);
 }
 
 // Create the file and also, manually add schema tables.
 void Tables::create() {
     HeapTable::create();
+    this->key_index.create();
+    this->filter.create();
     ValueDict row;
     row["table_name"] = Value("_tables");
     insert(&row);
@@ -87,18 +238,35 @@ void Tables::create() {
     insert(&row);
 }
 
+// Open the file and the key index.
+void Tables::open() {
+    HeapTable::open();
+    open_key_index(this->key_index);
+}
+
+// Close the file, the key index, and the filter.
+void Tables::close() {
+    this->key_index.close();
+    this->filter.close();
+    HeapTable::close();
+}
+
 // Manually check that table_name is unique.
 Handle Tables::insert(const ValueDict* row) {
     // Try SELECT * FROM _tables WHERE table_name = row["table_name"] and it should return nothing
-    Handles* handles = select(row);
-    bool unique = handles->empty();
-    delete handles;
+    ValueDict where;
+    where["table_name"] = row->at("table_name");
+    Handles* matches = select(&where);
+    bool unique = matches->empty();
+    delete matches;
     if (!unique)
         throw DbRelationError(row->at("table_name").s + " already exists");
-    return HeapTable::insert(row);
+    Handle ret = HeapTable::insert(row);
+    Catalog::forget(row->at("table_name").s);
+    return ret;
 }
 
-// Remove a row, but first remove from table cache if there
+// Remove a row, but first remove from table cache (and the catalog) if there
 // NOTE: once the row is deleted, any reference to the table (from get_table() below) is gone! So drop the table first.
 void Tables::del(Handle handle) {
     // remove from cache, if there
@@ -109,38 +277,27 @@ void Tables::del(Handle handle) {
         Tables::table_cache.erase(table_name);
         delete table;
     }
+    delete row;
     HeapTable::del(handle);
+    Catalog::forget(table_name);
+}
+
+// Rows matching where, by way of the key index if where names the table.
+Handles* Tables::select(const ValueDict* where) {
+    open();
+    if (!this->filter.may_match(where))
+        return new Handles();
+    return select_by_key(*this, this->key_index, where);
 }
 
 // Return a list of column names and column attributes for given table.
 void Tables::get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes) {
-    // SELECT * FROM _columns WHERE table_name = <table_name>
-    ValueDict where;
-    where["table_name"] = table_name;
-    Handles* handles = Tables::columns_table->select(&where);
-
-    ColumnAttribute column_attribute;
-    for (auto const& handle: *handles) {
-        ValueDict* row = Tables::columns_table->project(handle);  // get the row's values: {'column_name': <name>, 'data_type': <type>}
-
-    Identifier column_name = (*row)["column_name"].s;
-    column_names.push_back(column_name);
-
-    ColumnAttribute::DataType data_type;
-    if ((*row)["data_type"].s == "INT")
-        data_type = ColumnAttribute::INT;
-    else if ((*row)["data_type"].s == "TEXT")
-        data_type = ColumnAttribute::TEXT;
-    else if ((*row)["data_type"].s == "BOOLEAN")
-        data_type = ColumnAttribute::BOOLEAN;
-    else
-        throw DbRelationError("Unknown data type");
-    column_attribute.set_data_type(data_type);
-    column_attributes.push_back(column_attribute);
-
-    delete row;
-    }
-    delete handles;
+    // what SELECT * FROM _columns WHERE table_name = <table_name> would give, from the catalog
+    const Catalog::TableEntry* table = Catalog::find_table(table_name);
+    if (table == nullptr)
+        return;
+    column_names.insert(column_names.end(), table->column_names.begin(), table->column_names.end());
+    column_attributes.insert(column_attributes.end(), table->column_attributes.begin(), table->column_attributes.end());
 }
 
 // Return a table for given table_name.
@@ -149,15 +306,35 @@ DbRelation& Tables::get_table(Identifier table_name) {
     if (Tables::table_cache.find(table_name) != Tables::table_cache.end())
         return  *Tables::table_cache[table_name];
 
+    // _tables itself is only ever read through a Tables object someone is holding
+    if (table_name == TABLE_NAME)
+        throw DbRelationError("no Tables object to read " + TABLE_NAME + " through");
+
     // otherwise assume it is a HeapTable (for now)
     ColumnNames column_names;
     ColumnAttributes column_attributes;
     get_columns(table_name, column_names, column_attributes);
     DbRelation* table = new HeapTable(table_name, column_names, column_attributes);
     Tables::table_cache[table_name] = table;
+
+    // so that inserts and deletes keep the table's indices up to date
+    for (auto const& index_name: Tables::indices_table->get_index_names(table_name))
+        Tables::indices_table->get_index(table_name, index_name);  // attaches itself to table
     return *table;
 }
 
+// Is it in the table cache?
+bool Tables::is_cached(Identifier table_name) {
+    return Tables::table_cache.find(table_name) != Tables::table_cache.end();
+}
+
+// Close the cached tables and their indices.
+void Tables::close_all() {
+    Indices::close_all();
+    for (auto const& entry: Tables::table_cache)
+        entry.second->close();
+}
+
 
 /*
  * ****************************
@@ -190,12 +367,17 @@ ColumnAttributes& Columns::COLUMN_ATTRIBUTES() {
 }
 
 // ctor - we have a fixed table structure
-Columns::Columns() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+Columns::Columns() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()),
+        filter(*this, "_bloom", {"table_name", "column_name"}), key_index(*this, "_key", {"table_name", "column_name"}, false) {
+    attach_index(&this->filter);
+    attach_index(&this->key_index);
 }
 
 // Create the file and also, manually add schema columns.
 void Columns::create() {
     HeapTable::create();
+    this->key_index.create();
+    this->filter.create();
     ValueDict row;
     row["data_type"] = Value("TEXT");  // all these are TEXT fields
     row["table_name"] = Value("_tables");
@@ -225,6 +407,8 @@ void Columns::create() {
     row["column_name"] = Value("is_unique");
     row["data_type"] = Value("BOOLEAN");
     insert(&row); 
+    row["column_name"] = Value("is_included");
+    insert(&row);
 }
 
 // Manually check that (table_name, column_name) is unique.
@@ -242,13 +426,45 @@ Handle Columns::insert(const ValueDict* row) {
     ValueDict where;
     where["table_name"] = row->at("table_name");
     where["column_name"] = row->at("column_name");
-    Handles* handles = select(&where);
-    bool unique = handles->empty();
-    delete handles;
+    Handles* matches = select(&where);
+    bool unique = matches->empty();
+    delete matches;
     if (!unique)
         throw DbRelationError("duplicate column " + row->at("table_name").s + "." + row->at("column_name").s);
 
-    return HeapTable::insert(row);
+    Handle ret = HeapTable::insert(row);
+    Catalog::forget(row->at("table_name").s);
+    return ret;
+}
+
+// Open the file and the key index.
+void Columns::open() {
+    HeapTable::open();
+    open_key_index(this->key_index);
+}
+
+// Close the file, the key index, and the filter.
+void Columns::close() {
+    this->key_index.close();
+    this->filter.close();
+    HeapTable::close();
+}
+
+// Rows matching where, by way of the key index if where names the table.
+Handles* Columns::select(const ValueDict* where) {
+    open();
+    if (!this->filter.may_match(where))
+        return new Handles();
+    return select_by_key(*this, this->key_index, where);
+}
+
+// Remove a row, and have the catalog forget its table.
+void Columns::del(Handle handle) {
+    ValueDict* row = project(handle);
+    Identifier table_name = row->at("table_name").s;
+    delete row;
+    HeapTable::del(handle);
+    Catalog::forget(table_name);
 }
 
 
@@ -258,7 +474,7 @@ Handle Columns::insert(const ValueDict* row) {
  * ****************************
  */
 const Identifier Indices::TABLE_NAME = "_indices";
-std::map<std::pair<Identifier,Identifier>,DbIndex*> Indices::index_cache;
+std::unordered_map<std::pair<Identifier,Identifier>,DbIndex*,IndexKeyHash> Indices::index_cache;
 
 // get the column name for _indices column
 ColumnNames& Indices::COLUMN_NAMES() {
@@ -270,6 +486,7 @@ ColumnNames& Indices::COLUMN_NAMES() {
         cn.push_back("column_name");
         cn.push_back("index_type");
         cn.push_back("is_unique");
+        cn.push_back("is_included");
     }
     return cn;
 }
@@ -288,12 +505,50 @@ ColumnAttributes& Indices::COLUMN_ATTRIBUTES() {
         cas.push_back(ca);  // index_type
         ca.set_data_type(ColumnAttribute::BOOLEAN);
         cas.push_back(ca);  // is_unique
+        cas.push_back(ca);  // is_included
     }
     return cas;
 }
 
 // ctor - we have a fixed table structure
-Indices::Indices() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+Indices::Indices() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()),
+        filter(*this, "_bloom", {"table_name", "index_name"}), key_index(*this, "_key", {"table_name", "index_name"}, false) {
+    attach_index(&this->filter);
+    attach_index(&this->key_index);
+}
+
+// Create the file (and a new filter and key index for it).
+void Indices::create() {
+    HeapTable::create();
+    this->key_index.create();
+    this->filter.create();
+}
+
+// Open the file and the key index.
+void Indices::open() {
+    HeapTable::open();
+    open_key_index(this->key_index);
+}
+
+// Close the file, the key index, and the filter.
+void Indices::close() {
+    this->key_index.close();
+    this->filter.close();
+    HeapTable::close();
+}
+
+// Close the cached indices.
+void Indices::close_all() {
+    for (auto const& entry: Indices::index_cache)
+        entry.second->close();
+}
+
+// Rows matching where, by way of the key index if where names the table.
+Handles* Indices::select(const ValueDict* where) {
+    open();
+    if (!this->filter.may_match(where))
+        return new Handles();
+    return select_by_key(*this, this->key_index, where);
 }
 
 // Manually check constraints -- unique on (table, index, column)
@@ -310,15 +565,17 @@ Handle Indices::insert(const ValueDict* row) {
     where["index_name"] = row->at("index_name");
     if (row->at("seq_in_index").n > 1)
         where["column_name"] = row->at("column_name");  // check for duplicate columns on the same index
-    Handles* handles = select(&where);
-    bool unique = handles->empty();
-    delete handles;
+    Handles* matches = select(&where);
+    bool unique = matches->empty();
+    delete matches;
     if (!unique)
         throw DbRelationError("duplicate index " + row->at("table_name").s + " " + row->at("index_name").s);
-    return HeapTable::insert(row);
+    Handle ret = HeapTable::insert(row);
+    Catalog::forget(row->at("table_name").s);
+    return ret;
 }
 
-// Remove a row, but first remove from index cache if there
+// Remove a row, but first remove from index cache (and the catalog) if there
 // NOTE: once the row is deleted, any reference to the index (from get_index() below) is gone! So drop the index
 void Indices::del(Handle handle) {
     // remove from cache, if there
@@ -328,88 +585,67 @@ void Indices::del(Handle handle) {
     std::pair<Identifier,Identifier> cache_key(table_name, index_name);
     if (Indices::index_cache.find(cache_key) != Indices::index_cache.end()) {
         DbIndex* index = Indices::index_cache.at(cache_key);
+        DbRelation& table = Tables::get_table(table_name);  // before the erase, so it can't make another
+        table.detach_index(index);
         Indices::index_cache.erase(cache_key);
         delete index;
     }
+    delete row;
     HeapTable::del(handle);
+    Catalog::forget(table_name);
 }
 
-// Return a list of column names and column attributes for given table.
+// Return the key columns (and any included columns) of the given index, and what kind it is.
 void Indices::get_columns(Identifier table_name, Identifier index_name,
-        ColumnNames &column_names, bool &is_hash, bool &is_unique) {
-    // SELECT * FROM _indices WHERE table_name = <table_name> AND index_name = <index_name>
-    ValueDict where;
-    where["table_name"] = table_name;
-    where["index_name"] = index_name;
-    Handles* handles = select(&where);
-
-    Identifier colnames[DbIndex::MAX_COMPOSITE];
-    uint size = 0;
-    for (auto const& handle: *handles) {
-        ValueDict *row = project(handle);
-
-        Identifier column_name = (*row)["column_name"].s;
-        uint which = (uint) (*row)["seq_in_index"].n;
-        colnames[which - 1] = column_name;  // seq_in_index is 1-based
-        if (which > size)
-            size = which;
-        is_unique = (*row)["is_unique"].n != 0;
-        is_hash = (*row)["index_type"].s == "HASH";
-        delete row;
-    }
-    for (uint i = 0; i < size; i++)
-        column_names.push_back(colnames[i]);
-    delete handles;
+        ColumnNames &column_names, Identifier &index_type, bool &is_unique, ColumnNames &included_columns) {
+    // what SELECT * FROM _indices WHERE table_name = <table_name> AND index_name = <index_name> would give,
+    // from the catalog
+    const Catalog::IndexEntry* index = Catalog::find_index(table_name, index_name);
+    if (index == nullptr)
+        return;
+    for (uint i = 0; i < index->columns.size(); i++)
+        (index->included[i] ? included_columns : column_names).push_back(index->columns[i]);  // numbered after the key columns
+    is_unique = index->is_unique;
+    index_type = index->index_type;
 }
 
-// FIXME - use this for now until we have BTreeIndex and HashIndex
-class DummyIndex : public DbIndex {
-    public:
-        DummyIndex(DbRelation& rel, Identifier idx, ColumnNames key, bool unq) : DbIndex(rel, idx, key, unq) {}
-        void create() {}
-        void drop() {}
-        void open() {}
-        void close() {}
-        Handles* lookup(ValueDict* key_values) const {return nullptr;}
-        void insert(Handle handle) {}
-        void del(Handle handle) {}
-};
-
-
-// Return a table for given table_name.
+// Return the index for given table_name and index_name.
 DbIndex& Indices::get_index(Identifier table_name, Identifier index_name) {
     // if they are asking about an index we've once constructed, then just return that one
     std::pair<Identifier,Identifier> cache_key(table_name, index_name);
     if (Indices::index_cache.find(cache_key) != Indices::index_cache.end())
         return  *Indices::index_cache[cache_key];
 
-    // otherwise assume it is a DummyIndex (for now)
-    ColumnNames column_names;
-    bool is_hash, is_unique;
-    get_columns(table_name, index_name, column_names, is_hash, is_unique);
+    // otherwise make one of the right type and attach it to its table
+    ColumnNames column_names, included_columns;
+    Identifier index_type;
+    bool is_unique;
+    get_columns(table_name, index_name, column_names, index_type, is_unique, included_columns);
     DbRelation& table = Tables::get_table(table_name);
     DbIndex* index;
-    if (is_hash) {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to HashIndex
+    if (index_type != "BTREE" && !included_columns.empty())
+        throw DbRelationError("only BTREE indices can include columns");
+    if (index_type == "HASH") {
+        index = new HashIndex(table, index_name, column_names, is_unique);
+    } else if (index_type == "BLOOM") {
+        index = new BloomFilter(table, index_name, column_names);
+    } else if (index_type == "BITMAP") {
+        index = new BitmapIndex(table, index_name, column_names);
+    } else if (index_type == "OLC") {
+        index = new OLCBTreeIndex(table, index_name, column_names, is_unique);
+    } else if (index_type == "ART") {
+        index = new ARTIndex(table, index_name, column_names, is_unique);
     } else {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to BTreeIndex
+        index = new BTreeIndex(table, index_name, column_names, is_unique, included_columns);
     }
     Indices::index_cache[cache_key] = index;
+    table.attach_index(index);
     return *index;
 }
 
+// Return the names of the given table's indices, in the order they were created.
 IndexNames Indices::get_index_names(Identifier table_name) {
-    IndexNames ret;
-    ValueDict where;
-    where["table_name"] = Value(table_name);
-    where["seq_in_index"] = Value(1);  // only get the row for the first column if composite index
-    Handles* handles = select(&where);
-    for (auto const& handle: *handles) {
-        ValueDict* row = project(handle);
-        ret.push_back((*row)["index_name"].s);
-        delete row;
-    }
-    delete handles;
-    return ret;
+    const Catalog::TableEntry* table = Catalog::find_table(table_name);
+    return table == nullptr ? IndexNames() : table->index_names;
 }
 
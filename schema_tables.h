@@ -7,7 +7,10 @@
  */
 #pragma once
 
+#include <unordered_map>
 #include "heap_storage.h"
+#include "bloom_filter.h"
+#include "btree.h"
 
 /**
  * Initialize access to the schema tables.
@@ -18,11 +21,83 @@ void initialize_schema_tables();
 
 
 class Columns; // forward declare
+class Indices; // forward declare
+
+typedef ColumnNames IndexNames;
+
+/**
+ * @class Catalog - In-memory copy of what the schema tables say about each table looked up so far,
+ * so that finding a table's columns, an index's definition, or whether a table or index exists is
+ * a hash lookup rather than a scan of _columns or _indices.
+ * A table is read in through the schema tables' key indices the first time it is asked about, so
+ * nothing is read at startup however many tables there are. The schema tables' own insert() and
+ * del() make it forget a table whose rows change, so every DDL statement (and the undoing of a
+ * failed one) shows up in it.
+ */
+class Catalog {
+    public:
+        /**
+         * What _indices says about an index, with its columns in seq_in_index order.
+         */
+        struct IndexEntry {
+                ColumnNames columns;        // key columns, then any included columns
+                std::vector<bool> included;  // for each of columns
+                Identifier index_type;
+                bool is_unique;
+        };
+
+        /**
+         * What _tables, _columns and _indices say about a table.
+         */
+        struct TableEntry {
+                ColumnNames column_names;
+                ColumnAttributes column_attributes;
+                IndexNames index_names;  // in the order they were created
+                std::unordered_map<Identifier,IndexEntry> indices;
+        };
+
+        /**
+         * Look up a table (schema tables included).
+         * @param table_name  table to find
+         * @returns           its entry, or nullptr if there is no such table
+         */
+        static const TableEntry* find_table(Identifier table_name);
+
+        /**
+         * Look up an index.
+         * @param table_name  table the index is on
+         * @param index_name  index to find
+         * @returns           its entry, or nullptr if there is no such index
+         */
+        static const IndexEntry* find_index(Identifier table_name, Identifier index_name);
+
+        /**
+         * Drop what we have on a table, since one of its rows in the schema tables has changed.
+         * @param table_name  the table
+         */
+        static void forget(Identifier table_name);
+
+    private:
+        static std::unordered_map<Identifier,TableEntry> tables;  // the tables looked up so far
+
+        static const TableEntry* load(Identifier table_name);
+};
+
+/**
+ * Hash of a (table name, index name) pair.
+ */
+struct IndexKeyHash {
+        size_t operator()(const std::pair<Identifier,Identifier> &key) const {
+            return std::hash<Identifier>()(key.first) * 31 + std::hash<Identifier>()(key.second);
+        }
+};
 
 /**
  * @class Tables - The singleton table that stores the metadata for all other tables.
- * For now, we are not indexing anything, so a query requires sequential scan
- * of the table.
+ * Each schema table has a built-in BTreeIndex on its key columns (named "_key"), which
+ * select() uses when the where clause gives the first of them, and a BloomFilter on the
+ * same columns, so the check that a new row isn't already there rarely touches the
+ * index at all. Lookups by name go to the Catalog.
  */
 class Tables : public HeapTable {
     public:
@@ -33,12 +108,16 @@ class Tables : public HeapTable {
 
         // ctor/dtor
         Tables();
-        virtual ~Tables() {}
+        virtual ~Tables();
 
         // HeapTable overrides
         virtual void create();
+        virtual void open();
+        virtual void close();
         virtual Handle insert(const ValueDict* row);
         virtual void del(Handle handle);
+        using HeapTable::select;
+        virtual Handles* select(const ValueDict* where);
 
         /**
          * Get the columns and their attributes for a given table.
@@ -51,12 +130,26 @@ class Tables : public HeapTable {
         static void get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes);
 
         /**
-         * Get the correctly instantiated DbRelation for a given table.
+         * Get the correctly instantiated DbRelation for a given table, with its indices attached.
          * @param table_name  table to get
          * @returns           instantiated DbRelation of the correct type
          */
         static DbRelation& get_table(Identifier table_name);
 
+        /**
+         * Whether get_table() has already instantiated the given table (and attached its indices).
+         * @param table_name  table to check
+         * @returns           true if it is in the table cache
+         */
+        static bool is_cached(Identifier table_name);
+
+        /**
+         * Close every table and index handed out so far, the schema tables included, so that
+         * each one's metadata is written back marked clean and the next open can trust it.
+         * They are reopened as needed if used again.
+         */
+        static void close_all();
+
     protected:
         // hard-coded columns for _tables table
         static ColumnNames& COLUMN_NAMES();
@@ -65,9 +158,16 @@ class Tables : public HeapTable {
         // keep a reference to the columns table (for get_columns method)
         static Columns* columns_table;
 
+        // keep a reference to the indices table (for get_table method)
+        static Indices* indices_table;
+
+        // table_name of every row (for the uniqueness check in insert)
+        BloomFilter filter;
+        BTreeIndex key_index;
+
     private:
         // keep a cache of all the tables we've instantiated so far
-        static std::map<Identifier,DbRelation*> table_cache;
+        static std::unordered_map<Identifier,DbRelation*> table_cache;
 };
 
 
@@ -87,15 +187,22 @@ class Columns : public HeapTable {
 
         // HeapTable overrides
         virtual void create();
+        virtual void open();
+        virtual void close();
         virtual Handle insert(const ValueDict* row);
+        virtual void del(Handle handle);
+        using HeapTable::select;
+        virtual Handles* select(const ValueDict* where);
 
     protected:
         // hard-coded columns for the _columns table
         static ColumnNames& COLUMN_NAMES();
         static ColumnAttributes& COLUMN_ATTRIBUTES();
-};
 
-typedef ColumnNames IndexNames;
+        // (table_name, column_name) of every row (for the uniqueness check in insert)
+        BloomFilter filter;
+        BTreeIndex key_index;
+};
 
 class Indices : public HeapTable {
     public:
@@ -114,12 +221,13 @@ class Indices : public HeapTable {
          * @param index_name      name of index (unique by table)
          * @param column_names    returned by reference: list of column names
          *                        in search key in order
-         * @param is_hash         returned by reference: set to False if the
-         *                        requested index is a btree index
+         * @param index_type      returned by reference: BTREE, HASH, BLOOM, BITMAP, OLC or ART
          * @param is_unique       search key for this index is a key for the relation
+         * @param included_columns  returned by reference: other columns the index
+         *                        carries (rows with is_included true)
          */ 
         virtual void get_columns(Identifier table_name, Identifier index_name,
-                ColumnNames &column_names, bool &is_hash, bool &is_unique);
+                ColumnNames &column_names, Identifier &index_type, bool &is_unique, ColumnNames &included_columns);
 
         /**
          * Get the instantiated DbIndex for the given index.
@@ -136,15 +244,29 @@ class Indices : public HeapTable {
          */
         virtual IndexNames get_index_names(Identifier table_name);
 
+        /**
+         * Close every index handed out by get_index().
+         */
+        static void close_all();
+
         // overrides
+        virtual void create();
+        virtual void open();
+        virtual void close();
         virtual Handle insert(const ValueDict* row);
         virtual void del(Handle handle);
+        using HeapTable::select;
+        virtual Handles* select(const ValueDict* where);
 
     protected:
         static ColumnNames& COLUMN_NAMES();
         static ColumnAttributes& COLUMN_ATTRIBUTES();
 
+        // (table_name, index_name) of every row (for the uniqueness check in insert)
+        BloomFilter filter;
+        BTreeIndex key_index;  // not unique: a row for each column of an index
+
     private:
-        static std::map<std::pair<Identifier,Identifier>,DbIndex*> index_cache;
+        static std::unordered_map<std::pair<Identifier,Identifier>,DbIndex*,IndexKeyHash> index_cache;
 };
 
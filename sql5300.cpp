@@ -18,24 +18,36 @@
 #include "SQLParser.h"
 #include "ParseTreeToString.h"
 #include "SQLExec.h"
+#include "btree.h"
+#include "hash_index.h"
+#include "bloom_filter.h"
+#include "bitmap_index.h"
+#include "olc_btree.h"
+#include "art_index.h"
 using namespace std;
 using namespace hsql;
 
 /*
- * we allocate and initialize the _DB_ENV global
+ * we allocate and initialize the _DB_ENV, _BUFFER_POOL and _FILE_POOL globals
  */
-void initialize_environment(char *envHome);
+void initialize_environment(char *envHome, uint bufferFrames);
 
 
 /**
  * Main entry point of the sql5300 program
- * @args dbenvpath  the path to the BerkeleyDB database environment
+ * @args dbenvpath      the path to the BerkeleyDB database environment
+ * @args buffer_frames  optional number of 4kB frames in the buffer pool
  */
 int main(int argc, char *argv[]) {
 
     // Open/create the db enviroment
-    if (argc != 2) {
-        cerr << "Usage: cpsc5300: dbenvpath" << endl;
+    if (argc != 2 && argc != 3) {
+        cerr << "Usage: cpsc5300: dbenvpath [buffer_frames]" << endl;
+        return 1;
+    }
+    uint bufferFrames = argc == 3 ? (uint) atoi(argv[2]) : BufferPool::DEFAULT_FRAMES;
+    if (bufferFrames == 0) {
+        cerr << "Usage: cpsc5300: dbenvpath [buffer_frames]" << endl;
         return 1;
     }
 
@@ -43,7 +55,7 @@ int main(int argc, char *argv[]) {
     // not all valid paths are recognized
     // would need to do some additional 'clean up' on the string before passing 
     // it into this function...
-    initialize_environment(argv[1]);
+    initialize_environment(argv[1], bufferFrames);
 
     // Enter the SQL shell loop
     while (true) {
@@ -56,10 +68,42 @@ int main(int argc, char *argv[]) {
             break;  // only way to get out
         if (query == "test") {
             cout << "test_heap_storage: " << (test_heap_storage() ? "ok" : "failed") << endl;
+            cout << "test_index_key: " << (test_index_key() ? "ok" : "failed") << endl;
+            cout << "test_btree: " << (test_btree() ? "ok" : "failed") << endl;
+            cout << "test_hash_index: " << (test_hash_index() ? "ok" : "failed") << endl;
+            cout << "test_bloom_filter: " << (test_bloom_filter() ? "ok" : "failed") << endl;
+            cout << "test_bitmap_index: " << (test_bitmap_index() ? "ok" : "failed") << endl;
+            cout << "test_olc_btree: " << (test_olc_btree() ? "ok" : "failed") << endl;
+            cout << "test_art_index: " << (test_art_index() ? "ok" : "failed") << endl;
+            cout << "test_sql_exec: " << (test_sql_exec() ? "ok" : "failed") << endl;
+            continue;
+        }
+        if (query == "stats") {
+            cout << "buffer pool: " << _BUFFER_POOL->get_n_frames() << " frames, "
+                 << _BUFFER_POOL->get_hits() << " hits, " << _BUFFER_POOL->get_misses() << " misses, "
+                 << _BUFFER_POOL->get_evictions() << " evictions, " << _BUFFER_POOL->get_writes() << " writes"
+                 << endl;
+            cout << "file pool: " << _FILE_POOL->get_n_open() << " of " << _FILE_POOL->get_capacity() << " files open, "
+                 << _FILE_POOL->get_opens() << " opens, " << _FILE_POOL->get_evictions() << " evictions" << endl;
+            continue;
+        }
+
+        // SHOW TABLE STATUS isn't known to the parser, so it is run straight from the text
+        try {
+            QueryResult *status = SQLExec::show_table_status(query);
+            if (status != nullptr) {
+                cout << *status << endl;
+                delete status;
+                continue;
+            }
+        } catch (SQLExecError& e) {
+            cout << "Error: " << e.what() << endl;
             continue;
         }
 
-        // parse and execute
+        // parse and execute (the parser doesn't know CREATE INDEX ... INCLUDE, so that is taken off first)
+        ColumnNames included_columns;
+        query = SQLExec::take_include(query, included_columns);
         SQLParserResult* parse = SQLParser::parseSQLString(query);
         if (!parse->isValid()) {
             cout << "invalid SQL: " << query << endl;
@@ -69,7 +113,7 @@ int main(int argc, char *argv[]) {
                 const SQLStatement *statement = parse->getStatement(i);
                 try {
                     cout << ParseTreeToString::statement(statement) << endl;
-                    QueryResult *result = SQLExec::execute(statement);
+                    QueryResult *result = SQLExec::execute(statement, &included_columns);
                     cout << *result << endl;
                     delete result;
                 } catch (SQLExecError& e) {
@@ -79,11 +123,15 @@ int main(int argc, char *argv[]) {
         }
         delete parse;
     }
+    Tables::close_all();  // so the next startup can trust what they wrote
+    _BUFFER_POOL->flush_all();
     return EXIT_SUCCESS;
 }
 
 DbEnv *_DB_ENV;
-void initialize_environment(char *envHome) {
+BufferPool *_BUFFER_POOL;
+FilePool *_FILE_POOL;
+void initialize_environment(char *envHome, uint bufferFrames) {
     cout << "(sql5300: running with database environment at " << envHome
         << ")" << endl;
 
@@ -97,5 +145,7 @@ void initialize_environment(char *envHome) {
         exit(1);
     }
     _DB_ENV = env;
+    _BUFFER_POOL = new BufferPool(bufferFrames);
+    _FILE_POOL = new FilePool();
     initialize_schema_tables();
 }
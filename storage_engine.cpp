@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "storage_engine.h"
 
 bool Value::operator==(const Value &other) const {
@@ -20,3 +21,64 @@ ValueDict* DbRelation::project(Handle handle, const ValueDict* where) {
     return this->project(handle, &t);
 }
 
+
+// Adapter for relations which only take ValueDict's: keys the row by column name.
+Handle DbRelation::insert(const Row* row) {
+    if (row->size() != this->column_names.size())
+        throw DbRelationError("row has " + std::to_string(row->size()) + " values for "
+                              + std::to_string(this->column_names.size()) + " columns");
+    ValueDict dict;
+    for (uint i = 0; i < row->size(); i++)
+        dict[this->column_names[i]] = (*row)[i];
+    return this->insert(&dict);
+}
+
+// One row at a time, for relations without a batched path.
+Handles* DbRelation::insert_many(const Rows* rows) {
+    Handles* handles = new Handles();
+    for (auto const& row: *rows)
+        handles->push_back(this->insert(row));
+    return handles;
+}
+
+// Adapter for relations which only project to ValueDict's: looks the columns up by name.
+Row* DbRelation::project(Handle handle, const ColumnOrdinals* column_ordinals) {
+    ColumnNames t;
+    for (auto const& ordinal: *column_ordinals)
+        t.push_back(this->column_names.at(ordinal));
+    ValueDict* dict = this->project(handle, &t);
+    Row* row = new Row();
+    row->reserve(t.size());
+    for (auto const& column_name: t)
+        row->push_back((*dict)[column_name]);
+    delete dict;
+    return row;
+}
+
+// Linear search is fine: this is done once per statement, not per row.
+ColumnOrdinals DbRelation::get_column_ordinals(const ColumnNames* column_names) const {
+    ColumnOrdinals ordinals;
+    if (column_names->empty()) {
+        for (uint i = 0; i < this->column_names.size(); i++)
+            ordinals.push_back(i);
+        return ordinals;
+    }
+    for (auto const& column_name: *column_names) {
+        uint i = 0;
+        while (i < this->column_names.size() && this->column_names[i] != column_name)
+            i++;
+        if (i == this->column_names.size())
+            throw DbRelationError("table does not have column named '" + column_name + "'");
+        ordinals.push_back(i);
+    }
+    return ordinals;
+}
+
+void DbRelation::attach_index(DbIndex* index) {
+    if (std::find(this->indices.begin(), this->indices.end(), index) == this->indices.end())
+        this->indices.push_back(index);
+}
+
+void DbRelation::detach_index(DbIndex* index) {
+    this->indices.erase(std::remove(this->indices.begin(), this->indices.end(), index), this->indices.end());
+}
@@ -9,7 +9,9 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <exception>
+#include <iterator>
 #include <map>
 #include <utility>
 #include <vector>
@@ -115,8 +117,75 @@ class DbBlock {
         BlockID block_id;
 };
 
-// convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+/**
+ * @class Cursor - pull-based iteration over a sequence of T's without materializing them
+ *
+ * Methods:
+ *  open()
+ *  next(item)
+ *  close()
+ * Can also be used in a range-for, which opens the cursor and closes it at the end:
+ *  for (auto const& item: *cursor) ...
+ */
+template <class T>
+class Cursor {
+    public:
+        virtual ~Cursor() {}
+
+        /**
+         * Start (or restart) the sequence.
+         */
+        virtual void open() = 0;
+
+        /**
+         * Fetch the next item.
+         * @param item  returned by reference: the next item in the sequence
+         * @returns     false if the sequence is exhausted (item is unchanged)
+         */
+        virtual bool next(T &item) = 0;
+
+        /**
+         * Release any resources held by the cursor. Safe to call more than once.
+         */
+        virtual void close() = 0;
+
+        /**
+         * @class iterator - input iterator adapter so a Cursor works in a range-for
+         */
+        class iterator {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef T value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const T* pointer;
+                typedef const T& reference;
+
+                iterator() : cursor(nullptr), item() {}
+                explicit iterator(Cursor<T>* cursor) : cursor(cursor), item() { ++(*this); }
+                const T& operator*() const { return item; }
+                const T* operator->() const { return &item; }
+                iterator& operator++() {
+                    if (cursor != nullptr && !cursor->next(item)) {
+                        cursor->close();
+                        cursor = nullptr;
+                    }
+                    return *this;
+                }
+                bool operator==(const iterator &other) const { return cursor == other.cursor; }
+                bool operator!=(const iterator &other) const { return cursor != other.cursor; }
+
+            private:
+                Cursor<T>* cursor;
+                T item;
+        };
+
+        iterator begin() { open(); return iterator(this); }
+        iterator end() { return iterator(); }
+};
+
+// convenience type aliases
+typedef std::vector<BlockID> BlockIDs;  // prefer DbFile::cursor() for scans
+typedef Cursor<BlockID> BlockCursor;
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -128,6 +197,7 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  *	get(block_id)
  *	put(block)
  *	block_ids()
+ *	cursor()
  */
 class DbFile {
     public:
@@ -176,11 +246,17 @@ class DbFile {
 
         /**
          * Get a list of all the valid BlockID's in the file
-         * FIXME - not a good long-term approach, but we'll do this until we put in iterators
+         * Materializes the whole list -- use cursor() for scans.
          * @returns  a pointer to vector of BlockIDs (freed by caller)
          */ 
         virtual BlockIDs* block_ids() const = 0;
 
+        /**
+         * Get a cursor over all the valid BlockID's in the file, in order.
+         * @returns  a pointer to an unopened cursor (freed by caller)
+         */
+        virtual BlockCursor* cursor() = 0;
+
     protected:
         std::string name;  // filename (or part of it)
 };
@@ -200,7 +276,7 @@ class ColumnAttribute {
         ColumnAttribute(DataType data_type) : data_type(data_type) {}
         virtual ~ColumnAttribute() {}
 
-        virtual DataType get_data_type() { return data_type; }
+        virtual DataType get_data_type() const { return data_type; }
         virtual void set_data_type(DataType data_type) {this->data_type = data_type;}
 
     protected:
@@ -219,7 +295,7 @@ class Value {
 
         Value() : n(0) {data_type = ColumnAttribute::INT;}
         Value(int32_t n) : n(n) {data_type = ColumnAttribute::INT;}
-        Value(std::string s) : s(s) {data_type = ColumnAttribute::TEXT; }
+        Value(std::string s) : n(0), s(s) {data_type = ColumnAttribute::TEXT; }
 
         bool operator==(const Value &other) const;
         bool operator!=(const Value &other) const;
@@ -230,9 +306,13 @@ typedef std::string Identifier;
 typedef std::vector<Identifier> ColumnNames;
 typedef std::vector<ColumnAttribute> ColumnAttributes;
 typedef std::pair<BlockID, RecordID> Handle;
-typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
-typedef std::map<Identifier, Value> ValueDict;
+typedef std::vector<Handle> Handles;  // prefer DbRelation::cursor() for scans
+typedef Cursor<Handle> HandleCursor;
+typedef std::map<Identifier, Value> ValueDict;  // keyed by column name -- prefer Row where the columns are known
 typedef std::vector<ValueDict*> ValueDicts;
+typedef std::vector<uint> ColumnOrdinals;       // positions of columns within a relation's column_names
+typedef std::vector<Value> Row;                 // one Value per column, by position
+typedef std::vector<Row*> Rows;
 
 
 /**
@@ -244,6 +324,8 @@ class DbRelationError : public std::runtime_error {
 };
 
 
+class DbIndex;  // forward declare
+
 /**
  * @class DbRelation - top-level object handling a physical database relation
  * 
@@ -256,18 +338,27 @@ class DbRelationError : public std::runtime_error {
  * 	close()
  * 	
  *	insert(row)
+ *	insert_many(rows)
  *	update(handle, new_values)
  *	del(handle)
  *	select()
  *	select(where)
+ *	cursor(where)
  *	project(handle)
  *	project(handle, column_names)
+ *	project(handle, column_ordinals)
+ *	get_column_ordinals(column_names)
+ *	attach_index(index)
+ *	detach_index(index)
+ *
+ * Rows can be passed either as a ValueDict keyed by column name or positionally as a Row.
+ * Row is the native form for HeapTable; ValueDict is kept for compatibility.
  */
 class DbRelation {
     public:
         // ctor/dtor
         DbRelation(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes ) :
-            table_name(table_name), column_names(column_names), column_attributes(column_attributes) {}
+            table_name(table_name), column_names(column_names), column_attributes(column_attributes), indices() {}
         virtual ~DbRelation() {}
 
         /**
@@ -306,6 +397,21 @@ class DbRelation {
          */
         virtual Handle insert(const ValueDict* row) = 0;
 
+        /**
+         * Execute: INSERT INTO <table_name> VALUES ( <row_values> )
+         * @param row  one value for every column, in the order of get_column_names()
+         * @returns    a handle to the new row
+         */
+        virtual Handle insert(const Row* row);
+
+        /**
+         * Execute: INSERT INTO <table_name> VALUES ( <row_values> ), ( <row_values> ), ...
+         * All the rows are validated before any is inserted.
+         * @param rows  rows to insert, each with one value for every column, in column order
+         * @returns     handles to the new rows, in the same order (freed by caller)
+         */
+        virtual Handles* insert_many(const Rows* rows);
+
         /**
          * Conceptually, execute: UPDATE INTO <table_name> SET <new_valus> WHERE <handle>
          * where handle is sufficient to identify one specific record (e.g., returned
@@ -336,6 +442,13 @@ class DbRelation {
          */
         virtual Handles* select(const ValueDict* where) = 0;
 
+        /**
+         * Like select(where), but streams the handles instead of building a list of them.
+         * @param where  where-clause predicates (nullptr for all rows); copied by the cursor
+         * @returns      a pointer to an unopened cursor over qualifying rows (freed by caller)
+         */
+        virtual HandleCursor* cursor(const ValueDict* where = nullptr) = 0;
+
         /**
          * Return a sequence of all values for handle (SELECT *).
          * @param handle  row to get values from
@@ -361,6 +474,43 @@ class DbRelation {
          */
         virtual ValueDict* project(Handle handle, const ValueDict* column_names);
 
+        /**
+         * Return the values for handle at the given column positions (SELECT <column_names>).
+         * Resolve the positions once per statement with get_column_ordinals().
+         * @param handle           row to get values from
+         * @param column_ordinals  positions of the columns to project
+         * @returns                values from row, in the order of column_ordinals (freed by caller)
+         */
+        virtual Row* project(Handle handle, const ColumnOrdinals* column_ordinals);
+
+        /**
+         * Look up the positions of columns by name.
+         * @param column_names  columns to find (empty for all of them)
+         * @returns             position of each column within get_column_names()
+         * @throws              DbRelationError if there is no column with one of the names
+         */
+        virtual ColumnOrdinals get_column_ordinals(const ColumnNames* column_names) const;
+
+        /**
+         * Keep an index up to date as rows are inserted into and deleted from this relation.
+         * @param index  index on this relation (not owned; detach it before deleting it)
+         */
+        virtual void attach_index(DbIndex* index);
+
+        /**
+         * Stop maintaining an index.
+         * @param index  index previously attached
+         */
+        virtual void detach_index(DbIndex* index);
+
+        /**
+         * Accessor for table_name.
+         * @returns table_name  name of this relation
+         */
+        virtual const Identifier& get_table_name() const {
+            return table_name;
+        }
+
         /**
          * Accessor for column_names.
          * @returns column_names   list of column names for this relation, in order
@@ -381,6 +531,7 @@ class DbRelation {
         Identifier table_name;
         ColumnNames column_names;
         ColumnAttributes column_attributes;
+        std::vector<DbIndex*> indices;  // attached indices, maintained by insert and del
 };
 
 class DbIndex {
@@ -415,6 +566,12 @@ class DbIndex {
          */
         virtual void close() = 0;
 
+        /**
+         * Close any file the index keeps open outside the FilePool; it is opened again on next use.
+         * Called when the pool closes the relation's file.
+         */
+        virtual void release() {}
+
         /**
          * Lookup a specific search key.
          * @param key_values  dictionary of values for the search key
@@ -432,6 +589,37 @@ class DbIndex {
             throw DbRelationError("range index query not supported");
         }
 
+        /**
+         * Whether the index's entries carry all of the given columns, so that a query touching
+         * only them can be answered by lookup_rows() without reading the relation.
+         * @param column_names  columns the query touches (selected or in its where clause)
+         * @returns             true if lookup_rows() can answer it
+         */
+        virtual bool covers(const ColumnNames* column_names) const {
+            return false;
+        }
+
+        /**
+         * Execute: SELECT <column_names> FROM <relation> WHERE <where>
+         * from the index's entries alone (an index-only scan). Only for columns it covers().
+         * @param where         column = value conditions (nullptr for all rows)
+         * @param column_names  columns to return
+         * @returns             the qualifying rows, each in the order of column_names (freed by caller)
+         */
+        virtual Rows* lookup_rows(const ValueDict* where, const ColumnNames* column_names) const {
+            throw DbRelationError("index-only query not supported");
+        }
+
+        /**
+         * Whether any row might satisfy a where clause, so that a scan for it can be skipped
+         * when the index is sure there is none (e.g. a Bloom filter that doesn't have the key).
+         * @param where  column = value conditions (nullptr for all rows)
+         * @returns      false only if no row of the relation can match
+         */
+        virtual bool may_match(const ValueDict* where) const {
+            return true;
+        }
+
         /**
          * Insert the index entry for the given record.
          * @param record  handle (into relation) to the record to insert
@@ -446,6 +634,22 @@ class DbIndex {
          */
         virtual void del(Handle record) = 0;
 
+        /**
+         * Describe the size of the index and how long create() took, for messages.
+         * @returns  description (empty if there is nothing to say)
+         */
+        virtual std::string report() const {
+            return "";
+        }
+
+        /**
+         * Accessor for key_columns.
+         * @returns  the key columns, in key order
+         */
+        virtual const ColumnNames& get_key_columns() const {
+            return key_columns;
+        }
+
     protected:
         DbRelation& relation;
         Identifier name;
@@ -0,0 +1,124 @@
+/**
+ * @file synopsis_file.cpp - implementation of:
+ * SynopsisFile
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <memory.h>
+#include "synopsis_file.h"
+using namespace std;
+
+SynopsisFile::SynopsisFile(string dbfilename, uint32_t magic) : dbfilename(dbfilename), magic(magic), db(nullptr) {
+}
+
+// Open the file, creating it if it isn't there, and mark it as in use.
+void SynopsisFile::create() {
+    db_open(DB_CREATE);
+    write_header(false, 0);
+}
+
+// Remove the file. Tables created before the owner was added don't have one.
+void SynopsisFile::drop() {
+    if (is_open()) {
+        this->db->close(0);
+        delete this->db;
+        this->db = nullptr;
+    }
+    Db db(_DB_ENV, 0);
+    try {
+        db.remove(this->dbfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // nothing to remove
+    }
+}
+
+// Read the contents if they were written back by a close(), and mark the file as in use.
+bool SynopsisFile::open(string &contents) {
+    try {
+        db_open();
+    } catch (DbException &e) {
+        create();
+        return false;
+    }
+    bool trusted = read(contents);
+    write_header(false, 0);
+    return trusted;
+}
+
+// Write the contents, then the header that says they are there, and close the file.
+void SynopsisFile::close(const string &contents) {
+    if (!is_open())
+        return;
+    char block[DbBlock::BLOCK_SZ];
+    BlockID record;
+    Dbt key(&record, sizeof(record));
+    Dbt data(block, sizeof(block));
+    for (size_t offset = 0; offset < contents.size(); offset += DbBlock::BLOCK_SZ) {
+        memset(block, 0, sizeof(block));
+        memcpy(block, contents.data() + offset, min((size_t) DbBlock::BLOCK_SZ, contents.size() - offset));
+        record = (BlockID) (offset / DbBlock::BLOCK_SZ + 2);
+        this->db->put(nullptr, &key, &data, 0);
+    }
+    write_header(true, contents.size());
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+}
+
+// Wrapper for Berkeley DB open, with a new handle each time (they can't be reopened).
+void SynopsisFile::db_open(uint flags) {
+    this->db = new Db(_DB_ENV, 0);
+    this->db->set_re_len(DbBlock::BLOCK_SZ);
+    try {
+        this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    } catch (DbException &e) {
+        delete this->db;
+        this->db = nullptr;
+        throw;
+    }
+}
+
+// Get the contents if the header says they were written back cleanly by our kind of owner.
+bool SynopsisFile::read(string &contents) {
+    char block[DbBlock::BLOCK_SZ];
+    BlockID record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data;
+    data.set_data(block);
+    data.set_ulen(sizeof(block));
+    data.set_flags(DB_DBT_USERMEM);
+
+    uint32_t magic, clean;
+    uint64_t size;
+    if (this->db->get(nullptr, &key, &data, 0) != 0)
+        return false;
+    memcpy(&magic, block, sizeof(magic));
+    memcpy(&clean, block + sizeof(magic), sizeof(clean));
+    memcpy(&size, block + 2 * sizeof(uint32_t), sizeof(size));
+    if (magic != this->magic || clean == 0)
+        return false;
+    string bytes;
+    bytes.reserve(size);
+    for (uint64_t offset = 0; offset < size; offset += DbBlock::BLOCK_SZ) {
+        record = (BlockID) (offset / DbBlock::BLOCK_SZ + 2);
+        if (this->db->get(nullptr, &key, &data, 0) != 0)
+            return false;  // lost -- start over
+        bytes.append(block, (size_t) min((uint64_t) DbBlock::BLOCK_SZ, size - offset));
+    }
+    contents.swap(bytes);
+    return true;
+}
+
+// Header record: magic number, clean flag, then the size of the contents.
+void SynopsisFile::write_header(bool clean, uint64_t size) {
+    char block[DbBlock::BLOCK_SZ];
+    uint32_t flag = clean ? 1U : 0U;
+    memset(block, 0, sizeof(block));
+    memcpy(block, &this->magic, sizeof(this->magic));
+    memcpy(block + sizeof(uint32_t), &flag, sizeof(flag));
+    memcpy(block + 2 * sizeof(uint32_t), &size, sizeof(size));
+    BlockID record = 1;
+    Dbt key(&record, sizeof(record));
+    Dbt data(block, sizeof(block));
+    this->db->put(nullptr, &key, &data, 0);
+}
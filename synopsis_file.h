@@ -0,0 +1,73 @@
+/**
+ * @file synopsis_file.h - Berkeley DB file behind a synopsis that is held in memory while open.
+ * SynopsisFile
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include "db_cxx.h"
+#include "storage_engine.h"
+
+/**
+ * @class SynopsisFile - the file a ZoneMap, BloomFilter or BitmapIndex writes its contents back to.
+ * Its owner keeps the contents in memory while the file is open and hands them over, serialized,
+ * to close().
+ *
+ * A Berkeley DB RecNo file of DbBlock::BLOCK_SZ records:
+ *      Record 1: header -- magic number, clean flag, bytes of contents
+ *      Record 2: the contents, continued in the records after it
+ * The clean flag is cleared on disk when the file is opened and set again when close() writes the
+ * contents back, so contents left behind by a process that never closed the file are known to be
+ * stale and open() doesn't return them; the owner builds them again.
+ */
+class SynopsisFile {
+public:
+	/**
+	 * @param dbfilename  name of the file
+	 * @param magic       number identifying the owner's kind of file
+	 */
+	SynopsisFile(std::string dbfilename, uint32_t magic);
+	virtual ~SynopsisFile() { delete db; }
+	SynopsisFile(const SynopsisFile &other) = delete;
+	SynopsisFile(SynopsisFile &&temp) = delete;
+	SynopsisFile &operator=(const SynopsisFile &other) = delete;
+	SynopsisFile &operator=(SynopsisFile &&temp) = delete;
+
+	/**
+	 * Create the file (any stale one under the same name is reused) and open it, with no contents.
+	 */
+	virtual void create();
+
+	/**
+	 * Remove the file (if there is one), closing it first without writing anything back.
+	 */
+	virtual void drop();
+
+	/**
+	 * Open the file, creating it if need be, and read back what the last close() wrote.
+	 * @param contents  returned by reference: the contents, if they can be trusted
+	 * @returns         false if there are no contents to trust (no file yet, or not closed cleanly)
+	 */
+	virtual bool open(std::string &contents);
+
+	/**
+	 * Write back the contents, marked clean, and close the file.
+	 * @param contents  the owner's serialized contents
+	 */
+	virtual void close(const std::string &contents);
+
+	/**
+	 * @returns  true between open() (or create()) and close() (or drop())
+	 */
+	virtual bool is_open() const { return db != nullptr; }
+
+protected:
+	std::string dbfilename;
+	uint32_t magic;
+	Db *db;  // a new one for each open (a Berkeley DB handle can't be reopened)
+
+	virtual void db_open(uint flags = 0);
+	virtual bool read(std::string &contents);
+	virtual void write_header(bool clean, uint64_t size);
+};
@@ -0,0 +1,214 @@
+/**
+ * @file zone_map.cpp - implementation of:
+ * ZoneMap
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#include <memory.h>
+#include "zone_map.h"
+#include "heap_storage.h"
+using namespace std;
+
+// magic number of the map file ("ZON2")
+static const uint32_t ZONE_MAGIC = 0x324e4f5a;
+
+// bytes at the start of each zone: number of rows in the block
+static const uint ROWS_SZ = sizeof(uint16_t);
+
+ZoneMap::ZoneMap(string name, const ColumnAttributes &column_attributes)
+        : file(name + ".zone.db", ZONE_MAGIC), column_attributes(column_attributes),
+          offsets(), zone_size(ROWS_SZ), n_blocks(0), zones(), view(nullptr) {
+    for (auto const &column_attribute: this->column_attributes) {
+        this->offsets.push_back(this->zone_size);
+        switch (column_attribute.get_data_type()) {
+            case ColumnAttribute::INT:
+                this->zone_size += 2 * sizeof(int32_t);
+                break;
+            case ColumnAttribute::TEXT:
+                this->zone_size += 2 * (1 + PREFIX_SZ);  // length byte and prefix, for least and greatest
+                break;
+            case ColumnAttribute::BOOLEAN:
+                this->zone_size += 2 * sizeof(uint16_t);
+                break;
+        }
+    }
+    this->view = new RecordView(this->column_attributes);
+}
+
+ZoneMap::~ZoneMap() {
+    delete this->view;
+}
+
+// Create the map file, covering no blocks (any stale map under the same name is ignored).
+void ZoneMap::create() {
+    this->file.create();
+    this->n_blocks = 0;
+    this->zones.clear();
+}
+
+// Remove the map file. Tables created before we had zone maps don't have one.
+void ZoneMap::drop() {
+    this->file.drop();
+}
+
+// Read the zones if they were written back by a close(), and mark the map as in use.
+bool ZoneMap::open() {
+    if (is_open())
+        return true;
+    string bytes;
+    if (this->file.open(bytes) && deserialize(bytes))
+        return true;
+    this->n_blocks = 0;
+    this->zones.clear();
+    return false;
+}
+
+// Write back the zones and close the map file.
+void ZoneMap::close() {
+    if (!is_open())
+        return;
+    string bytes;
+    serialize(bytes);
+    this->file.close(bytes);
+}
+
+// Fold the row's values into the least/greatest values and counts of its block.
+void ZoneMap::add(BlockID block_id, const Dbt &record) {
+    reopen();
+    char *z = zone(block_id);
+    uint16_t n_rows;
+    memcpy(&n_rows, z, sizeof(n_rows));
+    this->view->reset(record);
+    for (uint column = 0; column < this->column_attributes.size(); column++) {
+        char *part = z + this->offsets[column];
+        switch (this->column_attributes[column].get_data_type()) {
+            case ColumnAttribute::INT: {
+                int32_t value = this->view->get_int(column), least, greatest;
+                memcpy(&least, part, sizeof(int32_t));
+                memcpy(&greatest, part + sizeof(int32_t), sizeof(int32_t));
+                if (n_rows == 0 || value < least)
+                    memcpy(part, &value, sizeof(int32_t));
+                if (n_rows == 0 || value > greatest)
+                    memcpy(part + sizeof(int32_t), &value, sizeof(int32_t));
+                break;
+            }
+            case ColumnAttribute::TEXT: {
+                TextView text = this->view->get_text(column);
+                string prefix(text.data, min((uint) text.size, PREFIX_SZ));
+                char *least = part, *greatest = part + 1 + PREFIX_SZ;
+                if (n_rows == 0 || prefix < string(least + 1, (uint8_t) least[0])) {
+                    least[0] = (char) prefix.size();
+                    memcpy(least + 1, prefix.data(), prefix.size());
+                }
+                if (n_rows == 0 || prefix > string(greatest + 1, (uint8_t) greatest[0])) {
+                    greatest[0] = (char) prefix.size();
+                    memcpy(greatest + 1, prefix.data(), prefix.size());
+                }
+                break;
+            }
+            case ColumnAttribute::BOOLEAN: {
+                char *count = part + (this->view->get_boolean(column) ? 0 : sizeof(uint16_t));
+                uint16_t n;
+                memcpy(&n, count, sizeof(n));
+                n++;
+                memcpy(count, &n, sizeof(n));
+                break;
+            }
+        }
+    }
+    n_rows++;
+    memcpy(z, &n_rows, sizeof(n_rows));
+}
+
+// Start the block's zone over and add each of its rows.
+void ZoneMap::rebuild(const SlottedPage &block) {
+    reopen();
+    BlockID block_id = const_cast<SlottedPage &>(block).get_block_id();
+    memset(zone(block_id), 0, this->zone_size);
+    Dbt data;
+    for (RecordID record_id = block.next_id(); record_id != 0; record_id = block.next_id(record_id)) {
+        block.view(record_id, data);
+        add(block_id, data);
+    }
+}
+
+// A block is ruled out by any condition outside its zone. Blocks the map doesn't cover, and
+// conditions with a value of the wrong type, are left for the scan to check.
+bool ZoneMap::may_match(BlockID block_id, const ColumnOrdinals &columns, const Row &values) const {
+    if (block_id == 0 || block_id > this->n_blocks)
+        return true;
+    const char *z = &this->zones[(block_id - 1) * this->zone_size];
+    uint16_t n_rows;
+    memcpy(&n_rows, z, sizeof(n_rows));
+    if (n_rows == 0)
+        return false;
+    for (uint i = 0; i < columns.size(); i++) {
+        const Value &value = values[i];
+        const char *part = z + this->offsets[columns[i]];
+        if (value.data_type != this->column_attributes[columns[i]].get_data_type())
+            continue;
+        switch (value.data_type) {
+            case ColumnAttribute::INT: {
+                int32_t least, greatest;
+                memcpy(&least, part, sizeof(int32_t));
+                memcpy(&greatest, part + sizeof(int32_t), sizeof(int32_t));
+                if (value.n < least || value.n > greatest)
+                    return false;
+                break;
+            }
+            case ColumnAttribute::TEXT: {
+                string prefix = value.s.substr(0, PREFIX_SZ);
+                const char *least = part, *greatest = part + 1 + PREFIX_SZ;
+                if (prefix < string(least + 1, (uint8_t) least[0]) || prefix > string(greatest + 1, (uint8_t) greatest[0]))
+                    return false;
+                break;
+            }
+            case ColumnAttribute::BOOLEAN: {
+                uint16_t n;
+                memcpy(&n, part + (value.n != 0 ? 0 : sizeof(uint16_t)), sizeof(n));
+                if (n == 0)
+                    return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// The zones in memory are still current after a close() (by the file pool, say), so before they
+// change the file only has to be marked as in use again.
+void ZoneMap::reopen() {
+    if (!is_open()) {
+        string bytes;
+        this->file.open(bytes);
+    }
+}
+
+// Take the zones if they are for zones of our size.
+bool ZoneMap::deserialize(const string &bytes) {
+    uint32_t zone_size;
+    if (bytes.size() < sizeof(zone_size))
+        return false;
+    memcpy(&zone_size, bytes.data(), sizeof(zone_size));
+    if (zone_size != this->zone_size || (bytes.size() - sizeof(zone_size)) % zone_size != 0)
+        return false;
+    this->zones.assign(bytes.begin() + sizeof(zone_size), bytes.end());
+    this->n_blocks = (uint32_t) (this->zones.size() / zone_size);
+    return true;
+}
+
+// Bytes per zone, then the zones.
+void ZoneMap::serialize(string &bytes) const {
+    uint32_t zone_size = this->zone_size;
+    bytes.append((const char *) &zone_size, sizeof(zone_size));
+    bytes.append(this->zones.begin(), this->zones.end());
+}
+
+// The zone of a block, extending the map (with empty zones) to cover it if need be.
+char *ZoneMap::zone(BlockID block_id) {
+    if (block_id > this->n_blocks) {
+        this->zones.resize((size_t) block_id * this->zone_size, 0);
+        this->n_blocks = block_id;
+    }
+    return &this->zones[(size_t) (block_id - 1) * this->zone_size];
+}
@@ -0,0 +1,119 @@
+/**
+ * @file zone_map.h - Per-block synopses of a table's column values.
+ * ZoneMap
+ *
+ * @see "Seattle University, CPSC5300, Summer 2018"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "synopsis_file.h"
+
+class RecordView;  // in heap_storage.h
+class SlottedPage;
+
+/**
+ * @class ZoneMap - a zone (synopsis) of the values in each block of a HeapTable, so that a scan for
+ * column = value can skip the blocks that can't hold a match.
+ *
+ * A block's zone holds the number of rows in it and, for each column:
+ *      INT:     the least and greatest value
+ *      TEXT:    the least and greatest first PREFIX_SZ bytes of the values
+ *      BOOLEAN: the number of true and of false values
+ * Zones only ever claim too much: adding a row widens its block's zone, and deleting one recomputes
+ * the zone from the rows left in the block.
+ *
+ * The whole map is held in memory while open and written back by close() to its SynopsisFile
+ * (<name>.zone.db): the bytes per zone, then the zones of blocks 1, 2, etc. A map left behind by a
+ * process that never closed its table is known to be stale; open() reports that and the owner
+ * rebuilds it.
+ */
+class ZoneMap {
+public:
+    /**
+     * Number of leading bytes of TEXT values kept in the zones.
+     */
+    static const uint PREFIX_SZ = 8;
+
+    /**
+     * @param name               name of the table (the map is in <name>.zone.db)
+     * @param column_attributes  the table's columns
+     */
+    ZoneMap(std::string name, const ColumnAttributes &column_attributes);
+    virtual ~ZoneMap();
+    ZoneMap(const ZoneMap &other) = delete;
+    ZoneMap(ZoneMap &&temp) = delete;
+    ZoneMap &operator=(const ZoneMap &other) = delete;
+    ZoneMap &operator=(ZoneMap &&temp) = delete;
+
+    /**
+     * Create the map file (covering no blocks).
+     */
+    virtual void create();
+
+    /**
+     * Remove the map file (if there is one).
+     */
+    virtual void drop();
+
+    /**
+     * Open the map file (creating it if need be) and read in the zones.
+     * @returns  false if the zones can't be trusted (no map yet, stale, or for other columns), in
+     *           which case the map is empty and the owner has to add() every block's rows again
+     */
+    virtual bool open();
+
+    /**
+     * Write out the zones and close the map file. The zones stay in memory, so may_match() still
+     * works, and a change made after close() opens the file again.
+     */
+    virtual void close();
+
+    /**
+     * @returns  true between open() (or create()) and close()
+     */
+    virtual bool is_open() const { return file.is_open(); }
+
+    /**
+     * Number of blocks covered by the map.
+     * @returns  blocks 1 through this have a zone
+     */
+    virtual uint32_t get_n_blocks() const { return n_blocks; }
+
+    /**
+     * Widen a block's zone to take in a new row.
+     * @param block_id  the block the row is in
+     * @param record    the row, as marshaled by HeapTable
+     */
+    virtual void add(BlockID block_id, const Dbt &record);
+
+    /**
+     * Recompute a block's zone from the rows in it.
+     * @param block  the block
+     */
+    virtual void rebuild(const SlottedPage &block);
+
+    /**
+     * Whether a block may hold a row with the given values.
+     * @param block_id  which block
+     * @param columns   ordinals of the columns in the where clause
+     * @param values    value for each of them
+     * @returns         false if the zone rules the block out
+     */
+    virtual bool may_match(BlockID block_id, const ColumnOrdinals &columns, const Row &values) const;
+
+protected:
+    SynopsisFile file;
+    ColumnAttributes column_attributes;
+    std::vector<uint> offsets;    // offsets[i] is where column i's part of a zone starts
+    uint zone_size;               // bytes per zone
+    uint32_t n_blocks;
+    std::vector<char> zones;      // zone of block_id at (block_id - 1) * zone_size
+    RecordView *view;
+
+    virtual void reopen();
+    virtual bool deserialize(const std::string &bytes);
+    virtual void serialize(std::string &bytes) const;
+    virtual char *zone(BlockID block_id);
+};